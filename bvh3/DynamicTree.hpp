@@ -0,0 +1,726 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_DYNAMICTREE
+#define BVH3_DYNAMICTREE
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/splitters/SplitterByCenter.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Node of the dynamic tree.
+ *
+ * @param TBv Type of bounding volume.
+ */
+template<class TBv>
+struct SDynamicNode
+{
+    /**
+     * Bounding volume of the subtree, inflated by the margin for leaves.
+     */
+    TBv bv;
+
+    /**
+     * Index of the parent node, next free node for released ones.
+     */
+    unsigned parent;
+
+    /**
+     * Index of the left child, NONE for leaves.
+     */
+    unsigned left;
+
+    /**
+     * Index of the right child, NONE for leaves.
+     */
+    unsigned right;
+
+    /**
+     * Height of the subtree: 0 for leaves, -1 for released nodes.
+     */
+    int height;
+
+    /**
+     * User data of leaves.
+     */
+    unsigned data;
+};
+
+/**
+ * Bounding Volume Binary Tree updated incrementally.
+ * A leaf is inserted next to the sibling chosen by the cost of surface areas in O(log n)
+ * and ancestors are rebalanced by rotations, so the tree stays balanced under
+ * any order of insertions and removals.
+ * Leaves store bounding volumes inflated by the margin, so a leaf is reinserted
+ * only when a moved object leaves its inflated bounding volume.
+ * Batches of objects are built into a subtree top-down and spliced in at once.
+ *
+ * @param TBv Type of bounding volume.
+ */
+template<class TBv>
+class DynamicTree
+{
+public:
+
+    /**
+     * Index of missing node.
+     */
+    static const unsigned NONE = ~0u;
+
+    /**
+     * Array of nodes.
+     */
+    typedef std::vector<SDynamicNode<TBv> > TNodes;
+
+    /**
+     * @param Margin to inflate bounding volumes of leaves by.
+     */
+    explicit DynamicTree(float margin = 0.1f);
+
+    /**
+     * Inserts the object.
+     *
+     * @param Bounding volume of the object.
+     * @param User data.
+     * @return Id of the leaf of the object.
+     */
+    unsigned insert(const TBv& bv, unsigned data);
+
+    /**
+     * Inserts the objects at once.
+     * A subtree is built over centers of bounding volumes and inserted next to the cheapest sibling,
+     * only ancestors of the sibling are rebalanced.
+     *
+     * @param Bounding volumes of objects.
+     * @param User data of objects.
+     * @param[out] Container to append ids of leaves of objects to.
+     */
+    void insertMany(const std::vector<TBv>& bvs, const std::vector<unsigned>& data, std::vector<unsigned>& proxies);
+
+    /**
+     * Removes the object.
+     *
+     * @param Id of the leaf of the object.
+     */
+    void remove(unsigned proxy);
+
+    /**
+     * Removes the objects at once.
+     * Every changed node is refitted and rebalanced once.
+     *
+     * @param Ids of leaves of objects.
+     */
+    void removeMany(const std::vector<unsigned>& proxies);
+
+    /**
+     * Updates bounding volume of the moved object.
+     * The leaf is reinserted only if the bounding volume left the inflated one.
+     *
+     * @param Id of the leaf of the object.
+     * @param New bounding volume.
+     * @return true If the leaf has been reinserted.
+     */
+    bool move(unsigned proxy, const TBv& bv);
+
+    /**
+     * Returns inflated bounding volume of the object.
+     */
+    const TBv& getBoundingVolume(unsigned proxy) const;
+
+    /**
+     * Returns user data of the object.
+     */
+    unsigned getData(unsigned proxy) const;
+
+    /**
+     * Returns number of objects.
+     */
+    unsigned size() const;
+
+    /**
+     * Returns height of the tree, 0 for one leaf.
+     */
+    int getHeight() const;
+
+    /**
+     * Returns index of the root, NONE for empty tree.
+     */
+    unsigned getRoot() const;
+
+    /**
+     * Returns all nodes including released ones.
+     */
+    const TNodes& getNodes() const;
+
+    /**
+     * Calls the visitor for every object with inflated bounding volume overlapped the query.
+     *
+     * @param Query bounding volume.
+     * @param Called as visitor(proxy), returns false to stop the query.
+     * @return false If stopped by the visitor.
+     */
+    template<class TVisitor>
+    bool query(const TBv& bv, TVisitor&& visitor) const;
+
+private:
+
+    /**
+     * Returns surface area of the box of union of bounding volumes as cost of insertion.
+     */
+    static float getArea(const TBv& bv, const TBv& other);
+
+    /**
+     * Takes a node from released ones or appends new one.
+     */
+    unsigned allocate();
+
+    /**
+     * Releases the node to be reused.
+     */
+    void release(unsigned node);
+
+    /**
+     * Builds a subtree over leaves on [begin, end) range.
+     *
+     * @param Centers of bounding volumes of leaves.
+     * @param Leaves by indices of centers.
+     * @param Number of levels the subtree could take below its root.
+     * @return Index of the root of the subtree.
+     */
+    unsigned build(const TVertices& centers, const unsigned* leaves, unsigned* begin, unsigned* end, unsigned levels);
+
+    /**
+     * Removes marked leaves of the subtree, refits and rebalances changed nodes.
+     *
+     * @param Marks of nodes with removed leaves in the subtree.
+     * @return Index of the root of the subtree, NONE if it is removed.
+     */
+    unsigned prune(unsigned node, const std::vector<bool>& marked);
+
+    /**
+     * Inserts the leaf or the subtree next to the cheapest sibling.
+     */
+    void insertLeaf(unsigned leaf);
+
+    /**
+     * Removes the leaf and its parent, the sibling takes the place of the parent.
+     */
+    void removeLeaf(unsigned leaf);
+
+    /**
+     * Recomputes bounding volumes and heights of the node and its ancestors, rebalancing them.
+     * Stops at the first node that is not changed.
+     */
+    void refit(unsigned node);
+
+    /**
+     * Rotates the node if heights of its children differ by more than 1.
+     *
+     * @return Index of the node taken its place.
+     */
+    unsigned balance(unsigned node);
+
+    /**
+     * Replaces the child of the parent of the node, or the root.
+     */
+    void replaceChild(unsigned parent, unsigned child, unsigned node);
+
+    /**
+     * All nodes including released ones.
+     */
+    TNodes mNodes;
+
+    /**
+     * Index of the root.
+     */
+    unsigned mRoot;
+
+    /**
+     * Index of the first released node.
+     */
+    unsigned mFree;
+
+    /**
+     * Number of objects.
+     */
+    unsigned mSize;
+
+    /**
+     * Margin to inflate bounding volumes of leaves by.
+     */
+    float mMargin;
+};
+
+template<class TBv>
+const unsigned DynamicTree<TBv>::NONE;
+
+template<class TBv>
+DynamicTree<TBv>::DynamicTree(float margin)
+    : mRoot(NONE)
+    , mFree(NONE)
+    , mSize(0)
+    , mMargin(margin)
+{
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::insert(const TBv& bv, unsigned data)
+{
+    unsigned leaf = allocate();
+    SDynamicNode<TBv>& node = mNodes[leaf];
+    node.bv = bv;
+    node.bv.inflate(mMargin);
+    node.data = data;
+    node.height = 0;
+    insertLeaf(leaf);
+    ++mSize;
+
+    return leaf;
+}
+
+template<class TBv>
+void DynamicTree<TBv>::remove(unsigned proxy)
+{
+    removeLeaf(proxy);
+    release(proxy);
+    --mSize;
+}
+
+template<class TBv>
+void DynamicTree<TBv>::insertMany(const std::vector<TBv>& bvs, const std::vector<unsigned>& data, std::vector<unsigned>& proxies)
+{
+    unsigned count = bvs.size();
+    if (count == 0)
+    {
+        return;
+    }
+
+    unsigned first = proxies.size();
+    mNodes.reserve(mNodes.size() + 2 * count);
+    proxies.reserve(first + count);
+    TVertices centers(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned leaf = allocate();
+        SDynamicNode<TBv>& node = mNodes[leaf];
+        node.bv = bvs[i];
+        node.bv.inflate(mMargin);
+        node.data = data[i];
+        centers[i] = bvs[i].getCenter();
+        proxies.push_back(leaf);
+    }
+
+    // Splitter partitions indices of centers, they are mapped to leaves by proxies.
+    std::vector<unsigned> order(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        order[i] = i;
+    }
+
+    unsigned root = build(centers, proxies.data() + first, order.data(), order.data() + count, getDepthLimit(count));
+    mSize += count;
+    insertLeaf(root);
+}
+
+template<class TBv>
+void DynamicTree<TBv>::removeMany(const std::vector<unsigned>& proxies)
+{
+    // Marks removed leaves and their ancestors up to already marked ones.
+    std::vector<bool> marked(mNodes.size());
+    unsigned removed = 0;
+    for (unsigned i = 0; i < proxies.size(); ++i)
+    {
+        // Proxies could be repeated, leaves are never marked as ancestors.
+        removed += !marked[proxies[i]];
+        for (unsigned node = proxies[i]; node != NONE && !marked[node]; node = mNodes[node].parent)
+        {
+            marked[node] = true;
+        }
+    }
+
+    mRoot = prune(mRoot, marked);
+    if (mRoot != NONE)
+    {
+        mNodes[mRoot].parent = NONE;
+    }
+
+    mSize -= removed;
+}
+
+template<class TBv>
+bool DynamicTree<TBv>::move(unsigned proxy, const TBv& bv)
+{
+    if (mNodes[proxy].bv.contains(bv))
+    {
+        return false;
+    }
+
+    removeLeaf(proxy);
+    mNodes[proxy].bv = bv;
+    mNodes[proxy].bv.inflate(mMargin);
+    insertLeaf(proxy);
+
+    return true;
+}
+
+template<class TBv>
+const TBv& DynamicTree<TBv>::getBoundingVolume(unsigned proxy) const
+{
+    return mNodes[proxy].bv;
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::getData(unsigned proxy) const
+{
+    return mNodes[proxy].data;
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::size() const
+{
+    return mSize;
+}
+
+template<class TBv>
+int DynamicTree<TBv>::getHeight() const
+{
+    return mRoot != NONE ? mNodes[mRoot].height : -1;
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::getRoot() const
+{
+    return mRoot;
+}
+
+template<class TBv>
+const typename DynamicTree<TBv>::TNodes& DynamicTree<TBv>::getNodes() const
+{
+    return mNodes;
+}
+
+template<class TBv>
+template<class TVisitor>
+bool DynamicTree<TBv>::query(const TBv& bv, TVisitor&& visitor) const
+{
+    if (mRoot == NONE)
+    {
+        return true;
+    }
+
+    std::vector<unsigned> stack;
+    stack.reserve(64);
+    stack.push_back(mRoot);
+    while (!stack.empty())
+    {
+        const SDynamicNode<TBv>& node = mNodes[stack.back()];
+        unsigned index = stack.back();
+        stack.pop_back();
+        if (!node.bv.overlapped(bv))
+        {
+            continue;
+        }
+
+        if (node.left == NONE)
+        {
+            if (!visitor(index))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            stack.push_back(node.right);
+            stack.push_back(node.left);
+        }
+    }
+
+    return true;
+}
+
+template<class TBv>
+float DynamicTree<TBv>::getArea(const TBv& bv, const TBv& other)
+{
+    return (bv + other).getBoxSurfaceArea();
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::allocate()
+{
+    unsigned result = mFree;
+    if (result != NONE)
+    {
+        mFree = mNodes[result].parent;
+    }
+    else
+    {
+        result = mNodes.size();
+        mNodes.push_back(SDynamicNode<TBv>());
+    }
+
+    SDynamicNode<TBv>& node = mNodes[result];
+    node.parent = NONE;
+    node.left = NONE;
+    node.right = NONE;
+    node.height = 0;
+    node.data = 0;
+
+    return result;
+}
+
+template<class TBv>
+void DynamicTree<TBv>::release(unsigned node)
+{
+    mNodes[node].parent = mFree;
+    mNodes[node].height = -1;
+    mFree = node;
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::build(const TVertices& centers, const unsigned* leaves, unsigned* begin, unsigned* end, unsigned levels)
+{
+    unsigned count = end - begin;
+    if (count == 1)
+    {
+        return leaves[*begin];
+    }
+
+    // Leaves with the same center or too deep subtrees are split by count.
+    TBv centersBv = createBoundingVolume<TBv>(centers.data(), begin, count);
+    unsigned* middle = begin;
+    if (!needsSplitByCount(count, levels))
+    {
+        SplitterByCenter<TBv> splitter(centersBv);
+        middle = splitter.partition(centers.data(), begin, end);
+    }
+
+    if (middle == begin || middle == end)
+    {
+        middle = partitionByCount(centersBv, centers.data(), begin, end);
+    }
+
+    unsigned left = build(centers, leaves, begin, middle, levels - 1);
+    unsigned right = build(centers, leaves, middle, end, levels - 1);
+    unsigned result = allocate();
+    SDynamicNode<TBv>& node = mNodes[result];
+    node.left = left;
+    node.right = right;
+    node.bv = mNodes[left].bv + mNodes[right].bv;
+    node.height = 1 + std::max(mNodes[left].height, mNodes[right].height);
+    mNodes[left].parent = result;
+    mNodes[right].parent = result;
+
+    return result;
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::prune(unsigned node, const std::vector<bool>& marked)
+{
+    if (node == NONE || !marked[node])
+    {
+        return node;
+    }
+
+    if (mNodes[node].left == NONE)
+    {
+        release(node);
+        return NONE;
+    }
+
+    unsigned left = prune(mNodes[node].left, marked);
+    unsigned right = prune(mNodes[node].right, marked);
+    if (left == NONE || right == NONE)
+    {
+        release(node);
+        return left != NONE ? left : right;
+    }
+
+    SDynamicNode<TBv>& n = mNodes[node];
+    n.left = left;
+    n.right = right;
+    mNodes[left].parent = node;
+    mNodes[right].parent = node;
+    n.height = 1 + std::max(mNodes[left].height, mNodes[right].height);
+    n.bv = mNodes[left].bv + mNodes[right].bv;
+
+    return balance(node);
+}
+
+template<class TBv>
+void DynamicTree<TBv>::insertLeaf(unsigned leaf)
+{
+    if (mRoot == NONE)
+    {
+        mRoot = leaf;
+        mNodes[leaf].parent = NONE;
+        return;
+    }
+
+    // Descends while a child is cheaper than placing the leaf next to current node.
+    // Cost is surface area of new parent plus increase of areas of ancestors.
+    const TBv bv = mNodes[leaf].bv;
+    unsigned index = mRoot;
+    while (mNodes[index].left != NONE)
+    {
+        const SDynamicNode<TBv>& node = mNodes[index];
+        float area = getArea(node.bv, node.bv);
+        float combined = getArea(node.bv, bv);
+        float cost = 2 * combined;
+        float inherited = 2 * (combined - area);
+
+        float costs[2];
+        unsigned children[2] = {node.left, node.right};
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            const SDynamicNode<TBv>& child = mNodes[children[i]];
+            costs[i] = getArea(child.bv, bv) + inherited;
+            if (child.left != NONE)
+            {
+                costs[i] -= getArea(child.bv, child.bv);
+            }
+        }
+
+        if (cost < costs[0] && cost < costs[1])
+        {
+            break;
+        }
+
+        index = costs[0] < costs[1] ? children[0] : children[1];
+    }
+
+    unsigned sibling = index;
+    unsigned oldParent = mNodes[sibling].parent;
+    unsigned parent = allocate();
+    SDynamicNode<TBv>& node = mNodes[parent];
+    node.parent = oldParent;
+    node.bv = bv + mNodes[sibling].bv;
+    node.height = 1 + std::max(mNodes[sibling].height, mNodes[leaf].height);
+    node.left = sibling;
+    node.right = leaf;
+    replaceChild(oldParent, sibling, parent);
+    mNodes[sibling].parent = parent;
+    mNodes[leaf].parent = parent;
+
+    refit(oldParent);
+}
+
+template<class TBv>
+void DynamicTree<TBv>::removeLeaf(unsigned leaf)
+{
+    if (leaf == mRoot)
+    {
+        mRoot = NONE;
+        return;
+    }
+
+    unsigned parent = mNodes[leaf].parent;
+    unsigned grandParent = mNodes[parent].parent;
+    unsigned sibling = mNodes[parent].left == leaf ? mNodes[parent].right : mNodes[parent].left;
+    replaceChild(grandParent, parent, sibling);
+    mNodes[sibling].parent = grandParent;
+    release(parent);
+
+    refit(grandParent);
+}
+
+template<class TBv>
+void DynamicTree<TBv>::refit(unsigned node)
+{
+    while (node != NONE)
+    {
+        unsigned balanced = balance(node);
+        SDynamicNode<TBv>& n = mNodes[balanced];
+        const SDynamicNode<TBv>& left = mNodes[n.left];
+        const SDynamicNode<TBv>& right = mNodes[n.right];
+        int height = 1 + std::max(left.height, right.height);
+        TBv bv = left.bv + right.bv;
+
+        // Ancestors of unchanged node are not changed too.
+        if (balanced == node && height == n.height && n.bv.contains(bv) && bv.contains(n.bv))
+        {
+            break;
+        }
+
+        n.height = height;
+        n.bv = bv;
+        node = n.parent;
+    }
+}
+
+template<class TBv>
+void DynamicTree<TBv>::replaceChild(unsigned parent, unsigned child, unsigned node)
+{
+    if (parent == NONE)
+    {
+        mRoot = node;
+    }
+    else if (mNodes[parent].left == child)
+    {
+        mNodes[parent].left = node;
+    }
+    else
+    {
+        mNodes[parent].right = node;
+    }
+}
+
+template<class TBv>
+unsigned DynamicTree<TBv>::balance(unsigned a)
+{
+    SDynamicNode<TBv>& nodeA = mNodes[a];
+    if (nodeA.left == NONE || nodeA.height < 2)
+    {
+        return a;
+    }
+
+    // The higher child takes the place of the node, the node takes its lower child.
+    int difference = mNodes[nodeA.right].height - mNodes[nodeA.left].height;
+    if (difference >= -1 && difference <= 1)
+    {
+        return a;
+    }
+
+    bool rightUp = difference > 1;
+    unsigned b = rightUp ? nodeA.right : nodeA.left;
+    unsigned c = rightUp ? nodeA.left : nodeA.right;
+    SDynamicNode<TBv>& nodeB = mNodes[b];
+    SDynamicNode<TBv>& nodeC = mNodes[c];
+    unsigned higher = mNodes[nodeB.left].height > mNodes[nodeB.right].height ? nodeB.left : nodeB.right;
+    unsigned lower = higher == nodeB.left ? nodeB.right : nodeB.left;
+
+    nodeB.parent = nodeA.parent;
+    replaceChild(nodeB.parent, a, b);
+    nodeA.parent = b;
+    nodeB.left = a;
+    nodeB.right = higher;
+    if (rightUp)
+    {
+        nodeA.right = lower;
+    }
+    else
+    {
+        nodeA.left = lower;
+    }
+
+    mNodes[lower].parent = a;
+    nodeA.bv = nodeC.bv + mNodes[lower].bv;
+    nodeA.height = 1 + std::max(nodeC.height, mNodes[lower].height);
+    nodeB.bv = nodeA.bv + mNodes[higher].bv;
+    nodeB.height = 1 + std::max(nodeA.height, mNodes[higher].height);
+
+    return b;
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_DYNAMICTREE
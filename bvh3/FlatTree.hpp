@@ -0,0 +1,623 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_FLATTREE
+#define BVH3_FLATTREE
+
+#include <bvh3/types/SVertex.hpp>
+#include <bvh3/types/SVertexRange.hpp>
+#include <bvh3/bv/all.hpp>
+#include <bvh3/splitters/SplitterByCenter.hpp>
+#include <bvh3/parallel/TaskPool.hpp>
+#include <bvh3/traversal/PairTraversal.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+namespace NBvh3
+{
+
+/**
+ * Node of the flat tree.
+ * Left child of an internal node is stored right after it.
+ *
+ * @param TBv Type of bounding volume.
+ */
+template<class TBv>
+struct SFlatNode
+{
+    /**
+     * Bounding volume of the subtree.
+     */
+    TBv bv;
+
+    /**
+     * Index of the right child for internal nodes.
+     * Index of the first vertex for leaves.
+     */
+    std::uint32_t index;
+
+    /**
+     * Number of vertices for leaves, 0 for internal nodes.
+     */
+    std::uint32_t count;
+};
+
+/**
+ * Represents Bounding Volume Binary Tree stored in one continuous array in depth-first order.
+ * Does not contain pointers, so could be copied or moved as is.
+ *
+ * @param TBv Type of bounding volume.
+ */
+template<class TBv>
+class FlatTree
+{
+public:
+
+    /**
+     * Array of nodes.
+     */
+    typedef std::vector<SFlatNode<TBv> > TNodes;
+
+    /**
+     * Array of indices.
+     */
+    typedef std::vector<unsigned> TIndices;
+
+    /**
+     * Defines matched pair of node indices after quering.
+     */
+    typedef std::pair<unsigned, unsigned> TMatchedNodes;
+
+    /**
+     * Array of matched pairs.
+     */
+    typedef std::vector<TMatchedNodes> TCollidedNodes;
+
+    /**
+     * Default constructor to create empty tree.
+     */
+    FlatTree();
+
+    /**
+     * @param Nodes in depth-first order.
+     * @param Vertices ordered by leaves.
+     * @param Original indices of the vertices.
+     */
+    FlatTree(TNodes&& nodes, TVertices&& vertices, TIndices&& indices);
+
+    /**
+     * Checks if the tree has no nodes.
+     */
+    bool empty() const;
+
+    /**
+     * Returns all nodes.
+     */
+    const TNodes& getNodes() const;
+
+    /**
+     * Returns all vertices ordered by leaves.
+     */
+    const TVertices& getVertices() const;
+
+    /**
+     * Returns original indices of the vertices as they were submitted to the builder.
+     */
+    const TIndices& getIndices() const;
+
+    /**
+     * Checks if the node is leaf.
+     */
+    bool isLeaf(unsigned node) const;
+
+    /**
+     * Returns index of left child.
+     */
+    unsigned getLeft(unsigned node) const;
+
+    /**
+     * Returns index of right child.
+     */
+    unsigned getRight(unsigned node) const;
+
+    /**
+     * Returns bounding volume of the node.
+     */
+    const TBv& getBoundingVolume(unsigned node) const;
+
+    /**
+     * Returns vertices of the leaf.
+     */
+    SVertexRange getVertices(unsigned node) const;
+
+    /**
+     * Checks if current tree collided with query tree.
+     * Returns all pairs of overlapped leaves that have equal vertices,
+     * so results do not depend on the maximal number of vertices in a leaf.
+     * Traverses both trees iteratively by traversePairs().
+     *
+     * @param Query tree.
+     * @param[out] Container to store matched pairs of leaf indices.
+     * @return true If collided.
+     */
+    bool collided(const FlatTree<TBv>& query, TCollidedNodes& output) const;
+
+    /**
+     * Checks if current tree collided with query tree using the task pool.
+     * Pairs of nodes near roots are expanded by expandPairs() into independent subproblems
+     * traversed in parallel, each one into own buffer.
+     * Buffers are concatenated in order, so the output is the same as of the serial query.
+     *
+     * @param Query tree.
+     * @param[out] Container to store matched pairs of leaf indices.
+     * @param Pool to execute tasks.
+     * @param Number of subproblems per thread of the pool.
+     * @return true If collided.
+     */
+    bool collided(const FlatTree<TBv>& query, TCollidedNodes& output, TaskPool& pool, unsigned tasksPerThread = 16) const;
+
+    /**
+     * Calls the visitor for every pair of equal vertices of overlapped leaves
+     * without storing pairs of nodes.
+     * The visitor is called as visitor(index, queryIndex) with original indices of vertices
+     * and returns false to stop the traversal.
+     *
+     * @param Query tree.
+     * @param Visitor of pairs of vertices.
+     * @return false If stopped by the visitor.
+     */
+    template<class TVisitor>
+    bool visit(const FlatTree<TBv>& query, TVisitor&& visitor) const;
+
+    /**
+     * Checks if any leaves of current and query trees overlap.
+     * Stops at the first pair of overlapped leaves and does not allocate memory.
+     *
+     * @param Query tree.
+     * @return true If intersected.
+     */
+    bool intersects(const FlatTree<TBv>& query) const;
+
+    /**
+     * Updates positions of vertices keeping the hierarchy.
+     * Bounding volumes are recomputed bottom-up: leaves from their vertices,
+     * internal nodes by merging bounding volumes of children.
+     *
+     * Only flat trees are refitted, Node hierarchies should be rebuilt.
+     *
+     * @param Updated vertices in the order they were submitted to the builder.
+     * @return false If number of vertices differs from the tree, it is not changed then.
+     */
+    bool refit(const TVertices& vertices);
+
+    /**
+     * Updates positions of vertices keeping the hierarchy using the task pool.
+     * Subtrees are refitted in parallel.
+     *
+     * @param Updated vertices in the order they were submitted to the builder.
+     * @param Pool to execute tasks.
+     * @param Minimal number of nodes of a subtree to refit it in a separate task.
+     * @return false If number of vertices differs from the tree, it is not changed then.
+     */
+    bool refit(const TVertices& vertices, TaskPool& pool, unsigned cutoff = 8192);
+
+private:
+
+    /**
+     * Checks if overlapped leaves have equal vertices, the same pairs as passed to visit().
+     */
+    bool overlappedLeaves(unsigned node, const FlatTree<TBv>& query, unsigned queryNode) const;
+
+    /**
+     * Refits the subtree stored in [begin, end) range of nodes.
+     */
+    void refit(const TVertices& vertices, unsigned begin, unsigned end);
+
+    /**
+     * Refits the subtree stored in [begin, end) range of nodes in parallel.
+     */
+    void refit(const TVertices& vertices, TaskPool& pool, unsigned cutoff, unsigned begin, unsigned end);
+
+    /**
+     * Nodes in depth-first order.
+     */
+    TNodes mNodes;
+
+    /**
+     * Vertices ordered by leaves.
+     */
+    TVertices mVertices;
+
+    /**
+     * Original index of each vertex.
+     */
+    TIndices mIndices;
+};
+
+template<class TBv>
+FlatTree<TBv>::FlatTree()
+{
+}
+
+template<class TBv>
+FlatTree<TBv>::FlatTree(TNodes&& nodes, TVertices&& vertices, TIndices&& indices)
+    : mNodes(std::move(nodes))
+    , mVertices(std::move(vertices))
+    , mIndices(std::move(indices))
+{
+}
+
+template<class TBv>
+bool FlatTree<TBv>::empty() const
+{
+    return mNodes.empty();
+}
+
+template<class TBv>
+const typename FlatTree<TBv>::TNodes& FlatTree<TBv>::getNodes() const
+{
+    return mNodes;
+}
+
+template<class TBv>
+const TVertices& FlatTree<TBv>::getVertices() const
+{
+    return mVertices;
+}
+
+template<class TBv>
+const typename FlatTree<TBv>::TIndices& FlatTree<TBv>::getIndices() const
+{
+    return mIndices;
+}
+
+template<class TBv>
+bool FlatTree<TBv>::isLeaf(unsigned node) const
+{
+    return mNodes[node].count != 0;
+}
+
+template<class TBv>
+unsigned FlatTree<TBv>::getLeft(unsigned node) const
+{
+    return node + 1;
+}
+
+template<class TBv>
+unsigned FlatTree<TBv>::getRight(unsigned node) const
+{
+    return mNodes[node].index;
+}
+
+template<class TBv>
+const TBv& FlatTree<TBv>::getBoundingVolume(unsigned node) const
+{
+    return mNodes[node].bv;
+}
+
+template<class TBv>
+SVertexRange FlatTree<TBv>::getVertices(unsigned node) const
+{
+    const SFlatNode<TBv>& n = mNodes[node];
+    const SVertex* data = mVertices.data() + n.index;
+    return SVertexRange(data, data + n.count);
+}
+
+template<class TBv>
+bool FlatTree<TBv>::collided(const FlatTree<TBv>& query, TCollidedNodes& output) const
+{
+    unsigned size = output.size();
+    auto handler = [this, &query, &output](unsigned node, unsigned queryNode)
+    {
+        if (overlappedLeaves(node, query, queryNode))
+        {
+            output.push_back(std::make_pair(node, queryNode));
+        }
+
+        return true;
+    };
+
+    traversePairs(*this, query, handler);
+    return output.size() != size;
+}
+
+template<class TBv>
+bool FlatTree<TBv>::collided(const FlatTree<TBv>& query, TCollidedNodes& output, TaskPool& pool, unsigned tasksPerThread) const
+{
+    std::vector<TNodePair> front;
+    expandPairs(*this, query, (pool.getSize() + 1) * tasksPerThread, front);
+
+    std::vector<TCollidedNodes> results(front.size());
+    {
+        TaskGroup group(pool);
+        for (unsigned i = 0; i < front.size(); ++i)
+        {
+            TNodePair pair = front[i];
+            TCollidedNodes* result = &results[i];
+            group.run([this, &query, pair, result]()
+            {
+                auto handler = [this, &query, result](unsigned node, unsigned queryNode)
+                {
+                    if (overlappedLeaves(node, query, queryNode))
+                    {
+                        result->push_back(std::make_pair(node, queryNode));
+                    }
+
+                    return true;
+                };
+
+                traversePairs(*this, query, handler, pair.first, pair.second);
+            });
+        }
+
+        group.wait();
+    }
+
+    unsigned size = output.size();
+    unsigned total = size;
+    for (unsigned i = 0; i < results.size(); ++i)
+    {
+        total += results[i].size();
+    }
+
+    output.reserve(total);
+    for (unsigned i = 0; i < results.size(); ++i)
+    {
+        output.insert(output.end(), results[i].begin(), results[i].end());
+    }
+
+    return output.size() != size;
+}
+
+template<class TBv>
+template<class TVisitor>
+bool FlatTree<TBv>::visit(const FlatTree<TBv>& query, TVisitor&& visitor) const
+{
+    auto handler = [this, &query, &visitor](unsigned node, unsigned queryNode)
+    {
+        const SFlatNode<TBv>& leaf = mNodes[node];
+        const SFlatNode<TBv>& queryLeaf = query.mNodes[queryNode];
+        for (unsigned i = leaf.index; i < leaf.index + leaf.count; ++i)
+        {
+            const SVertex& vertex = mVertices[i];
+            if (queryLeaf.count > 1 && !queryLeaf.bv.contains(vertex))
+            {
+                continue;
+            }
+
+            for (unsigned j = queryLeaf.index; j < queryLeaf.index + queryLeaf.count; ++j)
+            {
+                if (vertex == query.mVertices[j] && !visitor(mIndices[i], query.mIndices[j]))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    };
+
+    return traversePairs(*this, query, handler);
+}
+
+template<class TBv>
+bool FlatTree<TBv>::intersects(const FlatTree<TBv>& query) const
+{
+    auto handler = [this, &query](unsigned node, unsigned queryNode)
+    {
+        return !overlappedLeaves(node, query, queryNode);
+    };
+
+    return !traversePairs(*this, query, handler);
+}
+
+template<class TBv>
+bool FlatTree<TBv>::overlappedLeaves(unsigned node, const FlatTree<TBv>& query, unsigned queryNode) const
+{
+    // Results do not depend on sizes of leaves.
+    SVertexRange vertices = getVertices(node);
+    SVertexRange queryVertices = query.getVertices(queryNode);
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        if (std::find(queryVertices.begin(), queryVertices.end(), vertices[i]) != queryVertices.end())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<class TBv>
+bool FlatTree<TBv>::refit(const TVertices& vertices)
+{
+    if (vertices.size() != mIndices.size())
+    {
+        return false;
+    }
+
+    refit(vertices, 0, mNodes.size());
+    return true;
+}
+
+template<class TBv>
+bool FlatTree<TBv>::refit(const TVertices& vertices, TaskPool& pool, unsigned cutoff)
+{
+    if (vertices.size() != mIndices.size())
+    {
+        return false;
+    }
+
+    if (!empty())
+    {
+        refit(vertices, pool, cutoff, 0, mNodes.size());
+    }
+
+    return true;
+}
+
+template<class TBv>
+void FlatTree<TBv>::refit(const TVertices& vertices, unsigned begin, unsigned end)
+{
+    // Children are stored after their parents.
+    for (unsigned i = end; i-- > begin;)
+    {
+        SFlatNode<TBv>& node = mNodes[i];
+        if (node.count != 0)
+        {
+            for (unsigned j = node.index; j < node.index + node.count; ++j)
+            {
+                mVertices[j] = vertices[mIndices[j]];
+            }
+
+            node.bv = createBoundingVolume<TBv>(mVertices.data() + node.index, node.count);
+        }
+        else
+        {
+            node.bv = mNodes[i + 1].bv;
+            node.bv += mNodes[node.index].bv;
+        }
+    }
+}
+
+template<class TBv>
+void FlatTree<TBv>::refit(
+    const TVertices& vertices,
+    TaskPool& pool,
+    unsigned cutoff,
+    unsigned begin,
+    unsigned end
+    )
+{
+    if (end - begin < cutoff || isLeaf(begin))
+    {
+        refit(vertices, begin, end);
+        return;
+    }
+
+    unsigned right = getRight(begin);
+    {
+        TaskGroup group(pool);
+        group.run([this, &vertices, &pool, cutoff, begin, right] {
+            refit(vertices, pool, cutoff, getLeft(begin), right);
+        });
+        refit(vertices, pool, cutoff, right, end);
+        group.wait();
+    }
+
+    SFlatNode<TBv>& node = mNodes[begin];
+    node.bv = mNodes[getLeft(begin)].bv;
+    node.bv += mNodes[right].bv;
+}
+
+/**
+ * Appends a subtree on [begin, end) range of indices to the nodes.
+ * Ranges are split by count when the splitter leaves one part empty
+ * or the rest of levels is just enough for a balanced subtree.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ * @param All vertices.
+ * @param Indices of vertices, reordered in place.
+ * @param First index of the range.
+ * @param Index after the last one.
+ * @param[out] Nodes in depth-first order.
+ * @param Maximal number of vertices in a leaf.
+ * @param Number of levels the subtree could take below its root, by default getDepthLimit() of the range.
+ * @return Index of created node.
+ */
+template<class TBv, class TSplitter>
+unsigned buildFlatNode(
+    const SVertex* vertices,
+    unsigned* indices,
+    unsigned begin,
+    unsigned end,
+    typename FlatTree<TBv>::TNodes& nodes,
+    unsigned maxLeafSize = 1,
+    unsigned levels = ~0u
+    )
+{
+    unsigned result = nodes.size();
+    unsigned size = end - begin;
+    nodes.push_back(SFlatNode<TBv>());
+    TBv bv = createBoundingVolume<TBv>(vertices, indices + begin, size);
+    std::uint32_t index = begin;
+    std::uint32_t count = size;
+    if (levels == ~0u)
+    {
+        levels = getDepthLimit(size);
+    }
+
+    if (size > maxLeafSize && size > 1)
+    {
+        unsigned middle = begin;
+        if (!needsSplitByCount(size, levels))
+        {
+            TSplitter splitter(bv);
+            middle = splitter.partition(vertices, indices + begin, indices + end) - indices;
+        }
+
+        if (middle == begin || middle == end)
+        {
+            middle = partitionByCount(bv, vertices, indices + begin, indices + end) - indices;
+        }
+
+        buildFlatNode<TBv, TSplitter>(vertices, indices, begin, middle, nodes, maxLeafSize, levels - 1);
+        index = buildFlatNode<TBv, TSplitter>(vertices, indices, middle, end, nodes, maxLeafSize, levels - 1);
+        count = 0;
+    }
+
+    SFlatNode<TBv>& node = nodes[result];
+    node.bv = bv;
+    node.index = index;
+    node.count = count;
+
+    return result;
+}
+
+/**
+ * Creates a flat binary tree based on bounding volume and splitter.
+ * All nodes are allocated at once.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ * @param Original vertices.
+ * @param[out] Created tree.
+ * @param Maximal number of vertices in a leaf.
+ */
+template<class TBv, class TSplitter = SplitterByCenter<TBv> >
+void buildTree(const TVertices& vertices, FlatTree<TBv>& tree, unsigned maxLeafSize = 1)
+{
+    unsigned size = vertices.size();
+    typename FlatTree<TBv>::TNodes nodes;
+    typename FlatTree<TBv>::TIndices indices(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        indices[i] = i;
+    }
+
+    if (size > 0)
+    {
+        nodes.reserve(2 * size - 1);
+        buildFlatNode<TBv, TSplitter>(vertices.data(), indices.data(), 0, size, nodes, maxLeafSize);
+    }
+
+    TVertices ordered(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        ordered[i] = vertices[indices[i]];
+    }
+
+    tree = FlatTree<TBv>(std::move(nodes), std::move(ordered), std::move(indices));
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_FLATTREE
@@ -10,9 +10,15 @@
 #define BVH3_NODE
 
 #include <bvh3/types/SVertex.hpp>
+#include <bvh3/types/SVertexRange.hpp>
+#include <bvh3/types/STransform.hpp>
+#include <bvh3/bv/all.hpp>
 #include <bvh3/splitters/SplitterByCenter.hpp>
+#include <bvh3/traversal/PairTraversal.hpp>
+#include <algorithm>
 #include <vector>
 #include <utility>
+#include <memory>
 
 namespace NBvh3
 {
@@ -37,6 +43,21 @@ public:
      */
     typedef std::vector<TMatchedNodes> TCollidedNodes;
 
+    /**
+     * Indices of vertices as they were submitted to buildTree().
+     */
+    typedef std::vector<unsigned> TIndices;
+
+    /**
+     * Indices shared by all nodes of the tree.
+     */
+    typedef std::shared_ptr<TIndices> TSharedIndices;
+
+    /**
+     * Pairs of indices of vertices as they were submitted to buildTree() that should not be matched.
+     */
+    typedef std::vector<std::pair<unsigned, unsigned> > TExcludedPairs;
+
     /**
      * @param Computed bounding volume.
      * @param Source vertices.
@@ -50,6 +71,45 @@ public:
      * @param Source vertices.
      */
     Node(const TBv& bv, const TVertices& vertices);
+
+    /**
+     * @param Computed bounding volume.
+     * @param Vertices shared by all nodes of the tree.
+     * @param Index of the first vertex of the node.
+     * @param Index after the last vertex of the node.
+     * @param Left subtree.
+     * @param Right subtree.
+     */
+    Node(
+        const TBv& bv,
+        const TSharedVertices& vertices,
+        unsigned begin,
+        unsigned end,
+        Node* left,
+        Node* right
+        );
+
+    /**
+     * @param Computed bounding volume.
+     * @param Vertices shared by all nodes of the tree.
+     * @param Submitted indices of the range of shared vertices of the tree, shared by all nodes of the tree.
+     * @param Index of the shared vertex the first submitted index belongs to.
+     * @param Index of the first vertex of the node.
+     * @param Index after the last vertex of the node.
+     * @param Left subtree.
+     * @param Right subtree.
+     */
+    Node(
+        const TBv& bv,
+        const TSharedVertices& vertices,
+        const TSharedIndices& indices,
+        unsigned indicesBegin,
+        unsigned begin,
+        unsigned end,
+        Node* left,
+        Node* right
+        );
+
     ~Node();
 
     /**
@@ -60,13 +120,40 @@ public:
     /**
      * Returns submitted vertices to current node.
      */
-    const TVertices& getVertices() const;
+    SVertexRange getVertices() const;
+
+    /**
+     * Returns index of the first vertex of current node in shared vertices.
+     */
+    unsigned getBegin() const;
+
+    /**
+     * Returns index after the last vertex of current node in shared vertices.
+     */
+    unsigned getEnd() const;
+
+    /**
+     * Returns index of the shared vertex as it was submitted to buildTree().
+     * Shared vertices are reordered by the build, trees created without indices keep the order.
+     *
+     * @param Index of the vertex in shared vertices.
+     */
+    unsigned getIndex(unsigned index) const;
 
     /**
      * Returns submitted bounding volume.
      */
     const TBv& getBoundingVolume() const;
 
+    /**
+     * Returns bounding volume of the node moved by the transform.
+     * Computed from transformed vertices for small nodes and conservatively
+     * from transformed corners of the box of the bounding volume for others.
+     *
+     * @param Rigid transform.
+     */
+    TBv getBoundingVolume(const STransform& transform) const;
+
     /**
      * Returns left subtree.
      */
@@ -77,6 +164,33 @@ public:
      */
     const Node* getRight() const;
 
+    /**
+     * Returns left subtree to restructure it.
+     */
+    Node* getLeft();
+
+    /**
+     * Returns right subtree to restructure it.
+     */
+    Node* getRight();
+
+    /**
+     * Replaces the bounding volume and subtrees, e.g. to restructure the tree by rotations.
+     * Previous subtrees are not deleted and ranges of vertices are not changed, see relayout().
+     *
+     * @param Bounding volume of both subtrees.
+     * @param Left subtree.
+     * @param Right subtree.
+     */
+    void setChildren(const TBv& bv, Node* left, Node* right);
+
+    /**
+     * Reorders the range of shared vertices of the node and their submitted indices by leaves in depth-first order,
+     * so each node of the restructured tree refers to continuous range of them again.
+     * Vertices outside of the range, e.g. of other trees, are kept.
+     */
+    void relayout();
+
     /**
      * Checks if current node overlapped other.
      */
@@ -89,8 +203,9 @@ public:
 
     /**
      * Checks if current and query node collided.
-     * Returns matched pairs of nodes.
-     * Traverses the tree recursivelly.
+     * Returns all overlapped pairs of nodes, internal ones included; see collidedLeaves() for leaves only.
+     * Traverses the tree iteratively with its own explicit stack, not by visit(),
+     * because pairs of internal nodes are stored too.
      *
      * @param Query node.
      * @param[out] Container to store matched pairs of nodes.
@@ -98,18 +213,145 @@ public:
      */
     bool collided(const Node<TBv>* query, TCollidedNodes& output) const;
 
+    /**
+     * Checks if leaves of current and query node collided.
+     * Unlike collided(), returns only overlapped pairs of leaves.
+     * Stores pairs found by the same traversal as visit().
+     *
+     * @param Query node.
+     * @param[out] Container to store matched pairs of leaves.
+     * @return true If collided.
+     */
+    bool collidedLeaves(const Node<TBv>* query, TCollidedNodes& output) const;
+
+    /**
+     * Checks if leaves of current node and the query node placed by the transform collided,
+     * so trees of rigid objects are built once in their own space.
+     * Bounding volumes of query nodes are transformed only when visited.
+     * Unlike collided(), returns only overlapped pairs of leaves.
+     *
+     * @param Query node.
+     * @param Rigid transform from space of the query to space of current node.
+     * @param[out] Container to store matched pairs of leaves.
+     * @return true If collided.
+     */
+    bool collidedLeaves(const Node<TBv>* query, const STransform& transform, TCollidedNodes& output) const;
+
+    /**
+     * Calls the visitor for every pair of equal vertices of overlapped leaves
+     * without storing pairs of nodes.
+     * The visitor is called as visitor(index, queryIndex) with indices of vertices in shared vertices
+     * and returns false to stop the traversal.
+     * The node with bigger bounding volume is descended first.
+     *
+     * @param Query node.
+     * @param Visitor of pairs of vertices.
+     * @return false If stopped by the visitor.
+     */
+    template<class TVisitor>
+    bool visit(const Node<TBv>* query, TVisitor&& visitor) const;
+
+    /**
+     * Checks if any leaves of current and query nodes overlap.
+     * Stops at the first pair of overlapped leaves and does not allocate memory:
+     * pairs are kept in a fixed stack, a pair that does not fit is checked by a nested call.
+     *
+     * @param Query node.
+     * @return true If intersected.
+     */
+    bool intersects(const Node<TBv>* query) const;
+
+    /**
+     * Checks if leaves of current tree collided with each other.
+     * Each unordered pair of subtrees is tested once and a leaf is not matched with itself,
+     * so it is about twice cheaper than collided(this, output).
+     *
+     * @param[out] Container to store matched pairs of different leaves.
+     * @return true If collided.
+     */
+    bool selfCollided(TCollidedNodes& output) const;
+
+    /**
+     * Checks if leaves of current tree collided with each other skipping excluded pairs,
+     * like neighbouring vertices of a mesh.
+     * A pair of leaves is skipped if all pairs of their vertices are excluded.
+     *
+     * @param Excluded pairs of submitted indices of vertices in any order, see getIndex().
+     * @param[out] Container to store matched pairs of different leaves.
+     * @return true If collided.
+     */
+    bool selfCollided(const TExcludedPairs& excluded, TCollidedNodes& output) const;
+
 private:
 
+    /**
+     * Copies vertices of leaves in depth-first order and updates ranges of nodes.
+     *
+     * @param Vertices of the tree before.
+     * @param Index of the first vertex of the root.
+     * @param[out] Vertices of the range of the root in the new order.
+     * @param[out] Submitted indices of the range of the root in the new order.
+     * @param Submitted indices shared by all nodes after.
+     * @param Index of the shared vertex the first of the indices belongs to.
+     */
+    void relayout(
+        const SVertex* source,
+        unsigned offset,
+        TVertices& target,
+        TIndices& targetIndices,
+        const TSharedIndices& indices,
+        unsigned indicesBegin
+        );
+
+    /**
+     * Calls the handler for every pair of overlapped leaves as handler(leaf, queryLeaf).
+     * The handler returns false to stop the traversal.
+     * The node with bigger bounding volume is descended first.
+     * Pairs are kept in a fixed stack like by intersects(), a pair that does not fit is visited by a nested call.
+     *
+     * @param Query node.
+     * @param Handler of pairs of leaves.
+     * @return false If stopped by the handler.
+     */
+    template<class THandler>
+    bool visitLeaves(const Node<TBv>* query, THandler&& handler) const;
+
+    /**
+     * Checks if all pairs of vertices of both leaves are in sorted excluded pairs.
+     */
+    bool excluded(const Node<TBv>* leaf, const TExcludedPairs& excluded) const;
+
     /**
      * Bounding volume.
      */
     TBv mBv;
 
     /**
-     * Original vertices submitted to the node.
-     * @todo Avoid copying. Use indices instead?
+     * Vertices of the whole tree.
+     * Node owns only [mBegin, mEnd) range of them.
+     */
+    TSharedVertices mVertices;
+
+    /**
+     * Submitted indices of the range of shared vertices of the tree.
+     * Could be 0 if vertices are not reordered.
+     */
+    TSharedIndices mIndices;
+
+    /**
+     * Index of the shared vertex the first of mIndices belongs to.
      */
-    TVertices mVertices;
+    unsigned mIndicesBegin;
+
+    /**
+     * Index of the first vertex.
+     */
+    unsigned mBegin;
+
+    /**
+     * Index after the last vertex.
+     */
+    unsigned mEnd;
 
     /**
      * Left subtree.
@@ -125,7 +367,11 @@ private:
 template<class TBv>
 Node<TBv>::Node(const TBv& bv, const TVertices& vertices, Node* left, Node* right)
     : mBv(bv)
-    , mVertices(vertices)
+    , mVertices(std::make_shared<TVertices>(vertices))
+    , mIndices()
+    , mIndicesBegin(0)
+    , mBegin(0)
+    , mEnd(vertices.size())
     , mLeft(left)
     , mRight(right)
 {
@@ -133,10 +379,42 @@ Node<TBv>::Node(const TBv& bv, const TVertices& vertices, Node* left, Node* righ
 
 template<class TBv>
 Node<TBv>::Node(const TBv& bv, const TVertices& vertices)
+    : Node(bv, vertices, 0, 0)
+{
+}
+
+template<class TBv>
+Node<TBv>::Node(
+    const TBv& bv,
+    const TSharedVertices& vertices,
+    unsigned begin,
+    unsigned end,
+    Node* left,
+    Node* right
+    )
+    : Node(bv, vertices, TSharedIndices(), 0, begin, end, left, right)
+{
+}
+
+template<class TBv>
+Node<TBv>::Node(
+    const TBv& bv,
+    const TSharedVertices& vertices,
+    const TSharedIndices& indices,
+    unsigned indicesBegin,
+    unsigned begin,
+    unsigned end,
+    Node* left,
+    Node* right
+    )
     : mBv(bv)
     , mVertices(vertices)
-    , mLeft(0)
-    , mRight(0)
+    , mIndices(indices)
+    , mIndicesBegin(indicesBegin)
+    , mBegin(begin)
+    , mEnd(end)
+    , mLeft(left)
+    , mRight(right)
 {
 }
 
@@ -152,6 +430,82 @@ const Node<TBv>* Node<TBv>::getRight() const
     return mRight;
 }
 
+template<class TBv>
+Node<TBv>* Node<TBv>::getLeft()
+{
+    return mLeft;
+}
+
+template<class TBv>
+Node<TBv>* Node<TBv>::getRight()
+{
+    return mRight;
+}
+
+template<class TBv>
+void Node<TBv>::setChildren(const TBv& bv, Node* left, Node* right)
+{
+    mBv = bv;
+    mLeft = left;
+    mRight = right;
+}
+
+template<class TBv>
+void Node<TBv>::relayout()
+{
+    TVertices& shared = *mVertices;
+    unsigned begin = mBegin;
+    unsigned size = mEnd - begin;
+    TVertices vertices;
+    vertices.reserve(size);
+    TIndices order;
+    order.reserve(size);
+
+    // Trees without indices keep the submitted order, so indices are created for the reordered range.
+    TSharedIndices indices = mIndices;
+    unsigned indicesBegin = mIndicesBegin;
+    if (!indices)
+    {
+        indices = std::make_shared<TIndices>(size);
+        indicesBegin = begin;
+    }
+
+    relayout(shared.data(), begin, vertices, order, indices, indicesBegin);
+    std::copy(vertices.begin(), vertices.end(), shared.begin() + begin);
+    std::copy(order.begin(), order.end(), indices->begin() + (begin - indicesBegin));
+}
+
+template<class TBv>
+void Node<TBv>::relayout(
+    const SVertex* source,
+    unsigned offset,
+    TVertices& target,
+    TIndices& targetIndices,
+    const TSharedIndices& indices,
+    unsigned indicesBegin
+    )
+{
+    unsigned begin = offset + target.size();
+    if (isLeaf())
+    {
+        for (unsigned i = mBegin; i < mEnd; ++i)
+        {
+            target.push_back(source[i]);
+            targetIndices.push_back(getIndex(i));
+        }
+    }
+    else
+    {
+        mLeft->relayout(source, offset, target, targetIndices, indices, indicesBegin);
+        mRight->relayout(source, offset, target, targetIndices, indices, indicesBegin);
+    }
+
+    mBegin = begin;
+    mEnd = offset + target.size();
+    mIndices = indices;
+    mIndicesBegin = indicesBegin;
+}
+
 template<class TBv>
 Node<TBv>::~Node()
 {
@@ -178,9 +532,28 @@ bool Node<TBv>::isLeaf() const
 }
 
 template<class TBv>
-const TVertices& Node<TBv>::getVertices() const
+SVertexRange Node<TBv>::getVertices() const
 {
-    return mVertices;
+    const SVertex* data = mVertices->data();
+    return SVertexRange(data + mBegin, data + mEnd);
+}
+
+template<class TBv>
+unsigned Node<TBv>::getBegin() const
+{
+    return mBegin;
+}
+
+template<class TBv>
+unsigned Node<TBv>::getEnd() const
+{
+    return mEnd;
+}
+
+template<class TBv>
+unsigned Node<TBv>::getIndex(unsigned index) const
+{
+    return mIndices ? (*mIndices)[index - mIndicesBegin] : index;
 }
 
 template<class TBv>
@@ -189,76 +562,529 @@ const TBv& Node<TBv>::getBoundingVolume() const
     return mBv;
 }
 
+template<class TBv>
+TBv Node<TBv>::getBoundingVolume(const STransform& transform) const
+{
+    // Transforming as many vertices as corners of the box is exact and not slower.
+    if (mEnd - mBegin > 8)
+    {
+        return transformBoundingVolume(mBv, transform);
+    }
+
+    TBv result;
+    const SVertex* vertices = mVertices->data();
+    for (unsigned i = mBegin; i < mEnd; ++i)
+    {
+        result += transform(vertices[i]);
+    }
+
+    return result;
+}
+
 template<class TBv>
 bool Node<TBv>::collided(const Node<TBv>* query, TCollidedNodes& output) const
 {
-    bool result = false;
-    if (overlapped(query))
+    // Emulates recursion: a call stores the pair and schedules children of the node,
+    // a child stores its pair with the query and schedules calls for children of the query.
+    struct STask
     {
+        const Node<TBv>* node;
+        const Node<TBv>* query;
+        bool call;
+    };
+
+    if (!overlapped(query))
+    {
+        return false;
+    }
+
+    // Only overlapped pairs are pushed in reversed order, so popped ones are stored right away.
+    std::vector<STask> stack;
+    stack.reserve(64);
+    STask first = {this, query, true};
+    stack.push_back(first);
+    while (!stack.empty())
+    {
+        STask task = stack.back();
+        stack.pop_back();
+
         /// Stores any pairs that overlapped.
-        output.push_back(std::make_pair(this, query));
+        output.push_back(std::make_pair(task.node, task.query));
+        const Node<TBv>* children[2];
+        if (task.call)
+        {
+            children[0] = task.node->getRight();
+            children[1] = task.node->getLeft();
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                if (children[i] != 0 && children[i]->overlapped(task.query))
+                {
+                    STask child = {children[i], task.query, false};
+                    stack.push_back(child);
+                }
+            }
+        }
+        else
+        {
+            children[0] = task.query->getRight();
+            children[1] = task.query->getLeft();
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                if (task.node->overlapped(children[i]))
+                {
+                    STask call = {task.node, children[i], true};
+                    stack.push_back(call);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+template<class TBv>
+bool Node<TBv>::collidedLeaves(const Node<TBv>* query, TCollidedNodes& output) const
+{
+    unsigned size = output.size();
+    visitLeaves(query, [&output](const Node<TBv>* leaf, const Node<TBv>* queryLeaf) {
+        output.push_back(std::make_pair(leaf, queryLeaf));
+        return true;
+    });
+
+    return output.size() != size;
+}
+
+template<class TBv>
+bool Node<TBv>::collidedLeaves(const Node<TBv>* query, const STransform& transform, TCollidedNodes& output) const
+{
+    struct STask
+    {
+        const Node<TBv>* node;
+        const Node<TBv>* query;
+        TBv queryBv;
+    };
+
+    unsigned size = output.size();
+    if (query == 0)
+    {
+        return false;
+    }
+
+    std::vector<STask> stack;
+    stack.reserve(64);
+    STask first = {this, query, query->getBoundingVolume(transform)};
+    stack.push_back(first);
+    while (!stack.empty())
+    {
+        STask task = stack.back();
+        stack.pop_back();
+        if (!task.node->mBv.overlapped(task.queryBv))
+        {
+            continue;
+        }
+
+        if (task.node->isLeaf() && task.query->isLeaf())
+        {
+            output.push_back(std::make_pair(task.node, task.query));
+            continue;
+        }
+
+        bool descend = task.query->isLeaf()
+            || (!task.node->isLeaf() && getSize(task.node->mBv) >= getSize(task.queryBv));
+        const Node<TBv>* parent = descend ? task.node : task.query;
+        const Node<TBv>* children[2] = {parent->mRight, parent->mLeft};
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            if (children[i] != 0)
+            {
+                STask child = descend
+                    ? STask{children[i], task.query, task.queryBv}
+                    : STask{task.node, children[i], children[i]->getBoundingVolume(transform)};
+                stack.push_back(child);
+            }
+        }
+    }
+
+    return output.size() != size;
+}
+
+template<class TBv>
+template<class TVisitor>
+bool Node<TBv>::visit(const Node<TBv>* query, TVisitor&& visitor) const
+{
+    return visitLeaves(query, [&visitor](const Node<TBv>* leaf, const Node<TBv>* queryLeaf) {
+        const SVertex* vertices = leaf->mVertices->data();
+        const SVertex* queryVertices = queryLeaf->mVertices->data();
+        for (unsigned i = leaf->mBegin; i < leaf->mEnd; ++i)
+        {
+            for (unsigned j = queryLeaf->mBegin; j < queryLeaf->mEnd; ++j)
+            {
+                if (vertices[i] == queryVertices[j] && !visitor(i, j))
+                {
+                    return false;
+                }
+            }
+        }
 
-        result = true;
-        auto leftQuery = query->getLeft();
-        auto rightQuery = query->getRight();
-        auto left = getLeft();
-        auto right = getRight();
+        return true;
+    });
+}
 
-        if (left != 0 && left->overlapped(query))
+template<class TBv>
+template<class THandler>
+bool Node<TBv>::visitLeaves(const Node<TBv>* query, THandler&& handler) const
+{
+    static const unsigned CAPACITY = 64;
+    TMatchedNodes stack[CAPACITY];
+    unsigned size = 0;
+    if (overlapped(query))
+    {
+        stack[size++] = std::make_pair(this, query);
+    }
+
+    while (size > 0)
+    {
+        const Node<TBv>* node = stack[size - 1].first;
+        const Node<TBv>* queryNode = stack[--size].second;
+        if (node->isLeaf() && queryNode->isLeaf())
         {
-            output.push_back(std::make_pair(left, query));
+            if (!handler(node, queryNode))
+            {
+                return false;
+            }
 
-            left->collided(leftQuery, output);
-            left->collided(rightQuery, output);
+            continue;
         }
 
-        if (right != 0 && right->overlapped(query))
+        bool descend = queryNode->isLeaf()
+            || (!node->isLeaf() && getSize(node->mBv) >= getSize(queryNode->mBv));
+        const Node<TBv>* parent = descend ? node : queryNode;
+        const Node<TBv>* children[2] = {parent->mRight, parent->mLeft};
+        for (unsigned i = 0; i < 2; ++i)
         {
-            output.push_back(std::make_pair(right, query));
+            TMatchedNodes pair = descend
+                ? std::make_pair(children[i], queryNode)
+                : std::make_pair(node, children[i]);
 
-            right->collided(leftQuery, output);
-            right->collided(rightQuery, output);
+            if (children[i] == 0 || !pair.first->overlapped(pair.second))
+            {
+                continue;
+            }
+
+            // Deeper pairs are visited by a nested traversal with its own stack.
+            if (size < CAPACITY)
+            {
+                stack[size++] = pair;
+            }
+            else if (!pair.first->visitLeaves(pair.second, handler))
+            {
+                return false;
+            }
         }
     }
 
-    return result;
+    return true;
+}
+
+template<class TBv>
+bool Node<TBv>::intersects(const Node<TBv>* query) const
+{
+    static const unsigned CAPACITY = 64;
+    TMatchedNodes stack[CAPACITY];
+    unsigned size = 0;
+    if (overlapped(query))
+    {
+        stack[size++] = std::make_pair(this, query);
+    }
+
+    while (size > 0)
+    {
+        const Node<TBv>* node = stack[size - 1].first;
+        const Node<TBv>* queryNode = stack[--size].second;
+        if (node->isLeaf() && queryNode->isLeaf())
+        {
+            return true;
+        }
+
+        bool descend = queryNode->isLeaf()
+            || (!node->isLeaf() && getSize(node->mBv) >= getSize(queryNode->mBv));
+        const Node<TBv>* parent = descend ? node : queryNode;
+        const Node<TBv>* children[2] = {parent->mRight, parent->mLeft};
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            TMatchedNodes pair = descend
+                ? std::make_pair(children[i], queryNode)
+                : std::make_pair(node, children[i]);
+
+            if (children[i] == 0 || !pair.first->overlapped(pair.second))
+            {
+                continue;
+            }
+
+            if (size < CAPACITY)
+            {
+                stack[size++] = pair;
+            }
+            else if (pair.first->intersects(pair.second))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+template<class TBv>
+bool Node<TBv>::selfCollided(TCollidedNodes& output) const
+{
+    return selfCollided(TExcludedPairs(), output);
+}
+
+template<class TBv>
+bool Node<TBv>::selfCollided(const TExcludedPairs& excluded, TCollidedNodes& output) const
+{
+    TExcludedPairs sorted;
+    sorted.reserve(excluded.size());
+    for (unsigned i = 0; i < excluded.size(); ++i)
+    {
+        unsigned first = excluded[i].first;
+        unsigned second = excluded[i].second;
+        sorted.push_back(std::make_pair(std::min(first, second), std::max(first, second)));
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+
+    // A pair of the same node stands for pairs of all leaves inside it.
+    unsigned size = output.size();
+    std::vector<TMatchedNodes> stack;
+    stack.reserve(64);
+    stack.push_back(std::make_pair(this, this));
+    while (!stack.empty())
+    {
+        const Node<TBv>* node = stack.back().first;
+        const Node<TBv>* other = stack.back().second;
+        stack.pop_back();
+
+        if (node == other)
+        {
+            if (node->mLeft != 0 && node->mRight != 0)
+            {
+                stack.push_back(std::make_pair(node->mRight, node->mRight));
+                stack.push_back(std::make_pair(node->mLeft, node->mLeft));
+                if (node->mLeft->overlapped(node->mRight))
+                {
+                    stack.push_back(std::make_pair(node->mLeft, node->mRight));
+                }
+            }
+            else if (node->mLeft != 0 || node->mRight != 0)
+            {
+                const Node<TBv>* child = node->mLeft != 0 ? node->mLeft : node->mRight;
+                stack.push_back(std::make_pair(child, child));
+            }
+
+            continue;
+        }
+
+        if (node->isLeaf() && other->isLeaf())
+        {
+            if (sorted.empty() || !node->excluded(other, sorted))
+            {
+                output.push_back(std::make_pair(node, other));
+            }
+
+            continue;
+        }
+
+        bool descend = other->isLeaf()
+            || (!node->isLeaf() && getSize(node->mBv) >= getSize(other->mBv));
+        const Node<TBv>* parent = descend ? node : other;
+        const Node<TBv>* children[2] = {parent->mRight, parent->mLeft};
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            TMatchedNodes pair = descend
+                ? std::make_pair(children[i], other)
+                : std::make_pair(node, children[i]);
+
+            if (children[i] != 0 && pair.first->overlapped(pair.second))
+            {
+                stack.push_back(pair);
+            }
+        }
+    }
+
+    return output.size() != size;
+}
+
+template<class TBv>
+bool Node<TBv>::excluded(const Node<TBv>* leaf, const TExcludedPairs& excluded) const
+{
+    for (unsigned i = mBegin; i < mEnd; ++i)
+    {
+        for (unsigned j = leaf->mBegin; j < leaf->mEnd; ++j)
+        {
+            unsigned first = getIndex(i);
+            unsigned second = leaf->getIndex(j);
+            if (!std::binary_search(
+                    excluded.begin(),
+                    excluded.end(),
+                    std::make_pair(std::min(first, second), std::max(first, second))
+                    ))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
 /**
- * Creates a binary tree based on bounding volume and splitter.
+ * Creates a subtree on [begin, end) range of indices of shared vertices.
+ * Ranges are split by count when the splitter leaves one part empty
+ * or the rest of levels is just enough for a balanced subtree.
  *
  * @tparam Bounding volume type.
  * @tparam TSplitter Splits submitted vertices by some logic.
- * @param Original vertices.
+ * @param Vertices shared by all nodes, not changed.
+ * @param Indices of vertices of the tree shared by all nodes, reordered in place.
+ * @param Index of the shared vertex the first of the indices belongs to.
+ * @param First index of the range.
+ * @param Index after the last one.
+ * @param Number of levels the subtree could take below its root.
  * @return Pointer to Node. Should be freed by user.
  */
-template<class TBv, class TSplitter = SplitterByCenter<TBv> >
-Node<TBv>* buildTree(const TVertices& vertices)
+template<class TBv, class TSplitter>
+Node<TBv>* buildNode(
+    const TSharedVertices& vertices,
+    const typename Node<TBv>::TSharedIndices& indices,
+    unsigned indicesBegin,
+    unsigned begin,
+    unsigned end,
+    unsigned levels
+    )
 {
-    TBv bv = createBoundingVolume<TBv>(vertices);
+    const SVertex* data = vertices->data();
+    unsigned* order = indices->data();
+    unsigned* first = order + (begin - indicesBegin);
+    unsigned* last = order + (end - indicesBegin);
+    auto size = end - begin;
+    TBv bv = createBoundingVolume<TBv>(data, first, size);
     Node<TBv>* result = 0;
     Node<TBv>* nodeLeft = 0;
     Node<TBv>* nodeRight = 0;
-    auto size = vertices.size();
     if (size > 1)
     {
-        TSplitter splitter(vertices, bv);
-        TVertices left;
-        TVertices right;
-        splitter.split(left, right);
+        unsigned* middle = first;
+        if (!needsSplitByCount(size, levels))
+        {
+            TSplitter splitter(bv);
+            middle = splitter.partition(data, first, last);
+        }
+
+        if (middle == first || middle == last)
+        {
+            middle = partitionByCount(bv, data, first, last);
+        }
 
-        nodeLeft = buildTree<TBv, TSplitter>(left);
-        nodeRight = buildTree<TBv, TSplitter>(right);
+        unsigned split = begin + (middle - first);
+        nodeLeft = buildNode<TBv, TSplitter>(vertices, indices, indicesBegin, begin, split, levels - 1);
+        nodeRight = buildNode<TBv, TSplitter>(vertices, indices, indicesBegin, split, end, levels - 1);
     }
 
     if (size > 0)
     {
-        result = new Node<TBv>(bv, vertices, nodeLeft, nodeRight);
+        result = new Node<TBv>(bv, vertices, indices, indicesBegin, begin, end, nodeLeft, nodeRight);
     }
 
     return result;
 }
 
+/**
+ * Creates a binary tree on [begin, end) range of shared vertices.
+ * Reorders the vertices in place, so each node gets continuous range of them.
+ * Submitted indices of reordered vertices are kept by the tree, see Node::getIndex().
+ * The indices and the temporary copy of reordered vertices are sized to the range.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ * @param Vertices shared by all nodes.
+ * @param Index of the first vertex.
+ * @param Index after the last vertex.
+ * @param Number of levels the tree could take below the root.
+ * @return Pointer to Node. Should be freed by user.
+ */
+template<class TBv, class TSplitter = SplitterByCenter<TBv> >
+Node<TBv>* buildTree(const TSharedVertices& vertices, unsigned begin, unsigned end, unsigned levels)
+{
+    auto indices = std::make_shared<typename Node<TBv>::TIndices>(end - begin);
+    typename Node<TBv>::TIndices& order = *indices;
+    for (unsigned i = 0; i < order.size(); ++i)
+    {
+        order[i] = begin + i;
+    }
+
+    Node<TBv>* result = buildNode<TBv, TSplitter>(vertices, indices, begin, begin, end, levels);
+
+    // Vertices are copied once the order of leaves is known.
+    TVertices reordered;
+    reordered.reserve(order.size());
+    for (unsigned i = 0; i < order.size(); ++i)
+    {
+        reordered.push_back((*vertices)[order[i]]);
+    }
+
+    std::copy(reordered.begin(), reordered.end(), vertices->begin() + begin);
+    return result;
+}
+
+/**
+ * Creates a binary tree on [begin, end) range of shared vertices.
+ * The tree is not deeper than twice a balanced one.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ * @param Vertices shared by all nodes.
+ * @param Index of the first vertex.
+ * @param Index after the last vertex.
+ * @return Pointer to Node. Should be freed by user.
+ */
+template<class TBv, class TSplitter = SplitterByCenter<TBv> >
+Node<TBv>* buildTree(const TSharedVertices& vertices, unsigned begin, unsigned end)
+{
+    return buildTree<TBv, TSplitter>(vertices, begin, end, getDepthLimit(end - begin));
+}
+
+/**
+ * Creates a binary tree based on bounding volume and splitter.
+ * Reorders submitted vertices in place, see buildTree() of a range.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ * @param Vertices to be shared by all nodes.
+ * @return Pointer to Node. Should be freed by user.
+ */
+template<class TBv, class TSplitter = SplitterByCenter<TBv> >
+Node<TBv>* buildTree(const TSharedVertices& vertices)
+{
+    return buildTree<TBv, TSplitter>(vertices, 0, vertices->size());
+}
+
+/**
+ * Creates a binary tree based on bounding volume and splitter.
+ * Vertices are copied once and shared by all nodes.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ * @param Original vertices.
+ * @return Pointer to Node. Should be freed by user.
+ */
+template<class TBv, class TSplitter = SplitterByCenter<TBv> >
+Node<TBv>* buildTree(const TVertices& vertices)
+{
+    return buildTree<TBv, TSplitter>(std::make_shared<TVertices>(vertices));
+}
+
 } // namespace NBvh3
 
 #endif // BVH3_NODE
\ No newline at end of file
@@ -0,0 +1,138 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_STATISTICS
+#define BVH3_STATISTICS
+
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Node.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Returns number of levels of the tree.
+ */
+template<class TBv>
+unsigned getDepth(const FlatTree<TBv>& tree)
+{
+    unsigned result = 0;
+    std::vector<std::pair<unsigned, unsigned> > stack;
+    if (!tree.empty())
+    {
+        stack.push_back(std::make_pair(0u, 1u));
+    }
+
+    while (!stack.empty())
+    {
+        unsigned node = stack.back().first;
+        unsigned depth = stack.back().second;
+        stack.pop_back();
+        result = std::max(result, depth);
+        if (!tree.isLeaf(node))
+        {
+            stack.push_back(std::make_pair(tree.getLeft(node), depth + 1));
+            stack.push_back(std::make_pair(tree.getRight(node), depth + 1));
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Returns surface area heuristic cost of the tree:
+ * sum of areas of internal nodes and areas of leaves multiplied by number of their vertices,
+ * relative to the area of the root. Areas are of boxes, see KDop::getBoxSurfaceArea().
+ */
+template<class TBv>
+float getSurfaceAreaCost(const FlatTree<TBv>& tree)
+{
+    if (tree.empty() || tree.getBoundingVolume(0).getBoxSurfaceArea() <= 0)
+    {
+        return 0;
+    }
+
+    float result = 0;
+    const typename FlatTree<TBv>::TNodes& nodes = tree.getNodes();
+    for (unsigned i = 0; i < nodes.size(); ++i)
+    {
+        float area = nodes[i].bv.getBoxSurfaceArea();
+        result += tree.isLeaf(i) ? area * nodes[i].count : area;
+    }
+
+    return result / tree.getBoundingVolume(0).getBoxSurfaceArea();
+}
+
+/**
+ * Returns number of levels of the tree.
+ */
+template<class TBv>
+unsigned getDepth(const Node<TBv>* root)
+{
+    unsigned result = 0;
+    std::vector<std::pair<const Node<TBv>*, unsigned> > stack;
+    if (root != 0)
+    {
+        stack.push_back(std::make_pair(root, 1u));
+    }
+
+    while (!stack.empty())
+    {
+        const Node<TBv>* node = stack.back().first;
+        unsigned depth = stack.back().second;
+        stack.pop_back();
+        result = std::max(result, depth);
+        if (!node->isLeaf())
+        {
+            stack.push_back(std::make_pair(node->getLeft(), depth + 1));
+            stack.push_back(std::make_pair(node->getRight(), depth + 1));
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Returns surface area heuristic cost of the tree the same way as for a flat tree.
+ */
+template<class TBv>
+float getSurfaceAreaCost(const Node<TBv>* root)
+{
+    if (root == 0 || root->getBoundingVolume().getBoxSurfaceArea() <= 0)
+    {
+        return 0;
+    }
+
+    float result = 0;
+    std::vector<const Node<TBv>*> stack(1, root);
+    while (!stack.empty())
+    {
+        const Node<TBv>* node = stack.back();
+        stack.pop_back();
+        float area = node->getBoundingVolume().getBoxSurfaceArea();
+        if (node->isLeaf())
+        {
+            result += area * (node->getEnd() - node->getBegin());
+        }
+        else
+        {
+            result += area;
+            stack.push_back(node->getLeft());
+            stack.push_back(node->getRight());
+        }
+    }
+
+    return result / root->getBoundingVolume().getBoxSurfaceArea();
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_STATISTICS
@@ -0,0 +1,133 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_BENCHMARK
+#define BVH3_BENCHMARK
+
+#include <bvh3/types/SVertex.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <sys/resource.h>
+
+namespace NBvh3
+{
+
+/**
+ * Measures wall time since creation.
+ */
+class Timer
+{
+public:
+
+    /**
+     * Starts the timer.
+     */
+    Timer()
+        : mStart(std::chrono::steady_clock::now())
+    {
+    }
+
+    /**
+     * Returns elapsed milliseconds.
+     */
+    double getElapsed() const
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - mStart;
+        return elapsed.count();
+    }
+
+private:
+
+    /**
+     * Time point of creation.
+     */
+    std::chrono::steady_clock::time_point mStart;
+};
+
+/**
+ * Returns peak resident memory of current process in kilobytes.
+ */
+inline long getPeakMemory()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Generates uniformly distributed vertices inside a cube.
+ *
+ * @param Number of vertices.
+ * @param Size of the cube.
+ * @param Seed of the generator.
+ */
+inline TVertices generateVertices(unsigned count, float size, unsigned seed = 1)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> distribution(0, size);
+    TVertices result(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        result[i] = SVertex(distribution(generator), distribution(generator), distribution(generator));
+    }
+
+    return result;
+}
+
+/**
+ * Generates vertices gathered in clusters of different size like LiDAR scans.
+ *
+ * @param Number of vertices.
+ * @param Number of clusters.
+ * @param Size of the cube containing cluster centers.
+ * @param Seed of the generator of vertices.
+ * @param Seed of the generator of clusters.
+ */
+inline TVertices generateClusters(unsigned count, unsigned clusters, float size, unsigned seed = 1, unsigned clusterSeed = 1)
+{
+    std::mt19937 clusterGenerator(clusterSeed);
+    std::uniform_real_distribution<float> position(0, size);
+    std::uniform_real_distribution<float> spread(size / 1000, size / 20);
+    std::vector<SVertex> centers(clusters);
+    std::vector<SVertex> spreads(clusters);
+    for (unsigned i = 0; i < clusters; ++i)
+    {
+        centers[i] = SVertex(position(clusterGenerator), position(clusterGenerator), position(clusterGenerator));
+        spreads[i] = SVertex(spread(clusterGenerator), spread(clusterGenerator), spread(clusterGenerator) / 10);
+    }
+
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<unsigned> cluster(0, clusters - 1);
+    std::normal_distribution<float> offset;
+    TVertices result(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned c = cluster(generator);
+        result[i] = SVertex(
+            centers[c].x + offset(generator) * spreads[c].x,
+            centers[c].y + offset(generator) * spreads[c].y,
+            centers[c].z + offset(generator) * spreads[c].z
+            );
+    }
+
+    return result;
+}
+
+/**
+ * Returns numeric command line argument or default value.
+ */
+inline unsigned getArgument(int argc, char** argv, int index, unsigned defaultValue)
+{
+    return index < argc ? std::strtoul(argv[index], 0, 10) : defaultValue;
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_BENCHMARK
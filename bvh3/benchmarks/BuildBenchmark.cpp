@@ -0,0 +1,112 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Compares peak memory and build time of the tree that copies vertices
+ * into every node against the tree that shares one reordered array.
+ *
+ * Usage: BuildBenchmark [count] [copy|shared]
+ * Runs both builders in separate processes if the builder is not specified.
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/Node.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+
+/**
+ * Node that keeps own copy of vertices like the tree did before sharing them.
+ */
+struct SCopyNode
+{
+    SCopyNode(const TKDop16& bv, const TVertices& vertices, SCopyNode* left, SCopyNode* right)
+        : mBv(bv), mVertices(vertices), mLeft(left), mRight(right)
+    {
+    }
+
+    ~SCopyNode()
+    {
+        delete mLeft;
+        delete mRight;
+    }
+
+    TKDop16 mBv;
+    TVertices mVertices;
+    SCopyNode* mLeft;
+    SCopyNode* mRight;
+};
+
+SCopyNode* buildCopyTree(const TVertices& vertices)
+{
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    SCopyNode* nodeLeft = 0;
+    SCopyNode* nodeRight = 0;
+    if (vertices.size() > 1)
+    {
+        SplitterByCenter<TKDop16> splitter(vertices, bv);
+        TVertices left;
+        TVertices right;
+        splitter.split(left, right);
+
+        nodeLeft = buildCopyTree(left);
+        nodeRight = buildCopyTree(right);
+    }
+
+    return vertices.empty() ? 0 : new SCopyNode(bv, vertices, nodeLeft, nodeRight);
+}
+
+void run(const char* builder, unsigned count)
+{
+    TVertices vertices = generateVertices(count, 1000);
+    long before = getPeakMemory();
+    Timer timer;
+    if (std::strcmp(builder, "copy") == 0)
+    {
+        delete buildCopyTree(vertices);
+    }
+    else
+    {
+        delete buildTree<TKDop16>(std::make_shared<TVertices>(std::move(vertices)));
+    }
+
+    std::printf(
+        "%-8s vertices: %u build: %.1f ms peak memory: +%ld KB\n",
+        builder,
+        count,
+        timer.getElapsed(),
+        getPeakMemory() - before
+        );
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 200000);
+    if (argc > 2)
+    {
+        run(argv[2], count);
+        return 0;
+    }
+
+    const char* builders[] = {"copy", "shared"};
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        // Separate process per builder to measure its own peak memory.
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            run(builders[i], count);
+            return 0;
+        }
+
+        waitpid(pid, 0, 0);
+    }
+
+    return 0;
+}
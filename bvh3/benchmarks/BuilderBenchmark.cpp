@@ -0,0 +1,87 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Compares builders of flat trees by vertices per second and quality of trees.
+ *
+ * Usage: BuilderBenchmark [number of vertices] [repeats] [threads]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <bvh3/builders/LinearBuilder.hpp>
+#include <bvh3/builders/ParallelBuilder.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TTree;
+
+/**
+ * Builds a tree by center splits.
+ */
+void buildByCenter(const TVertices& vertices, TTree& tree)
+{
+    buildTree<TKDop16>(vertices, tree);
+}
+
+/**
+ * Builds a tree by 30-bit Morton codes.
+ */
+void buildLinear32(const TVertices& vertices, TTree& tree)
+{
+    buildLinearTree<TKDop16, std::uint32_t>(vertices, tree);
+}
+
+/**
+ * Builds a tree by 63-bit Morton codes.
+ */
+void buildLinear64(const TVertices& vertices, TTree& tree)
+{
+    buildLinearTree<TKDop16, std::uint64_t>(vertices, tree);
+}
+
+template<class TBuilder>
+void run(const char* name, const TVertices& vertices, unsigned repeats, TBuilder builder)
+{
+    TTree tree;
+    Timer timer;
+    for (unsigned i = 0; i < repeats; ++i)
+    {
+        builder(vertices, tree);
+    }
+
+    double elapsed = timer.getElapsed() / repeats;
+    std::printf(
+        "%-10s build: %8.1f ms %6.2f M vertices/s depth: %4u cost: %8.1f\n",
+        name,
+        elapsed,
+        vertices.size() / elapsed / 1000,
+        getDepth(tree),
+        getSurfaceAreaCost(tree)
+        );
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 1000000);
+    unsigned repeats = getArgument(argc, argv, 2, 3);
+    unsigned threads = getArgument(argc, argv, 3, 0);
+    TVertices vertices = generateVertices(count, 1000);
+    TaskPool pool(threads);
+
+    run("center", vertices, repeats, buildByCenter);
+    run(
+        "parallel",
+        vertices,
+        repeats,
+        [&pool](const TVertices& vertices, TTree& tree) { buildTree<TKDop16>(vertices, tree, pool); }
+        );
+    run("linear32", vertices, repeats, buildLinear32);
+    run("linear64", vertices, repeats, buildLinear64);
+
+    return 0;
+}
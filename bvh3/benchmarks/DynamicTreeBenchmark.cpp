@@ -0,0 +1,234 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Moves the given percent of objects every frame and compares updating DynamicTree
+ * against rebuilding a flat tree over all objects by time per frame including box queries.
+ * Then loads and unloads a batch of objects next to them one by one and at once.
+ *
+ * Usage: DynamicTreeBenchmark [number of objects] [frames] [queries per frame] [batch size]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/DynamicTree.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/builders/LinearBuilder.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+#include <random>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+
+/**
+ * Radius of objects.
+ */
+const float RADIUS = 0.5f;
+
+TKDop16 createBox(const SVertex& center, float size)
+{
+    TKDop16 result;
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        result += SVertex(center.x + (i & 1 ? size : -size), center.y + (i & 2 ? size : -size), center.z + (i & 4 ? size : -size));
+    }
+
+    return result;
+}
+
+/**
+ * Moves random objects by up to the step along each axis.
+ *
+ * @param[out] Flags of moved objects.
+ */
+void step(TVertices& centers, std::vector<bool>& moved, unsigned percent, std::mt19937& generator)
+{
+    std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+    std::uniform_int_distribution<unsigned> chance(0, 99);
+    for (unsigned i = 0; i < centers.size(); ++i)
+    {
+        moved[i] = chance(generator) < percent;
+        if (moved[i])
+        {
+            centers[i] = SVertex(centers[i].x + offset(generator), centers[i].y + offset(generator), centers[i].z + offset(generator));
+        }
+    }
+}
+
+/**
+ * Counts leaves of the flat tree overlapped the query.
+ */
+unsigned query(const FlatTree<TKDop16>& tree, const TKDop16& bv)
+{
+    unsigned result = 0;
+    std::vector<unsigned> stack(1, 0);
+    while (!stack.empty())
+    {
+        unsigned node = stack.back();
+        stack.pop_back();
+        if (!tree.getBoundingVolume(node).overlapped(bv))
+        {
+            continue;
+        }
+
+        if (tree.isLeaf(node))
+        {
+            ++result;
+        }
+        else
+        {
+            stack.push_back(tree.getRight(node));
+            stack.push_back(tree.getLeft(node));
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 100000);
+    unsigned frames = getArgument(argc, argv, 2, 10);
+    unsigned queries = getArgument(argc, argv, 3, 1000);
+    unsigned batch = getArgument(argc, argv, 4, 50000);
+
+    TVertices queryCenters = generateVertices(queries, 100, 3);
+    const unsigned percents[] = {1, 5, 25, 100};
+    for (unsigned p = 0; p < sizeof(percents) / sizeof(percents[0]); ++p)
+    {
+        unsigned percent = percents[p];
+        {
+            std::mt19937 generator(1);
+            TVertices centers = generateVertices(count, 100);
+            std::vector<bool> moved(count);
+            Timer buildTimer;
+            DynamicTree<TKDop16> tree(0.2f);
+            std::vector<unsigned> proxies(count);
+            for (unsigned i = 0; i < count; ++i)
+            {
+                proxies[i] = tree.insert(createBox(centers[i], RADIUS), i);
+            }
+
+            double build = buildTimer.getElapsed();
+            double update = 0;
+            Timer timer;
+            unsigned found = 0;
+            unsigned reinserted = 0;
+            for (unsigned frame = 0; frame < frames; ++frame)
+            {
+                step(centers, moved, percent, generator);
+                Timer updateTimer;
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    if (moved[i])
+                    {
+                        reinserted += tree.move(proxies[i], createBox(centers[i], RADIUS));
+                    }
+                }
+
+                update += updateTimer.getElapsed();
+                for (unsigned i = 0; i < queries; ++i)
+                {
+                    tree.query(createBox(queryCenters[i], 1), [&found](unsigned) { ++found; return true; });
+                }
+            }
+
+            std::printf("moved %3u%% dynamic  found: %8u time: %8.2f ms per frame, update: %8.2f ms, reinserted: %6u, build: %8.2f ms, height: %d\n",
+                percent, found, timer.getElapsed() / frames, update / frames, reinserted / frames, build, tree.getHeight());
+        }
+
+        {
+            std::mt19937 generator(1);
+            TVertices centers = generateVertices(count, 100);
+            std::vector<bool> moved(count);
+            Timer timer;
+            double rebuild = 0;
+            unsigned found = 0;
+            for (unsigned frame = 0; frame < frames; ++frame)
+            {
+                step(centers, moved, percent, generator);
+                Timer rebuildTimer;
+                FlatTree<TKDop16> tree;
+                buildLinearTree<TKDop16>(centers, tree);
+                rebuild += rebuildTimer.getElapsed();
+
+                // Leaves are centers, so queries are inflated by the radius of objects.
+                for (unsigned i = 0; i < queries; ++i)
+                {
+                    found += query(tree, createBox(queryCenters[i], 1 + RADIUS));
+                }
+            }
+
+            std::printf("moved %3u%% rebuild  found: %8u time: %8.2f ms per frame, rebuild: %8.2f ms\n",
+                percent, found, timer.getElapsed() / frames, rebuild / frames);
+        }
+    }
+
+    // The batch is a level streamed in next to existing objects.
+    TVertices centers = generateVertices(count, 100);
+    TVertices batchCenters = generateVertices(batch, 100, 5);
+    std::vector<TKDop16> bvs(count);
+    std::vector<TKDop16> batchBvs(batch);
+    std::vector<unsigned> data(batch);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        bvs[i] = createBox(centers[i], RADIUS);
+    }
+
+    for (unsigned i = 0; i < batch; ++i)
+    {
+        batchBvs[i] = createBox(SVertex(batchCenters[i].x + 100, batchCenters[i].y, batchCenters[i].z), RADIUS);
+        data[i] = count + i;
+    }
+
+    for (unsigned many = 0; many < 2; ++many)
+    {
+        DynamicTree<TKDop16> tree(0.2f);
+        std::vector<unsigned> proxies;
+        tree.insertMany(bvs, std::vector<unsigned>(count), proxies);
+
+        Timer loadTimer;
+        std::vector<unsigned> batchProxies;
+        if (many)
+        {
+            tree.insertMany(batchBvs, data, batchProxies);
+        }
+        else
+        {
+            for (unsigned i = 0; i < batch; ++i)
+            {
+                batchProxies.push_back(tree.insert(batchBvs[i], data[i]));
+            }
+        }
+
+        double load = loadTimer.getElapsed();
+        int height = tree.getHeight();
+        Timer queryTimer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < queries; ++i)
+        {
+            SVertex center(queryCenters[i].x * 2, queryCenters[i].y, queryCenters[i].z);
+            tree.query(createBox(center, 1), [&found](unsigned) { ++found; return true; });
+        }
+
+        double query = queryTimer.getElapsed();
+        Timer unloadTimer;
+        if (many)
+        {
+            tree.removeMany(batchProxies);
+        }
+        else
+        {
+            for (unsigned i = 0; i < batch; ++i)
+            {
+                tree.remove(batchProxies[i]);
+            }
+        }
+
+        std::printf("%-17s found: %8u load: %8.2f ms, unload: %8.2f ms, queries: %8.2f ms, height: %d\n",
+            many ? "insertMany" : "insert one by one", found, load, unloadTimer.getElapsed(), query, height);
+    }
+
+    return 0;
+}
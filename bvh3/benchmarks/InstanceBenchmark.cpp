@@ -0,0 +1,153 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Places a few meshes many times and compares building a tree per placement
+ * against InstanceTree sharing trees of meshes.
+ * Meshes are vertices of a grid, placements are rotated by multiples of 90 degrees
+ * and moved by integers, so both ways find the same pairs of equal vertices
+ * with the query containing some vertices of every placement.
+ * InstanceTree goes first, freeing many small nodes slows down following allocations.
+ *
+ * Usage: InstanceBenchmark [number of meshes] [vertices per mesh] [number of instances]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/scene/InstanceTree.hpp>
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef Node<TKDop16> TNode;
+
+/**
+ * Returns distinct vertices of a 16x16x16 grid in random order.
+ */
+TVertices createMesh(unsigned count, unsigned seed)
+{
+    TVertices result;
+    for (unsigned i = 0; i < 16 * 16 * 16; ++i)
+    {
+        result.push_back(SVertex(i % 16, i / 16 % 16, i / 256));
+    }
+
+    std::shuffle(result.begin(), result.end(), std::mt19937(seed));
+    result.resize(std::min(count, unsigned(result.size())));
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned meshCount = getArgument(argc, argv, 1, 10);
+    unsigned vertexCount = getArgument(argc, argv, 2, 2000);
+    unsigned instanceCount = getArgument(argc, argv, 3, 2000);
+
+    std::vector<TVertices> meshes;
+    for (unsigned i = 0; i < meshCount; ++i)
+    {
+        meshes.push_back(createMesh(vertexCount, i + 1));
+    }
+
+    unsigned size = std::cbrt(instanceCount) * 32;
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<unsigned> position(0, size);
+    std::vector<STransform> transforms;
+    TVertices queryVertices;
+    for (unsigned i = 0; i < instanceCount; ++i)
+    {
+        // Rotation around z by i quarters.
+        float cs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+        STransform transform(SVertex(position(generator), position(generator), position(generator)));
+        transform.rotation[0] = transform.rotation[4] = cs[i % 4][0];
+        transform.rotation[1] = -cs[i % 4][1];
+        transform.rotation[3] = cs[i % 4][1];
+        transforms.push_back(transform);
+
+        const TVertices& mesh = meshes[i % meshCount];
+        for (unsigned j = 0; j < mesh.size(); j += 100)
+        {
+            queryVertices.push_back(transform(mesh[j]));
+        }
+    }
+
+    std::sort(queryVertices.begin(), queryVertices.end(), [](const SVertex& a, const SVertex& b) {
+        return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+    });
+
+    queryVertices.erase(std::unique(queryVertices.begin(), queryVertices.end()), queryVertices.end());
+    TNode* query = buildTree<TKDop16>(queryVertices);
+    std::printf("Meshes: %u vertices per mesh: %u instances: %u query vertices: %u\n",
+        meshCount, vertexCount, instanceCount, unsigned(queryVertices.size()));
+
+    {
+        Timer timer;
+        std::vector<TNode*> roots;
+        InstanceTree<TKDop16> instances;
+        for (unsigned i = 0; i < meshCount; ++i)
+        {
+            roots.push_back(buildTree<TKDop16>(meshes[i]));
+            instances.addMesh(roots[i]);
+        }
+
+        for (unsigned i = 0; i < instanceCount; ++i)
+        {
+            instances.addInstance(i % meshCount, transforms[i]);
+        }
+
+        instances.build();
+        double build = timer.getElapsed();
+        double memory = meshCount * double(vertexCount) * (2 * sizeof(TNode) + sizeof(SVertex))
+            + instanceCount * (2 * sizeof(SFlatNode<TKDop16>) + sizeof(TKDop16) + 2 * sizeof(STransform) + 2 * sizeof(unsigned));
+
+        Timer queryTimer;
+        InstanceTree<TKDop16>::TCollisions output;
+        instances.collided(query, output);
+        std::printf("instance tree     build: %8.2f ms memory: %8.2f MB query: %8.2f ms found: %u\n",
+            build, memory / (1 << 20), queryTimer.getElapsed(), unsigned(output.size()));
+
+        for (unsigned i = 0; i < roots.size(); ++i)
+        {
+            delete roots[i];
+        }
+    }
+
+    {
+        Timer timer;
+        std::vector<TNode*> roots;
+        for (unsigned i = 0; i < instanceCount; ++i)
+        {
+            TVertices placed(meshes[i % meshCount]);
+            for (unsigned j = 0; j < placed.size(); ++j)
+            {
+                placed[j] = transforms[i](placed[j]);
+            }
+
+            roots.push_back(buildTree<TKDop16>(placed));
+        }
+
+        double build = timer.getElapsed();
+        double memory = instanceCount * double(vertexCount) * (2 * sizeof(TNode) + sizeof(SVertex));
+
+        Timer queryTimer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < instanceCount; ++i)
+        {
+            roots[i]->visit(query, [&found](unsigned index, unsigned queryIndex) { ++found; return true; });
+        }
+
+        std::printf("tree per instance build: %8.2f ms memory: %8.2f MB query: %8.2f ms found: %u\n",
+            build, memory / (1 << 20), queryTimer.getElapsed(), found);
+
+        for (unsigned i = 0; i < roots.size(); ++i)
+        {
+            delete roots[i];
+        }
+    }
+
+    delete query;
+    return 0;
+}
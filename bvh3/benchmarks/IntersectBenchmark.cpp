@@ -0,0 +1,93 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Measures latency of any-hit intersects() against collided() on two heavily
+ * overlapping trees built on uniform vertices inside the same cube.
+ * Query vertices share every 100th vertex with tree vertices for hits
+ * and are all shifted for misses, when the whole front is traversed anyway.
+ *
+ * Usage: IntersectBenchmark [number of vertices] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/FlatTree.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+
+/**
+ * Runs the query and prints average time in microseconds.
+ */
+template<class TQuery>
+void measure(const char* name, unsigned repeats, TQuery query)
+{
+    Timer timer;
+    bool found = false;
+    for (unsigned i = 0; i < repeats; ++i)
+    {
+        found = query();
+    }
+
+    std::printf("%-20s found: %d time: %10.2f us\n", name, found, timer.getElapsed() * 1000 / repeats);
+}
+
+/**
+ * Compares queries of both tree types.
+ */
+void compare(const TVertices& vertices, const TVertices& queryVertices, unsigned repeats)
+{
+    auto root1 = buildTree<TKDop16>(vertices);
+    auto root2 = buildTree<TKDop16>(queryVertices);
+    FlatTree<TKDop16> tree1;
+    FlatTree<TKDop16> tree2;
+    buildTree<TKDop16>(vertices, tree1);
+    buildTree<TKDop16>(queryVertices, tree2);
+
+    measure("Node::collided", repeats, [&]() {
+        Node<TKDop16>::TCollidedNodes output;
+        return root1->collided(root2, output);
+    });
+
+    measure("Node::intersects", repeats, [&]() { return root1->intersects(root2); });
+
+    measure("FlatTree::collided", repeats, [&]() {
+        FlatTree<TKDop16>::TCollidedNodes output;
+        return tree1.collided(tree2, output);
+    });
+
+    measure("FlatTree::intersects", repeats, [&]() { return tree1.intersects(tree2); });
+
+    delete root1;
+    delete root2;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 200000);
+    unsigned repeats = getArgument(argc, argv, 2, 5);
+
+    TVertices vertices = generateVertices(count, 100);
+    TVertices queryVertices = generateVertices(count, 100, 2);
+    for (unsigned i = 0; i < count; i += 100)
+    {
+        queryVertices[i] = vertices[i];
+    }
+
+    std::printf("Hit, vertices per tree: %u\n", count);
+    compare(vertices, queryVertices, repeats);
+
+    for (unsigned i = 0; i < count; i += 100)
+    {
+        queryVertices[i].x += 0.001f;
+    }
+
+    std::printf("Miss, vertices per tree: %u\n", count);
+    compare(vertices, queryVertices, repeats);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Sweeps maximal number of vertices in a leaf and compares
+ * build time, number of nodes, memory of nodes, depth and collision query time.
+ * Query vertices share a half with tree vertices.
+ *
+ * Usage: LeafSizeBenchmark [number of vertices] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TTree;
+
+void run(unsigned maxLeafSize, const TVertices& vertices, const TVertices& query, unsigned repeats)
+{
+    TTree tree;
+    TTree queryTree;
+    Timer buildTimer;
+    buildTree<TKDop16>(vertices, tree, maxLeafSize);
+    double build = buildTimer.getElapsed();
+    buildTree<TKDop16>(query, queryTree, maxLeafSize);
+
+    Timer queryTimer;
+    unsigned found = 0;
+    for (unsigned i = 0; i < repeats; ++i)
+    {
+        TTree::TCollidedNodes output;
+        tree.collided(queryTree, output);
+        found = output.size();
+    }
+
+    std::printf(
+        "leaf: %2u build: %8.1f ms nodes: %8u memory: %7.1f MB depth: %4u collided: %8.2f ms (%u)\n",
+        maxLeafSize,
+        build,
+        unsigned(tree.getNodes().size()),
+        tree.getNodes().size() * sizeof(SFlatNode<TKDop16>) / 1048576.0,
+        getDepth(tree),
+        queryTimer.getElapsed() / repeats,
+        found
+        );
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 500000);
+    unsigned repeats = getArgument(argc, argv, 2, 3);
+
+    TVertices vertices = generateVertices(count, 1000, 1);
+    TVertices query = generateVertices(count, 1000, 2);
+    std::copy(vertices.begin(), vertices.begin() + count / 2, query.begin());
+
+    for (unsigned maxLeafSize = 1; maxLeafSize <= 32; maxLeafSize *= 2)
+    {
+        run(maxLeafSize, vertices, query, repeats);
+    }
+
+    return 0;
+}
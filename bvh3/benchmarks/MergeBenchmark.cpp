@@ -0,0 +1,88 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Compares creating KDop vertex by vertex against batch merge
+ * of arrays of vertices and of separate coordinate arrays.
+ *
+ * Usage: MergeBenchmark [number of vertices] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+#include <vector>
+
+using namespace NBvh3;
+
+template<unsigned K>
+void run(const TVertices& vertices, unsigned repeats)
+{
+    unsigned count = vertices.size();
+    std::vector<float> x(count);
+    std::vector<float> y(count);
+    std::vector<float> z(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        x[i] = vertices[i].x;
+        y[i] = vertices[i].y;
+        z[i] = vertices[i].z;
+    }
+
+    float checksum = 0;
+    Timer timer1;
+    for (unsigned r = 0; r < repeats; ++r)
+    {
+        KDop<K> bv;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            bv += vertices[i];
+        }
+
+        checksum += bv.getMax(K / 2 - 1);
+    }
+
+    double vertexByVertex = timer1.getElapsed() / repeats;
+
+    Timer timer2;
+    for (unsigned r = 0; r < repeats; ++r)
+    {
+        KDop<K> bv;
+        bv.merge(vertices.data(), count);
+        checksum += bv.getMax(K / 2 - 1);
+    }
+
+    double batch = timer2.getElapsed() / repeats;
+
+    Timer timer3;
+    for (unsigned r = 0; r < repeats; ++r)
+    {
+        KDop<K> bv;
+        bv.merge(x.data(), y.data(), z.data(), count);
+        checksum += bv.getMax(K / 2 - 1);
+    }
+
+    double coordinates = timer3.getElapsed() / repeats;
+
+    std::printf(
+        "KDop<%u> operator+=: %.2f ms merge(vertices): %.2f ms merge(x, y, z): %.2f ms (%g)\n",
+        K,
+        vertexByVertex,
+        batch,
+        coordinates,
+        checksum
+        );
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 5000000);
+    unsigned repeats = getArgument(argc, argv, 2, 5);
+    TVertices vertices = generateVertices(count, 1000);
+
+    run<16>(vertices, repeats);
+    run<18>(vertices, repeats);
+    run<24>(vertices, repeats);
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Measures KDop::overlapped on dense random KDops.
+ * Built twice: with SIMD kernels and with BVH3_NO_SIMD.
+ *
+ * Usage: OverlapBenchmark [number of KDops] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+#include <vector>
+
+using namespace NBvh3;
+
+template<unsigned K>
+void run(unsigned count, unsigned repeats)
+{
+    TVertices vertices = generateVertices(count * 2, 100);
+    std::vector<KDop<K> > bvs(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        bvs[i] += vertices[2 * i];
+        bvs[i] += vertices[2 * i + 1];
+    }
+
+    Timer timer;
+    unsigned overlapped = 0;
+    for (unsigned r = 0; r < repeats; ++r)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            for (unsigned j = i + 1; j < count; j += 7)
+            {
+                overlapped += bvs[i].overlapped(bvs[j]);
+            }
+        }
+    }
+
+    double elapsed = timer.getElapsed();
+    double tests = double(repeats) * count * count / 14;
+    std::printf("KDop<%u> overlapped: %u time: %.1f ms, %.2f ns per test\n", K, overlapped, elapsed, elapsed * 1e6 / tests);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 4000);
+    unsigned repeats = getArgument(argc, argv, 2, 3);
+
+#ifdef BVH3_AVX
+    std::printf("Kernels: AVX\n");
+#elif defined(BVH3_SSE)
+    std::printf("Kernels: SSE\n");
+#else
+    std::printf("Kernels: scalar\n");
+#endif
+
+    run<16>(count, repeats);
+    run<18>(count, repeats);
+    run<24>(count, repeats);
+
+    return 0;
+}
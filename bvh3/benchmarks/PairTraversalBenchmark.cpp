@@ -0,0 +1,149 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Compares recursive traversals of two flat trees against iterative traversePairs()
+ * by time per tested pair of nodes.
+ * Query vertices share a half with tree vertices.
+ *
+ * Usage: PairTraversalBenchmark [number of vertices] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/traversal/PairTraversal.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TTree;
+
+/**
+ * Counts tested pairs and found leaves.
+ */
+struct SCounter
+{
+    bool operator () (unsigned node, unsigned queryNode)
+    {
+        ++found;
+        return true;
+    }
+
+    unsigned tested;
+    unsigned found;
+};
+
+/**
+ * Recursive traversal descending the tree first, as FlatTree::collided() did before.
+ */
+void traverseTreeFirst(const TTree& tree, unsigned node, const TTree& query, unsigned queryNode, SCounter& counter)
+{
+    ++counter.tested;
+    if (!tree.getBoundingVolume(node).overlapped(query.getBoundingVolume(queryNode)))
+    {
+        return;
+    }
+
+    if (!tree.isLeaf(node))
+    {
+        traverseTreeFirst(tree, tree.getLeft(node), query, queryNode, counter);
+        traverseTreeFirst(tree, tree.getRight(node), query, queryNode, counter);
+    }
+    else if (!query.isLeaf(queryNode))
+    {
+        traverseTreeFirst(tree, node, query, query.getLeft(queryNode), counter);
+        traverseTreeFirst(tree, node, query, query.getRight(queryNode), counter);
+    }
+    else
+    {
+        counter(node, queryNode);
+    }
+}
+
+/**
+ * Recursive traversal with the same descent rule as traversePairs().
+ */
+void traverseBySize(const TTree& tree, unsigned node, const TTree& query, unsigned queryNode, SCounter& counter)
+{
+    ++counter.tested;
+    if (!tree.getBoundingVolume(node).overlapped(query.getBoundingVolume(queryNode)))
+    {
+        return;
+    }
+
+    bool leaf = tree.isLeaf(node);
+    bool queryLeaf = query.isLeaf(queryNode);
+    if (leaf && queryLeaf)
+    {
+        counter(node, queryNode);
+    }
+    else if (queryLeaf
+        || (!leaf && getSize(tree.getBoundingVolume(node)) >= getSize(query.getBoundingVolume(queryNode))))
+    {
+        traverseBySize(tree, tree.getLeft(node), query, queryNode, counter);
+        traverseBySize(tree, tree.getRight(node), query, queryNode, counter);
+    }
+    else
+    {
+        traverseBySize(tree, node, query, query.getLeft(queryNode), counter);
+        traverseBySize(tree, node, query, query.getRight(queryNode), counter);
+    }
+}
+
+template<class TTraversal>
+void run(const char* name, const TTree& tree, const TTree& query, unsigned repeats, unsigned tested, TTraversal traversal)
+{
+    SCounter counter = {0, 0};
+    Timer timer;
+    for (unsigned i = 0; i < repeats; ++i)
+    {
+        counter.tested = 0;
+        counter.found = 0;
+        traversal(counter);
+    }
+
+    double elapsed = timer.getElapsed() / repeats;
+    tested = counter.tested != 0 ? counter.tested : tested;
+    std::printf(
+        "%-12s %8.2f ms tested: %9u %6.2f ns/pair found: %u\n",
+        name,
+        elapsed,
+        tested,
+        elapsed * 1000000 / tested,
+        counter.found
+        );
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 500000);
+    unsigned repeats = getArgument(argc, argv, 2, 3);
+
+    TVertices vertices = generateVertices(count, 1000, 1);
+    TVertices queryVertices = generateVertices(count, 1000, 2);
+    std::copy(vertices.begin(), vertices.begin() + count / 2, queryVertices.begin());
+
+    TTree tree;
+    TTree query;
+    buildTree<TKDop16>(vertices, tree);
+    buildTree<TKDop16>(queryVertices, query);
+
+    run("tree first", tree, query, repeats, 0, [&](SCounter& counter) {
+        traverseTreeFirst(tree, 0, query, 0, counter);
+    });
+
+    SCounter bySize = {0, 0};
+    traverseBySize(tree, 0, query, 0, bySize);
+    run("by size", tree, query, repeats, 0, [&](SCounter& counter) {
+        traverseBySize(tree, 0, query, 0, counter);
+    });
+
+    // Iterative traversal tests the same pairs as the recursive one by size.
+    run("iterative", tree, query, repeats, bySize.tested, [&](SCounter& counter) {
+        traversePairs(tree, query, counter);
+    });
+
+    return 0;
+}
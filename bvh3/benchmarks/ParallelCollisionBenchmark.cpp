@@ -0,0 +1,76 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Compares serial FlatTree::collided() against the parallel one on pools
+ * of 1, 2, 4 and up to the given number of threads.
+ * Trees are built on uniform vertices inside the same cube and share a half of vertices.
+ *
+ * Usage: ParallelCollisionBenchmark [number of vertices] [threads] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TTree;
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 1000000);
+    unsigned threads = getArgument(argc, argv, 2, std::max(1u, std::thread::hardware_concurrency()));
+    unsigned repeats = getArgument(argc, argv, 3, 3);
+
+    TVertices vertices = generateVertices(count, 100);
+    TVertices queryVertices = generateVertices(count, 100, 2);
+    for (unsigned i = 0; i < count; i += 2)
+    {
+        queryVertices[i] = vertices[i];
+    }
+
+    TTree tree;
+    TTree query;
+    buildTree<TKDop16>(vertices, tree);
+    buildTree<TKDop16>(queryVertices, query);
+    std::printf("Vertices per tree: %u nodes per tree: %u\n", count, unsigned(tree.getNodes().size()));
+
+    double serial = 0;
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            TTree::TCollidedNodes output;
+            tree.collided(query, output);
+            found = output.size();
+        }
+
+        serial = timer.getElapsed() / repeats;
+        std::printf("serial      pairs: %u time: %8.2f ms\n", found, serial);
+    }
+
+    for (unsigned size = 1; size < threads * 2; size *= 2)
+    {
+        size = std::min(size, threads);
+        TaskPool pool(size);
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            TTree::TCollidedNodes output;
+            tree.collided(query, output, pool);
+            found = output.size();
+        }
+
+        double elapsed = timer.getElapsed() / repeats;
+        std::printf("threads %-3u pairs: %u time: %8.2f ms speedup: %.2f\n", size, found, elapsed, serial / elapsed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Compares updating a tree of deforming vertices by rebuild and by refit,
+ * followed by a collision query against a static tree, per frame.
+ *
+ * Usage: RefitBenchmark [number of vertices] [frames] [amplitude] [threads]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include "Benchmark.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TTree;
+
+/**
+ * Moves every vertex by a wave depending on its position and the frame.
+ */
+void deform(const TVertices& vertices, unsigned frame, float amplitude, TVertices& result)
+{
+    float time = frame * 0.1f;
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        const SVertex& vertex = vertices[i];
+        result[i] = SVertex(
+            vertex.x + amplitude * std::sin(vertex.y * 0.01f + time),
+            vertex.y + amplitude * std::sin(vertex.z * 0.01f + time),
+            vertex.z + amplitude * std::sin(vertex.x * 0.01f + time)
+            );
+    }
+}
+
+template<class TUpdater>
+void run(
+    const char* name,
+    const TVertices& vertices,
+    const TTree& query,
+    unsigned frames,
+    float amplitude,
+    TUpdater updater
+    )
+{
+    TTree tree;
+    buildTree<TKDop16>(vertices, tree);
+    TVertices deformed(vertices.size());
+    double update = 0;
+    double collided = 0;
+    unsigned found = 0;
+    for (unsigned frame = 1; frame <= frames; ++frame)
+    {
+        deform(vertices, frame, amplitude, deformed);
+
+        Timer updateTimer;
+        updater(deformed, tree);
+        update += updateTimer.getElapsed();
+
+        Timer queryTimer;
+        TTree::TCollidedNodes output;
+        tree.collided(query, output);
+        collided += queryTimer.getElapsed();
+        found += output.size();
+    }
+
+    std::printf(
+        "%-10s update: %8.2f ms collided: %8.2f ms total: %8.2f ms cost: %8.1f (%u)\n",
+        name,
+        update / frames,
+        collided / frames,
+        (update + collided) / frames,
+        getSurfaceAreaCost(tree),
+        found
+        );
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 200000);
+    unsigned frames = getArgument(argc, argv, 2, 10);
+    float amplitude = getArgument(argc, argv, 3, 20);
+    unsigned threads = getArgument(argc, argv, 4, 0);
+
+    TVertices vertices = generateVertices(count, 1000, 1);
+    TTree query;
+    buildTree<TKDop16>(generateVertices(count, 1000, 2), query);
+    TaskPool pool(threads);
+
+    run(
+        "rebuild",
+        vertices,
+        query,
+        frames,
+        amplitude,
+        [](const TVertices& vertices, TTree& tree) { buildTree<TKDop16>(vertices, tree); }
+        );
+    run(
+        "refit",
+        vertices,
+        query,
+        frames,
+        amplitude,
+        [](const TVertices& vertices, TTree& tree) { tree.refit(vertices); }
+        );
+    run(
+        "parallel",
+        vertices,
+        query,
+        frames,
+        amplitude,
+        [&pool](const TVertices& vertices, TTree& tree) { tree.refit(vertices, pool); }
+        );
+
+    return 0;
+}
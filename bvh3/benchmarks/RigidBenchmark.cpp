@@ -0,0 +1,81 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Moves a rigid object through a static scene and compares rebuilding its tree
+ * from transformed vertices every frame against querying the tree built once
+ * with the transform by Node::collidedLeaves().
+ *
+ * Usage: RigidBenchmark [number of scene vertices] [number of object vertices] [frames]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/Node.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef Node<TKDop16> TNode;
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 500000);
+    unsigned objectCount = getArgument(argc, argv, 2, 100000);
+    unsigned frames = getArgument(argc, argv, 3, 10);
+
+    TVertices vertices = generateVertices(count, 100);
+    TVertices object = generateVertices(objectCount, 20, 2);
+    TNode* scene = buildTree<TKDop16>(vertices);
+    TNode* root = buildTree<TKDop16>(object);
+
+    std::vector<STransform> transforms;
+    for (unsigned i = 0; i < frames; ++i)
+    {
+        transforms.push_back(STransform(SVertex(0.6f, 0.8f, 0), i * 0.1f, SVertex(i * 5.0f, 40, 40)));
+    }
+
+    {
+        Timer timer;
+        double rebuild = 0;
+        unsigned found = 0;
+        for (unsigned i = 0; i < frames; ++i)
+        {
+            Timer rebuildTimer;
+            TVertices placed(object);
+            for (unsigned j = 0; j < placed.size(); ++j)
+            {
+                placed[j] = transforms[i](placed[j]);
+            }
+
+            TNode* moved = buildTree<TKDop16>(placed);
+            rebuild += rebuildTimer.getElapsed();
+
+            TNode::TCollidedNodes output;
+            scene->collidedLeaves(moved, STransform(), output);
+            found += output.size();
+            delete moved;
+        }
+
+        std::printf("rebuild+collided    pairs: %6u time: %8.2f ms per frame, rebuild: %8.2f ms\n",
+            found, timer.getElapsed() / frames, rebuild / frames);
+    }
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < frames; ++i)
+        {
+            TNode::TCollidedNodes output;
+            scene->collidedLeaves(root, transforms[i], output);
+            found += output.size();
+        }
+
+        std::printf("collided+transform  pairs: %6u time: %8.2f ms per frame\n", found, timer.getElapsed() / frames);
+    }
+
+    delete scene;
+    delete root;
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Moves objects with own trees inside a cube and finds collided ones every frame
+ * by Scene against calling Node::collidedLeaves() for all pairs of objects.
+ * Every object is a cloud of 32 vertices, trees of moved objects are rebuilt.
+ *
+ * Usage: SceneBenchmark [number of objects] [frames]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/scene/Scene.hpp>
+#include "Benchmark.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef Node<TKDop16> TNode;
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 10000);
+    unsigned frames = getArgument(argc, argv, 2, 10);
+
+    // Objects of size 2 take about 5% of the cube.
+    float size = std::cbrt(count * 8 / 0.05f);
+    TVertices shape = generateVertices(32, 2);
+    TVertices positions = generateVertices(count, size);
+    TVertices velocities = generateVertices(count, 0.2f, 2);
+    std::vector<TNode*> roots(count);
+    Scene<TKDop16> scene;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        TVertices vertices(shape);
+        for (unsigned j = 0; j < vertices.size(); ++j)
+        {
+            vertices[j] = SVertex(vertices[j].x + positions[i].x, vertices[j].y + positions[i].y, vertices[j].z + positions[i].z);
+        }
+
+        roots[i] = buildTree<TKDop16>(vertices);
+        scene.add(roots[i]);
+    }
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            for (unsigned j = i + 1; j < count; ++j)
+            {
+                TNode::TCollidedNodes output;
+                found += roots[i]->collidedLeaves(roots[j], output);
+            }
+        }
+
+        std::printf("all pairs   collided: %6u time: %8.2f ms\n", found, timer.getElapsed());
+    }
+
+    double rebuild = 0;
+    double broad = 0;
+    double total = 0;
+    unsigned candidates = 0;
+    unsigned found = 0;
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        {
+            Timer timer;
+            for (unsigned i = 0; i < count; ++i)
+            {
+                positions[i] = SVertex(
+                    positions[i].x + velocities[i].x - 0.1f,
+                    positions[i].y + velocities[i].y - 0.1f,
+                    positions[i].z + velocities[i].z - 0.1f
+                    );
+
+                TVertices vertices(shape);
+                for (unsigned j = 0; j < vertices.size(); ++j)
+                {
+                    vertices[j] = SVertex(vertices[j].x + positions[i].x, vertices[j].y + positions[i].y, vertices[j].z + positions[i].z);
+                }
+
+                delete roots[i];
+                roots[i] = buildTree<TKDop16>(vertices);
+                scene.update(i, roots[i]);
+            }
+
+            rebuild += timer.getElapsed();
+        }
+
+        {
+            Timer timer;
+            Scene<TKDop16>::TObjectPairs pairs;
+            scene.findPairs(pairs);
+            broad += timer.getElapsed();
+            candidates = pairs.size();
+        }
+
+        {
+            Timer timer;
+            Scene<TKDop16>::TCollisions output;
+            scene.collided(output);
+            total += timer.getElapsed();
+            found = output.size();
+        }
+    }
+
+    std::printf("rebuild                     time: %8.2f ms per frame\n", rebuild / frames);
+    std::printf("findPairs   pairs:    %6u time: %8.2f ms per frame\n", candidates, broad / frames);
+    std::printf("collided    collided: %6u time: %8.2f ms per frame\n", found, total / frames);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        delete roots[i];
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Compares splitters by build time, depth and cost of trees
+ * and by time of collision queries on uniform, clustered and rotated clustered vertices.
+ *
+ * Usage: SplitterBenchmark [number of vertices] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <bvh3/splitters/SplitterByCenter.hpp>
+#include <bvh3/splitters/SplitterByDirection.hpp>
+#include <bvh3/splitters/SplitterByMedian.hpp>
+#include <bvh3/splitters/SplitterBySah.hpp>
+#include "Benchmark.hpp"
+#include <bvh3/types/STransform.hpp>
+#include <cmath>
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+
+template<class TSplitter>
+void run(const char* name, const TVertices& vertices, const TVertices& query, unsigned repeats)
+{
+    FlatTree<TKDop16> tree;
+    FlatTree<TKDop16> queryTree;
+    Timer buildTimer;
+    buildTree<TKDop16, TSplitter>(vertices, tree);
+    double build = buildTimer.getElapsed();
+    buildTree<TKDop16, TSplitter>(query, queryTree);
+
+    Timer queryTimer;
+    unsigned found = 0;
+    for (unsigned i = 0; i < repeats; ++i)
+    {
+        FlatTree<TKDop16>::TCollidedNodes output;
+        tree.collided(queryTree, output);
+        found = output.size();
+    }
+
+    std::printf(
+        "  %-10s build: %8.1f ms depth: %4u cost: %8.1f collided: %8.2f ms (%u)\n",
+        name,
+        build,
+        getDepth(tree),
+        getSurfaceAreaCost(tree),
+        queryTimer.getElapsed() / repeats,
+        found
+        );
+}
+
+void run(const char* name, const TVertices& vertices, const TVertices& query, unsigned repeats)
+{
+    std::printf("%s\n", name);
+    run<SplitterByCenter<TKDop16> >("center", vertices, query, repeats);
+    run<SplitterByMedian<TKDop16> >("median", vertices, query, repeats);
+    run<SplitterBySah<TKDop16> >("sah", vertices, query, repeats);
+    run<SplitterByDirection<TKDop16> >("direction", vertices, query, repeats);
+}
+
+/**
+ * Tilts flat clusters by 45 degrees around x, so they are thin along (0, 1, -1).
+ */
+TVertices rotate(TVertices vertices)
+{
+    float angle = std::atan(1.0f);
+    STransform transform(SVertex(1, 0, 0), angle, SVertex(0, 0, 0));
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i] = transform(vertices[i]);
+    }
+
+    return vertices;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 200000);
+    unsigned repeats = getArgument(argc, argv, 2, 3);
+
+    run("uniform", generateVertices(count, 1000, 1), generateVertices(count, 1000, 2), repeats);
+    run("clustered", generateClusters(count, 50, 1000, 1), generateClusters(count, 50, 1000, 2), repeats);
+    run("rotated", rotate(generateClusters(count, 50, 1000, 1)), rotate(generateClusters(count, 50, 1000, 2)), repeats);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Measures collision traversal of trees built on the triangles from NodeTest
+ * repeated over a 3D grid of cells.
+ * Built twice: with inlined KDop kernels and with BVH3_KDOP_OUT_OF_LINE
+ * to call them from the KDop library.
+ * Also compares querying the tree against itself with selfCollided().
+ *
+ * Usage: TraversalBenchmark [cells per axis] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/FlatTree.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+
+/**
+ * Repeats the triangle in every cell of the grid.
+ */
+TVertices createScene(const TVertices& triangle, unsigned cells)
+{
+    TVertices result;
+    result.reserve(cells * cells * cells * triangle.size());
+    for (unsigned x = 0; x < cells; ++x)
+    {
+        for (unsigned y = 0; y < cells; ++y)
+        {
+            for (unsigned z = 0; z < cells; ++z)
+            {
+                for (unsigned i = 0; i < triangle.size(); ++i)
+                {
+                    const SVertex& v = triangle[i];
+                    result.push_back(SVertex(v.x + x * 8, v.y + y * 8, v.z + z * 8));
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned cells = getArgument(argc, argv, 1, 50);
+    unsigned repeats = getArgument(argc, argv, 2, 5);
+
+    TVertices triangle1 =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    TVertices triangle2 =
+    {
+        {3, 1, 0},
+        {4, 2, 0},
+        {6, 1, 0}
+    };
+
+    TVertices vertices1 = createScene(triangle1, cells);
+    TVertices vertices2 = createScene(triangle2, cells);
+    auto root1 = buildTree<TKDop16>(vertices1);
+    auto root2 = buildTree<TKDop16>(vertices2);
+    FlatTree<TKDop16> tree1;
+    FlatTree<TKDop16> tree2;
+    buildTree<TKDop16>(vertices1, tree1);
+    buildTree<TKDop16>(vertices2, tree2);
+
+#ifdef BVH3_KDOP_OUT_OF_LINE
+    const char* kernels = "out-of-line";
+#else
+    const char* kernels = "inline";
+#endif
+
+    std::printf("KDop kernels: %s, nodes per tree: %u\n", kernels, unsigned(tree1.getNodes().size()));
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            Node<TKDop16>::TCollidedNodes output;
+            root1->collided(root2, output);
+            found = output.size();
+        }
+
+        std::printf("Node::collided     pairs: %u time: %.2f ms\n", found, timer.getElapsed() / repeats);
+    }
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            FlatTree<TKDop16>::TCollidedNodes output;
+            tree1.collided(tree2, output);
+            found = output.size();
+        }
+
+        std::printf("FlatTree::collided pairs: %u time: %.2f ms\n", found, timer.getElapsed() / repeats);
+    }
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            found = 0;
+            root1->visit(root2, [&found](unsigned index, unsigned queryIndex) { ++found; return true; });
+        }
+
+        std::printf("Node::visit        equal: %u time: %.2f ms\n", found, timer.getElapsed() / repeats);
+    }
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            found = 0;
+            tree1.visit(tree2, [&found](unsigned index, unsigned queryIndex) { ++found; return true; });
+        }
+
+        std::printf("FlatTree::visit    equal: %u time: %.2f ms\n", found, timer.getElapsed() / repeats);
+    }
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            Node<TKDop16>::TCollidedNodes output;
+            root1->collided(root1, output);
+            found = output.size();
+        }
+
+        std::printf("Node::collided self pairs: %u time: %.2f ms\n", found, timer.getElapsed() / repeats);
+    }
+
+    {
+        Timer timer;
+        unsigned found = 0;
+        for (unsigned i = 0; i < repeats; ++i)
+        {
+            Node<TKDop16>::TCollidedNodes output;
+            root1->selfCollided(output);
+            found = output.size();
+        }
+
+        std::printf("Node::selfCollided pairs: %u time: %.2f ms\n", found, timer.getElapsed() / repeats);
+    }
+
+    delete root1;
+    delete root2;
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ *
+ * Optimizes trees built by different splitters by restructuring treelets serially and in parallel
+ * and compares surface area cost, depth, number of tested pairs of nodes and time of queries
+ * of small objects placed over the scene before and after.
+ *
+ * Usage: TreeletBenchmark [number of vertices] [threads] [objects] [repeats]
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/Statistics.hpp>
+#include <bvh3/builders/TreeletOptimizer.hpp>
+#include <bvh3/splitters/SplitterByCenter.hpp>
+#include <bvh3/splitters/SplitterByMedian.hpp>
+#include <bvh3/splitters/SplitterBySah.hpp>
+#include "Benchmark.hpp"
+#include <cstdio>
+#include <random>
+
+using namespace NBvh3;
+
+typedef KDop<16> TKDop16;
+typedef Node<TKDop16> TNode;
+
+/**
+ * Returns average time of visiting pairs of equal vertices of the tree and all queries.
+ */
+double query(const TNode* root, const std::vector<TNode*>& queries, unsigned repeats, unsigned& found)
+{
+    Timer timer;
+    for (unsigned i = 0; i < repeats; ++i)
+    {
+        found = 0;
+        for (unsigned j = 0; j < queries.size(); ++j)
+        {
+            root->visit(queries[j], [&found](unsigned index, unsigned queryIndex) {
+                ++found;
+                return true;
+            });
+        }
+    }
+
+    return timer.getElapsed() / repeats;
+}
+
+/**
+ * Returns number of overlapped pairs of nodes tested by Node::visit().
+ */
+unsigned countPairs(const TNode* node, const TNode* query)
+{
+    if (!node->overlapped(query))
+    {
+        return 0;
+    }
+
+    if (node->isLeaf() && query->isLeaf())
+    {
+        return 1;
+    }
+
+    bool descend = query->isLeaf()
+        || (!node->isLeaf() && getSize(node->getBoundingVolume()) >= getSize(query->getBoundingVolume()));
+
+    return descend
+        ? 1 + countPairs(node->getLeft(), query) + countPairs(node->getRight(), query)
+        : 1 + countPairs(node, query->getLeft()) + countPairs(node, query->getRight());
+}
+
+/**
+ * Returns number of overlapped pairs of nodes of the tree and all queries.
+ */
+unsigned countPairs(const TNode* root, const std::vector<TNode*>& queries)
+{
+    unsigned result = 0;
+    for (unsigned i = 0; i < queries.size(); ++i)
+    {
+        result += countPairs(root, queries[i]);
+    }
+
+    return result;
+}
+
+template<class TSplitter>
+void run(const char* name, const TVertices& vertices, const std::vector<TNode*>& queries, TaskPool& pool, unsigned repeats)
+{
+    TNode* root = buildTree<TKDop16, TSplitter>(vertices);
+    TNode* parallelRoot = buildTree<TKDop16, TSplitter>(vertices);
+    float cost = getSurfaceAreaCost(root);
+    unsigned depth = getDepth(root);
+    unsigned found = 0;
+    double before = query(root, queries, repeats, found);
+    unsigned pairs = countPairs(root, queries);
+
+    Timer timer;
+    unsigned restructured = optimizeTree(root);
+    double optimize = timer.getElapsed();
+
+    Timer parallelTimer;
+    optimizeTree(parallelRoot, pool);
+    double parallel = parallelTimer.getElapsed();
+
+    double after = query(root, queries, repeats, found);
+
+    std::printf(
+        "  %-6s optimize: %7.1f ms parallel: %7.1f ms treelets: %6u cost: %5.1f -> %5.1f depth: %2u -> %2u "
+        "pairs: %7u -> %7u query: %6.2f -> %6.2f ms (%u)\n",
+        name,
+        optimize,
+        parallel,
+        restructured,
+        cost,
+        getSurfaceAreaCost(root),
+        depth,
+        getDepth(root),
+        pairs,
+        countPairs(root, queries),
+        before,
+        after,
+        found
+        );
+
+    delete root;
+    delete parallelRoot;
+}
+
+void run(const char* name, const TVertices& vertices, unsigned objects, TaskPool& pool, unsigned repeats)
+{
+    std::printf("%s\n", name);
+
+    // Small objects are placed at random vertices of the scene.
+    std::vector<TNode*> queries;
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<unsigned> position(0, vertices.size() - 1);
+    for (unsigned i = 0; i < objects; ++i)
+    {
+        TVertices object = generateVertices(500, 20, i + 10);
+        SVertex center = vertices[position(generator)];
+        for (unsigned j = 0; j < object.size(); ++j)
+        {
+            object[j] = SVertex(object[j].x + center.x - 10, object[j].y + center.y - 10, object[j].z + center.z - 10);
+        }
+
+        queries.push_back(buildTree<TKDop16>(object));
+    }
+
+    run<SplitterByCenter<TKDop16> >("center", vertices, queries, pool, repeats);
+    run<SplitterByMedian<TKDop16> >("median", vertices, queries, pool, repeats);
+    run<SplitterBySah<TKDop16> >("sah", vertices, queries, pool, repeats);
+    for (unsigned i = 0; i < queries.size(); ++i)
+    {
+        delete queries[i];
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = getArgument(argc, argv, 1, 200000);
+    unsigned threads = getArgument(argc, argv, 2, 8);
+    unsigned objects = getArgument(argc, argv, 3, 1000);
+    unsigned repeats = getArgument(argc, argv, 4, 3);
+
+    TaskPool pool(threads);
+    run("uniform", generateVertices(count, 1000, 1), objects, pool, repeats);
+    run("clustered", generateClusters(count, 50, 1000, 1), objects, pool, repeats);
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_LINEARBUILDER
+#define BVH3_LINEARBUILDER
+
+#include <bvh3/types/SVertex.hpp>
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace NBvh3
+{
+
+/**
+ * Spreads lower 10 bits to every third bit of 30-bit code.
+ */
+inline std::uint32_t expandBits(std::uint32_t value)
+{
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+/**
+ * Spreads lower 21 bits to every third bit of 63-bit code.
+ */
+inline std::uint64_t expandBits(std::uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | (value << 32)) & 0x001f00000000ffffull;
+    value = (value | (value << 16)) & 0x001f0000ff0000ffull;
+    value = (value | (value << 8)) & 0x100f00f00f00f00full;
+    value = (value | (value << 4)) & 0x10c30c30c30c30c3ull;
+    value = (value | (value << 2)) & 0x1249249249249249ull;
+    return value;
+}
+
+/**
+ * Returns number of leading zero bits.
+ */
+inline unsigned countLeadingZeros(std::uint32_t value)
+{
+    if (value == 0)
+    {
+        return 32;
+    }
+
+#if defined(_MSC_VER)
+    unsigned long bit = 0;
+    _BitScanReverse(&bit, value);
+    return 31 - bit;
+#else
+    return __builtin_clz(value);
+#endif
+}
+
+/**
+ * Returns number of leading zero bits.
+ */
+inline unsigned countLeadingZeros(std::uint64_t value)
+{
+#if defined(_MSC_VER)
+    // _BitScanReverse64() is not available on 32-bit targets.
+    std::uint32_t high = std::uint32_t(value >> 32);
+    return high != 0 ? countLeadingZeros(high) : 32 + countLeadingZeros(std::uint32_t(value));
+#else
+    return value == 0 ? 64 : __builtin_clzll(value);
+#endif
+}
+
+/**
+ * Returns cell of the coordinate clamped to [0, maxCell].
+ * Converting of NaN or out of range values to an integer is undefined.
+ */
+inline std::uint32_t getMortonCell(float value, float min, float scale, std::uint32_t maxCell)
+{
+    float cell = (value - min) * scale;
+    if (!(cell > 0))
+    {
+        return 0;
+    }
+
+    return cell < float(maxCell) ? std::uint32_t(cell) : maxCell;
+}
+
+/**
+ * Computes Morton codes of vertices quantized inside the bounding volume.
+ * Uses 10 bits per axis for 32-bit codes and 21 bits per axis for 64-bit codes.
+ *
+ * @tparam TCode std::uint32_t or std::uint64_t.
+ * @param Vertices.
+ * @param Bounding volume of the vertices.
+ * @param[out] Codes of vertices.
+ */
+template<class TCode, class TBv>
+void getMortonCodes(const TVertices& vertices, const TBv& bv, std::vector<TCode>& codes)
+{
+    const unsigned bits = sizeof(TCode) == 4 ? 10 : 21;
+    const float cells = float(1u << bits);
+    const std::uint32_t maxCell = (1u << bits) - 1;
+    float mins[3];
+    float scales[3];
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        float extent = bv.getMax(axis) - bv.getMin(axis);
+        mins[axis] = bv.getMin(axis);
+        // cells / extent overflows to inf for denormal extents, inf * 0 is NaN and not a cell.
+        float scale = cells / extent;
+        scales[axis] = extent > 0 && std::isfinite(scale) ? scale : 0;
+    }
+
+    codes.resize(vertices.size());
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        const SVertex& vertex = vertices[i];
+        TCode x = getMortonCell(vertex.x, mins[0], scales[0], maxCell);
+        TCode y = getMortonCell(vertex.y, mins[1], scales[1], maxCell);
+        TCode z = getMortonCell(vertex.z, mins[2], scales[2], maxCell);
+        codes[i] = (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+    }
+}
+
+/**
+ * Sorts indices by codes with least significant digit radix sort, 8 bits per pass.
+ * Passes with the same digit in all codes are skipped.
+ *
+ * @param[in,out] Codes to sort.
+ * @param[in,out] Indices moved together with codes.
+ */
+template<class TCode>
+void radixSort(std::vector<TCode>& codes, std::vector<unsigned>& indices)
+{
+    unsigned size = codes.size();
+    std::vector<TCode> codesBuffer(size);
+    std::vector<unsigned> indicesBuffer(size);
+    for (unsigned shift = 0; shift < sizeof(TCode) * 8; shift += 8)
+    {
+        unsigned offsets[256] = {0};
+        for (unsigned i = 0; i < size; ++i)
+        {
+            ++offsets[(codes[i] >> shift) & 0xff];
+        }
+
+        if (size == 0 || offsets[(codes[0] >> shift) & 0xff] == size)
+        {
+            continue;
+        }
+
+        unsigned sum = 0;
+        for (unsigned digit = 0; digit < 256; ++digit)
+        {
+            unsigned count = offsets[digit];
+            offsets[digit] = sum;
+            sum += count;
+        }
+
+        for (unsigned i = 0; i < size; ++i)
+        {
+            unsigned position = offsets[(codes[i] >> shift) & 0xff]++;
+            codesBuffer[position] = codes[i];
+            indicesBuffer[position] = indices[i];
+        }
+
+        codes.swap(codesBuffer);
+        indices.swap(indicesBuffer);
+    }
+}
+
+/**
+ * Finds the first code of the right part of [begin, end) range of sorted codes:
+ * the first one that differs from the first code in the highest differing bit.
+ * Splits in the middle if all codes are equal.
+ */
+template<class TCode>
+unsigned findSplit(const TCode* codes, unsigned begin, unsigned end)
+{
+    TCode first = codes[begin];
+    TCode last = codes[end - 1];
+    if (first == last)
+    {
+        return (begin + end) / 2;
+    }
+
+    unsigned prefix = countLeadingZeros(TCode(first ^ last));
+
+    // Binary search of the last code sharing more than prefix bits with the first one.
+    unsigned split = begin;
+    unsigned step = end - 1 - begin;
+    do
+    {
+        step = (step + 1) / 2;
+        unsigned next = split + step;
+        if (next < end - 1 && countLeadingZeros(TCode(first ^ codes[next])) > prefix)
+        {
+            split = next;
+        }
+    }
+    while (step > 1);
+
+    return split + 1;
+}
+
+/**
+ * Appends nodes of [begin, end) range of sorted codes in depth-first order.
+ * Bounding volumes are not computed.
+ *
+ * @param Sorted codes.
+ * @param First code of the range.
+ * @param Code after the last one.
+ * @param[out] Nodes in depth-first order.
+ * @param Maximal number of vertices in a leaf.
+ * @return Index of created node.
+ */
+template<class TBv, class TCode>
+unsigned emitLinearNode(
+    const TCode* codes,
+    unsigned begin,
+    unsigned end,
+    typename FlatTree<TBv>::TNodes& nodes,
+    unsigned maxLeafSize = 1
+    )
+{
+    unsigned result = nodes.size();
+    nodes.push_back(SFlatNode<TBv>());
+    std::uint32_t index = begin;
+    std::uint32_t count = end - begin;
+    if (count > maxLeafSize)
+    {
+        unsigned middle = findSplit(codes, begin, end);
+        emitLinearNode<TBv>(codes, begin, middle, nodes, maxLeafSize);
+        index = emitLinearNode<TBv>(codes, middle, end, nodes, maxLeafSize);
+        count = 0;
+    }
+
+    nodes[result].index = index;
+    nodes[result].count = count;
+
+    return result;
+}
+
+/**
+ * Creates a flat tree by sorting vertices along Morton curve.
+ * Hierarchy is taken from prefixes of the sorted codes,
+ * then bounding volumes are computed bottom-up.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TCode std::uint32_t for 30-bit codes or std::uint64_t for 63-bit codes.
+ * @param Original vertices.
+ * @param[out] Created tree.
+ * @param Maximal number of vertices in a leaf.
+ */
+template<class TBv, class TCode = std::uint32_t>
+void buildLinearTree(const TVertices& vertices, FlatTree<TBv>& tree, unsigned maxLeafSize = 1)
+{
+    unsigned size = vertices.size();
+    TBv bv = createBoundingVolume<TBv>(vertices);
+    std::vector<TCode> codes;
+    getMortonCodes(vertices, bv, codes);
+
+    typename FlatTree<TBv>::TIndices indices(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        indices[i] = i;
+    }
+
+    radixSort(codes, indices);
+
+    TVertices ordered(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        ordered[i] = vertices[indices[i]];
+    }
+
+    typename FlatTree<TBv>::TNodes nodes;
+    if (size > 0)
+    {
+        nodes.reserve(2 * size - 1);
+        emitLinearNode<TBv>(codes.data(), 0, size, nodes, std::max(maxLeafSize, 1u));
+    }
+
+    // Children are stored after their parents.
+    for (unsigned i = nodes.size(); i-- > 0;)
+    {
+        SFlatNode<TBv>& node = nodes[i];
+        if (node.count != 0)
+        {
+            node.bv = createBoundingVolume<TBv>(ordered.data() + node.index, node.count);
+        }
+        else
+        {
+            node.bv = nodes[i + 1].bv + nodes[node.index].bv;
+        }
+    }
+
+    tree = FlatTree<TBv>(std::move(nodes), std::move(ordered), std::move(indices));
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_LINEARBUILDER
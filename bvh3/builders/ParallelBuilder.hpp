@@ -0,0 +1,462 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_PARALLELBUILDER
+#define BVH3_PARALLELBUILDER
+
+#include <bvh3/types/SVertex.hpp>
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/parallel/TaskPool.hpp>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Builds a flat tree top-down using a task pool.
+ * Subtrees bigger than the task cutoff are forked as tasks,
+ * smaller ones are built serially to own arrays of nodes.
+ * Near the root the bounding volume and the partition are computed by chunks in parallel,
+ * smaller nodes are partitioned by the splitter like in serial buildTree().
+ * The nodes are stitched to one array in depth-first order at the end.
+ *
+ * Chunks keep relative order of indices and the serial partition does not,
+ * so the tree is the same as built by serial buildTree() only when the halves do not depend on the order:
+ * isLeft() after prepare() splits the same vertices as partition() and partitionByCount() orders ties.
+ * It is not the case for coincident medians of SplitterByMedian.
+ * Vertices inside leaves of more than one vertex could be ordered differently.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ */
+template<class TBv, class TSplitter>
+class ParallelBuilder
+{
+public:
+
+    /**
+     * @param Pool to execute tasks.
+     * @param Maximal number of vertices in a leaf.
+     * @param Minimal number of vertices of a subtree to build it in a separate task.
+     * @param Minimal number of vertices of a node to partition it by chunks in parallel.
+     */
+    ParallelBuilder(TaskPool& pool, unsigned maxLeafSize, unsigned taskCutoff, unsigned chunkCutoff);
+
+    /**
+     * Creates the tree.
+     *
+     * @param Original vertices.
+     * @param[out] Created tree.
+     */
+    void build(const TVertices& vertices, FlatTree<TBv>& tree);
+
+private:
+
+    /**
+     * Node built in parallel or a subtree built serially.
+     */
+    struct SSubtree
+    {
+        /**
+         * Bounding volume of the node.
+         */
+        TBv bv;
+
+        /**
+         * Children of the node, 0 for serial subtrees.
+         */
+        std::unique_ptr<SSubtree> left;
+        std::unique_ptr<SSubtree> right;
+
+        /**
+         * Nodes of serial subtree with right children relative to the first node.
+         */
+        typename FlatTree<TBv>::TNodes nodes;
+
+        /**
+         * Number of flat nodes in the subtree.
+         */
+        unsigned size;
+    };
+
+    /**
+     * Builds the subtree on [begin, end) range of indices.
+     *
+     * @param Number of levels the subtree could take below its root.
+     */
+    void build(SSubtree& subtree, unsigned begin, unsigned end, unsigned levels);
+
+    /**
+     * Writes nodes of the subtree starting from the offset.
+     */
+    void stitch(const SSubtree& subtree, unsigned offset, typename FlatTree<TBv>::TNodes& nodes);
+
+    /**
+     * Creates bounding volume of [begin, end) range of indices by chunks in parallel.
+     */
+    TBv createBoundingVolume(unsigned begin, unsigned end);
+
+    /**
+     * Reorders [begin, end) range of indices by chunks in parallel so left vertices go first.
+     * Keeps relative order of indices.
+     *
+     * @return First index of the right part.
+     */
+    unsigned partition(const TSplitter& splitter, unsigned begin, unsigned end);
+
+    /**
+     * Returns number of chunks to process the range in parallel.
+     */
+    unsigned getChunks(unsigned size) const;
+
+    /**
+     * Executes tasks.
+     */
+    TaskPool& mPool;
+
+    /**
+     * Maximal number of vertices in a leaf.
+     */
+    unsigned mMaxLeafSize;
+
+    /**
+     * Minimal number of vertices of a subtree to build it in a separate task.
+     */
+    unsigned mTaskCutoff;
+
+    /**
+     * Minimal number of vertices of a node to process it by chunks in parallel.
+     */
+    unsigned mChunkCutoff;
+
+    /**
+     * All vertices.
+     */
+    const SVertex* mVertices;
+
+    /**
+     * Indices of vertices, reordered in place.
+     */
+    unsigned* mIndices;
+
+    /**
+     * Temporary indices used by parallel partition.
+     */
+    std::vector<unsigned> mBuffer;
+};
+
+template<class TBv, class TSplitter>
+ParallelBuilder<TBv, TSplitter>::ParallelBuilder(
+    TaskPool& pool,
+    unsigned maxLeafSize,
+    unsigned taskCutoff,
+    unsigned chunkCutoff
+    )
+    : mPool(pool)
+    , mMaxLeafSize(std::max(maxLeafSize, 1u))
+    , mTaskCutoff(std::max(taskCutoff, mMaxLeafSize + 1))
+    , mChunkCutoff(std::max(chunkCutoff, 2u))
+    , mVertices(0)
+    , mIndices(0)
+{
+}
+
+template<class TBv, class TSplitter>
+unsigned ParallelBuilder<TBv, TSplitter>::getChunks(unsigned size) const
+{
+    unsigned chunks = (mPool.getSize() + 1) * 4;
+    return std::max(1u, std::min(chunks, size / (mChunkCutoff / 4 + 1)));
+}
+
+template<class TBv, class TSplitter>
+TBv ParallelBuilder<TBv, TSplitter>::createBoundingVolume(unsigned begin, unsigned end)
+{
+    unsigned size = end - begin;
+    unsigned chunks = getChunks(size);
+    std::vector<TBv> bvs(chunks);
+    {
+        TaskGroup group(mPool);
+        for (unsigned i = 0; i < chunks; ++i)
+        {
+            unsigned first = begin + unsigned(std::uint64_t(size) * i / chunks);
+            unsigned last = begin + unsigned(std::uint64_t(size) * (i + 1) / chunks);
+            TBv* bv = &bvs[i];
+            group.run([this, bv, first, last] {
+                *bv = NBvh3::createBoundingVolume<TBv>(mVertices, mIndices + first, last - first);
+            });
+        }
+
+        group.wait();
+    }
+
+    TBv result;
+    for (unsigned i = 0; i < chunks; ++i)
+    {
+        result += bvs[i];
+    }
+
+    return result;
+}
+
+template<class TBv, class TSplitter>
+unsigned ParallelBuilder<TBv, TSplitter>::partition(const TSplitter& splitter, unsigned begin, unsigned end)
+{
+    unsigned size = end - begin;
+    unsigned chunks = getChunks(size);
+    std::vector<unsigned> bounds(chunks + 1);
+    for (unsigned i = 0; i <= chunks; ++i)
+    {
+        bounds[i] = begin + unsigned(std::uint64_t(size) * i / chunks);
+    }
+
+    // Counts left vertices of each chunk.
+    std::vector<unsigned> lefts(chunks);
+    {
+        TaskGroup group(mPool);
+        for (unsigned i = 0; i < chunks; ++i)
+        {
+            unsigned* left = &lefts[i];
+            unsigned first = bounds[i];
+            unsigned last = bounds[i + 1];
+            group.run([this, &splitter, left, first, last] {
+                unsigned count = 0;
+                for (unsigned j = first; j < last; ++j)
+                {
+                    count += splitter.isLeft(mVertices[mIndices[j]]);
+                }
+
+                *left = count;
+            });
+        }
+
+        group.wait();
+    }
+
+    unsigned middle = begin;
+    for (unsigned i = 0; i < chunks; ++i)
+    {
+        middle += lefts[i];
+    }
+
+    // Scatters indices of each chunk to the buffer and copies them back.
+    {
+        TaskGroup group(mPool);
+        unsigned left = begin;
+        unsigned right = middle;
+        for (unsigned i = 0; i < chunks; ++i)
+        {
+            unsigned first = bounds[i];
+            unsigned last = bounds[i + 1];
+            group.run([this, &splitter, first, last, left, right] {
+                unsigned* buffer = mBuffer.data();
+                unsigned l = left;
+                unsigned r = right;
+                for (unsigned j = first; j < last; ++j)
+                {
+                    unsigned index = mIndices[j];
+                    if (splitter.isLeft(mVertices[index]))
+                    {
+                        buffer[l++] = index;
+                    }
+                    else
+                    {
+                        buffer[r++] = index;
+                    }
+                }
+            });
+
+            left += lefts[i];
+            right += last - first - lefts[i];
+        }
+
+        group.wait();
+    }
+
+    {
+        TaskGroup group(mPool);
+        for (unsigned i = 0; i < chunks; ++i)
+        {
+            unsigned first = bounds[i];
+            unsigned last = bounds[i + 1];
+            group.run([this, first, last] {
+                std::copy(mBuffer.data() + first, mBuffer.data() + last, mIndices + first);
+            });
+        }
+
+        group.wait();
+    }
+
+    return middle;
+}
+
+template<class TBv, class TSplitter>
+void ParallelBuilder<TBv, TSplitter>::build(SSubtree& subtree, unsigned begin, unsigned end, unsigned levels)
+{
+    unsigned size = end - begin;
+    if (size < mTaskCutoff)
+    {
+        subtree.nodes.reserve(2 * size - 1);
+        buildFlatNode<TBv, TSplitter>(mVertices, mIndices, begin, end, subtree.nodes, mMaxLeafSize, levels);
+        subtree.size = subtree.nodes.size();
+        return;
+    }
+
+    bool chunked = size >= mChunkCutoff;
+    subtree.bv = chunked
+        ? createBoundingVolume(begin, end)
+        : NBvh3::createBoundingVolume<TBv>(mVertices, mIndices + begin, size);
+
+    unsigned middle = begin;
+    if (!needsSplitByCount(size, levels))
+    {
+        TSplitter splitter(subtree.bv);
+        if (chunked)
+        {
+            splitter.prepare(mVertices, mIndices + begin, mIndices + end);
+            middle = partition(splitter, begin, end);
+        }
+        else
+        {
+            middle = splitter.partition(mVertices, mIndices + begin, mIndices + end) - mIndices;
+        }
+    }
+
+    // Degenerate ranges are rare, so they are split serially.
+    if (middle == begin || middle == end)
+    {
+        middle = partitionByCount(subtree.bv, mVertices, mIndices + begin, mIndices + end) - mIndices;
+    }
+
+    subtree.left.reset(new SSubtree());
+    subtree.right.reset(new SSubtree());
+    SSubtree* left = subtree.left.get();
+    {
+        TaskGroup group(mPool);
+        group.run([this, left, begin, middle, levels] { build(*left, begin, middle, levels - 1); });
+        build(*subtree.right, middle, end, levels - 1);
+        group.wait();
+    }
+
+    subtree.size = 1 + subtree.left->size + subtree.right->size;
+}
+
+template<class TBv, class TSplitter>
+void ParallelBuilder<TBv, TSplitter>::stitch(
+    const SSubtree& subtree,
+    unsigned offset,
+    typename FlatTree<TBv>::TNodes& nodes
+    )
+{
+    if (!subtree.left)
+    {
+        for (unsigned i = 0; i < subtree.nodes.size(); ++i)
+        {
+            SFlatNode<TBv>& node = nodes[offset + i];
+            node = subtree.nodes[i];
+            if (node.count == 0)
+            {
+                node.index += offset;
+            }
+        }
+
+        return;
+    }
+
+    unsigned right = offset + 1 + subtree.left->size;
+    SFlatNode<TBv>& node = nodes[offset];
+    node.bv = subtree.bv;
+    node.index = right;
+    node.count = 0;
+
+    const SSubtree* left = subtree.left.get();
+    TaskGroup group(mPool);
+    group.run([this, left, offset, &nodes] { stitch(*left, offset + 1, nodes); });
+    stitch(*subtree.right, right, nodes);
+    group.wait();
+}
+
+template<class TBv, class TSplitter>
+void ParallelBuilder<TBv, TSplitter>::build(const TVertices& vertices, FlatTree<TBv>& tree)
+{
+    unsigned size = vertices.size();
+    typename FlatTree<TBv>::TNodes nodes;
+    typename FlatTree<TBv>::TIndices indices(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        indices[i] = i;
+    }
+
+    if (size > 0)
+    {
+        mVertices = vertices.data();
+        mIndices = indices.data();
+        mBuffer.resize(size >= mChunkCutoff ? size : 0);
+
+        SSubtree root;
+        build(root, 0, size, getDepthLimit(size));
+        mBuffer = std::vector<unsigned>();
+
+        nodes.resize(root.size);
+        stitch(root, 0, nodes);
+    }
+
+    TVertices ordered(size);
+    {
+        TaskGroup group(mPool);
+        unsigned chunks = getChunks(size);
+        for (unsigned i = 0; i < chunks && size > 0; ++i)
+        {
+            unsigned first = unsigned(std::uint64_t(size) * i / chunks);
+            unsigned last = unsigned(std::uint64_t(size) * (i + 1) / chunks);
+            group.run([&vertices, &ordered, &indices, first, last] {
+                for (unsigned j = first; j < last; ++j)
+                {
+                    ordered[j] = vertices[indices[j]];
+                }
+            });
+        }
+
+        group.wait();
+    }
+
+    tree = FlatTree<TBv>(std::move(nodes), std::move(ordered), std::move(indices));
+}
+
+/**
+ * Creates a flat binary tree in parallel using the task pool.
+ * The tree is the same as created by serial buildTree() for splitters not depending on the order of vertices,
+ * see ParallelBuilder.
+ *
+ * @tparam Bounding volume type.
+ * @tparam TSplitter Splits submitted vertices by some logic.
+ * @param Original vertices.
+ * @param[out] Created tree.
+ * @param Pool to execute tasks.
+ * @param Maximal number of vertices in a leaf.
+ * @param Minimal number of vertices of a subtree to build it in a separate task.
+ * @param Minimal number of vertices of a node to partition it by chunks in parallel.
+ */
+template<class TBv, class TSplitter = SplitterByCenter<TBv> >
+void buildTree(
+    const TVertices& vertices,
+    FlatTree<TBv>& tree,
+    TaskPool& pool,
+    unsigned maxLeafSize = 1,
+    unsigned taskCutoff = 4096,
+    unsigned chunkCutoff = 65536
+    )
+{
+    ParallelBuilder<TBv, TSplitter>(pool, maxLeafSize, taskCutoff, chunkCutoff).build(vertices, tree);
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_PARALLELBUILDER
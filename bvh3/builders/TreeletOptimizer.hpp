@@ -0,0 +1,457 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_TREELETOPTIMIZER
+#define BVH3_TREELETOPTIMIZER
+
+#include <bvh3/types/SVertex.hpp>
+#include <bvh3/bv/all.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/parallel/TaskPool.hpp>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Improves a built tree by restructuring small treelets bottom-up.
+ * A treelet of a node is formed by expanding its descendant with the biggest surface area
+ * until it has the treelet size of subtrees. The topology of the treelet over these subtrees
+ * with minimal sum of surface areas of its nodes is found over all subsets of subtrees.
+ * Areas of boxes are taken from TBv::getBoxSurfaceArea(), the same as by getSurfaceAreaCost().
+ * Only topologies that fit the rest of levels are considered,
+ * so the tree is not deeper than twice a balanced one or than before.
+ * Shared vertices are reordered after every pass, so each node refers to its range of them again.
+ *
+ * @tparam Bounding volume type.
+ */
+template<class TBv>
+class TreeletOptimizer
+{
+public:
+
+    /**
+     * Maximal number of subtrees of a treelet.
+     */
+    static const unsigned MAX_TREELET_SIZE = 8;
+
+    /**
+     * @param Number of subtrees of a treelet, from 3 to MAX_TREELET_SIZE.
+     * @param Maximal number of passes over the tree.
+     */
+    TreeletOptimizer(unsigned treeletSize, unsigned passes);
+
+    /**
+     * Optimizes the tree.
+     * Nodes should share vertices, like trees created by buildTree().
+     *
+     * @param Root of the tree.
+     * @return Number of restructured treelets.
+     */
+    unsigned optimize(Node<TBv>* root);
+
+    /**
+     * Optimizes the tree. Disjoint subtrees are optimized in parallel.
+     *
+     * @param Root of the tree.
+     * @param Pool to execute tasks.
+     * @param Minimal number of vertices of a subtree to optimize it in a separate task.
+     * @return Number of restructured treelets.
+     */
+    unsigned optimize(Node<TBv>* root, TaskPool& pool, unsigned cutoff = 8192);
+
+private:
+
+    /**
+     * Treelet and its best topologies over all subsets of its subtrees.
+     */
+    struct STreelet
+    {
+        /**
+         * Subtrees.
+         */
+        Node<TBv>* leaves[MAX_TREELET_SIZE];
+
+        /**
+         * Nodes reused for the new topology, the root goes first.
+         */
+        Node<TBv>* internals[MAX_TREELET_SIZE];
+
+        /**
+         * Number of internal nodes taken by link().
+         */
+        unsigned used;
+
+        /**
+         * Bounding volumes of subsets of subtrees.
+         */
+        TBv bvs[1 << MAX_TREELET_SIZE];
+
+        /**
+         * Minimal sum of surface areas of internal nodes over a subset
+         * by depth of its node in the treelet. Infinity if no topology fits the rest of levels.
+         */
+        float costs[1 << MAX_TREELET_SIZE][MAX_TREELET_SIZE];
+
+        /**
+         * Subset of the left child of the best topology by depth.
+         */
+        unsigned splits[1 << MAX_TREELET_SIZE][MAX_TREELET_SIZE];
+    };
+
+    /**
+     * Heights of nodes of the tree, kept up to date by restructure().
+     */
+    typedef std::unordered_map<const Node<TBv>*, unsigned> THeights;
+
+    /**
+     * Stores heights of all nodes of the subtree.
+     *
+     * @return Number of levels of the subtree below its root.
+     */
+    unsigned storeHeights(const Node<TBv>* node);
+
+    /**
+     * Returns number of levels of the subtree below its root stored by storeHeights().
+     */
+    unsigned getHeight(const Node<TBv>* node) const;
+
+    /**
+     * Optimizes the subtree serially, children first.
+     *
+     * @param Root of the subtree.
+     * @param Number of levels the subtree could take below its root.
+     * @param Buffer reused by treelets of the subtree.
+     */
+    unsigned optimizeSubtree(Node<TBv>* node, unsigned levels, STreelet& treelet);
+
+    /**
+     * Optimizes the subtree forking big children as tasks.
+     */
+    unsigned optimizeSubtree(Node<TBv>* node, unsigned levels, TaskPool& pool, unsigned cutoff);
+
+    /**
+     * Restructures the treelet of the node if it becomes cheaper.
+     *
+     * @param Root of the treelet.
+     * @param Number of levels the treelet could take below its root.
+     * @param Buffer to find topologies.
+     * @return true If restructured.
+     */
+    bool restructure(Node<TBv>* root, unsigned levels, STreelet& treelet);
+
+    /**
+     * Links internal nodes of the treelet by the best topology over the subset and updates their heights.
+     *
+     * @param Treelet with found topologies.
+     * @param Subset of subtrees.
+     * @param Depth of the node of the subset in the treelet.
+     * @return Node of the subset.
+     */
+    Node<TBv>* link(STreelet& treelet, unsigned mask, unsigned depth);
+
+    /**
+     * Number of subtrees of a treelet.
+     */
+    unsigned mTreeletSize;
+
+    /**
+     * Maximal number of passes.
+     */
+    unsigned mPasses;
+
+    /**
+     * Heights of nodes of the tree in the current pass.
+     * Subtrees optimized in parallel update only their own nodes.
+     */
+    THeights mHeights;
+};
+
+template<class TBv>
+const unsigned TreeletOptimizer<TBv>::MAX_TREELET_SIZE;
+
+template<class TBv>
+TreeletOptimizer<TBv>::TreeletOptimizer(unsigned treeletSize, unsigned passes)
+    : mTreeletSize(std::max(3u, std::min(treeletSize, MAX_TREELET_SIZE)))
+    , mPasses(passes)
+{
+}
+
+template<class TBv>
+unsigned TreeletOptimizer<TBv>::optimize(Node<TBv>* root)
+{
+    unsigned result = 0;
+    std::unique_ptr<STreelet> treelet(new STreelet());
+    for (unsigned i = 0; root != 0 && i < mPasses; ++i)
+    {
+        unsigned levels = std::max(getDepthLimit(root->getEnd() - root->getBegin()), storeHeights(root));
+        unsigned restructured = optimizeSubtree(root, levels, *treelet);
+        if (restructured == 0)
+        {
+            break;
+        }
+
+        root->relayout();
+        result += restructured;
+    }
+
+    mHeights.clear();
+    return result;
+}
+
+template<class TBv>
+unsigned TreeletOptimizer<TBv>::optimize(Node<TBv>* root, TaskPool& pool, unsigned cutoff)
+{
+    unsigned result = 0;
+    for (unsigned i = 0; root != 0 && i < mPasses; ++i)
+    {
+        unsigned levels = std::max(getDepthLimit(root->getEnd() - root->getBegin()), storeHeights(root));
+        unsigned restructured = optimizeSubtree(root, levels, pool, cutoff);
+        if (restructured == 0)
+        {
+            break;
+        }
+
+        root->relayout();
+        result += restructured;
+    }
+
+    mHeights.clear();
+    return result;
+}
+
+template<class TBv>
+unsigned TreeletOptimizer<TBv>::storeHeights(const Node<TBv>* node)
+{
+    unsigned height = node->isLeaf() ? 0 : 1 + std::max(storeHeights(node->getLeft()), storeHeights(node->getRight()));
+    mHeights[node] = height;
+    return height;
+}
+
+template<class TBv>
+unsigned TreeletOptimizer<TBv>::getHeight(const Node<TBv>* node) const
+{
+    return mHeights.find(node)->second;
+}
+
+template<class TBv>
+unsigned TreeletOptimizer<TBv>::optimizeSubtree(Node<TBv>* node, unsigned levels, STreelet& treelet)
+{
+    if (node->isLeaf())
+    {
+        return 0;
+    }
+
+    unsigned result = optimizeSubtree(node->getLeft(), levels - 1, treelet);
+    result += optimizeSubtree(node->getRight(), levels - 1, treelet);
+    return result + restructure(node, levels, treelet);
+}
+
+template<class TBv>
+unsigned TreeletOptimizer<TBv>::optimizeSubtree(Node<TBv>* node, unsigned levels, TaskPool& pool, unsigned cutoff)
+{
+    // Ranges of nodes are valid until the node is restructured.
+    // Nodes of the map are only found and changed, so tasks do not conflict.
+    std::unique_ptr<STreelet> treelet(new STreelet());
+    if (node->isLeaf() || node->getEnd() - node->getBegin() < cutoff)
+    {
+        return optimizeSubtree(node, levels, *treelet);
+    }
+
+    unsigned left = 0;
+    unsigned right = 0;
+    {
+        TaskGroup group(pool);
+        Node<TBv>* child = node->getLeft();
+        group.run([this, &left, &pool, cutoff, child, levels] {
+            left = optimizeSubtree(child, levels - 1, pool, cutoff);
+        });
+        right = optimizeSubtree(node->getRight(), levels - 1, pool, cutoff);
+        group.wait();
+    }
+
+    return left + right + restructure(node, levels, *treelet);
+}
+
+template<class TBv>
+bool TreeletOptimizer<TBv>::restructure(Node<TBv>* root, unsigned levels, STreelet& treelet)
+{
+    if (root->isLeaf())
+    {
+        return false;
+    }
+
+    Node<TBv>** leaves = treelet.leaves;
+    leaves[0] = root->getLeft();
+    leaves[1] = root->getRight();
+    treelet.internals[0] = root;
+    unsigned count = 2;
+    unsigned internals = 1;
+    float cost = root->getBoundingVolume().getBoxSurfaceArea();
+    while (count < mTreeletSize)
+    {
+        // Expands the biggest subtree.
+        unsigned biggest = count;
+        float biggestArea = -1;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            float area = leaves[i]->getBoundingVolume().getBoxSurfaceArea();
+            if (!leaves[i]->isLeaf() && area > biggestArea)
+            {
+                biggest = i;
+                biggestArea = area;
+            }
+        }
+
+        if (biggest == count)
+        {
+            break;
+        }
+
+        Node<TBv>* node = leaves[biggest];
+        treelet.internals[internals++] = node;
+        cost += biggestArea;
+        leaves[biggest] = node->getLeft();
+        leaves[count++] = node->getRight();
+    }
+
+    // Two subtrees have only one topology.
+    if (count < 3)
+    {
+        return false;
+    }
+
+    // A subset of k subtrees is placed at most count - k levels below the root.
+    const float infinity = std::numeric_limits<float>::infinity();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned bit = 1 << i;
+        treelet.bvs[bit] = leaves[i]->getBoundingVolume();
+        unsigned height = getHeight(leaves[i]);
+        for (unsigned depth = 0; depth < count; ++depth)
+        {
+            treelet.costs[bit][depth] = height + depth <= levels ? 0 : infinity;
+        }
+    }
+
+    unsigned full = (1 << count) - 1;
+    for (unsigned mask = 1; mask <= full; ++mask)
+    {
+        unsigned lowest = mask & (~mask + 1);
+        if (mask == lowest)
+        {
+            continue;
+        }
+
+        treelet.bvs[mask] = treelet.bvs[mask ^ lowest];
+        treelet.bvs[mask] += treelet.bvs[lowest];
+        float area = treelet.bvs[mask].getBoxSurfaceArea();
+        unsigned size = 0;
+        for (unsigned rest = mask; rest != 0; rest &= rest - 1)
+        {
+            ++size;
+        }
+
+        for (unsigned depth = 0; depth + size <= count; ++depth)
+        {
+            // Each partition is visited once by keeping the lowest subtree on the left.
+            float bestCost = infinity;
+            unsigned bestSplit = 0;
+            for (unsigned left = (mask - 1) & mask; left != 0; left = (left - 1) & mask)
+            {
+                if ((left & lowest) == 0)
+                {
+                    continue;
+                }
+
+                float splitCost = treelet.costs[left][depth + 1] + treelet.costs[mask ^ left][depth + 1];
+                if (splitCost < bestCost)
+                {
+                    bestCost = splitCost;
+                    bestSplit = left;
+                }
+            }
+
+            treelet.costs[mask][depth] = area + bestCost;
+            treelet.splits[mask][depth] = bestSplit;
+        }
+    }
+
+    // Skips changes within rounding errors of the sum, infinite cost if nothing fits.
+    if (!(treelet.costs[full][0] < cost * 0.9999f))
+    {
+        return false;
+    }
+
+    treelet.used = 0;
+    link(treelet, full, 0);
+    return true;
+}
+
+template<class TBv>
+Node<TBv>* TreeletOptimizer<TBv>::link(STreelet& treelet, unsigned mask, unsigned depth)
+{
+    if ((mask & (mask - 1)) == 0)
+    {
+        unsigned i = 0;
+        while ((1u << i) != mask)
+        {
+            ++i;
+        }
+
+        return treelet.leaves[i];
+    }
+
+    Node<TBv>* node = treelet.internals[treelet.used++];
+    unsigned split = treelet.splits[mask][depth];
+    Node<TBv>* left = link(treelet, split, depth + 1);
+    Node<TBv>* right = link(treelet, mask ^ split, depth + 1);
+    node->setChildren(treelet.bvs[mask], left, right);
+    mHeights.find(node)->second = 1 + std::max(getHeight(left), getHeight(right));
+    return node;
+}
+
+/**
+ * Improves the tree by restructuring treelets to minimize surface area heuristic cost.
+ * Vertices shared by nodes are reordered.
+ *
+ * @tparam Bounding volume type.
+ * @param Root of the tree created by buildTree().
+ * @param Maximal number of passes over the tree.
+ * @param Number of subtrees of a treelet.
+ * @return Number of restructured treelets.
+ */
+template<class TBv>
+unsigned optimizeTree(Node<TBv>* root, unsigned passes = 3, unsigned treeletSize = 7)
+{
+    return TreeletOptimizer<TBv>(treeletSize, passes).optimize(root);
+}
+
+/**
+ * Improves the tree by restructuring treelets of disjoint subtrees in parallel.
+ *
+ * @tparam Bounding volume type.
+ * @param Root of the tree created by buildTree().
+ * @param Pool to execute tasks.
+ * @param Maximal number of passes over the tree.
+ * @param Number of subtrees of a treelet.
+ * @return Number of restructured treelets.
+ */
+template<class TBv>
+unsigned optimizeTree(Node<TBv>* root, TaskPool& pool, unsigned passes = 3, unsigned treeletSize = 7)
+{
+    return TreeletOptimizer<TBv>(treeletSize, passes).optimize(root, pool);
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_TREELETOPTIMIZER
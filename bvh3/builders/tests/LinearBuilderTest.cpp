@@ -0,0 +1,234 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/builders/LinearBuilder.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <bvh3/tests/TestHelpers.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TFlatTreeKDop16;
+
+/**
+ * Checks that every node bounds its children and leaves bound their vertices.
+ */
+void expectValid(const TFlatTreeKDop16& tree, const TVertices& vertices)
+{
+    unsigned leaves = 0;
+    for (unsigned i = 0; i < tree.getNodes().size(); ++i)
+    {
+        TKDop16 expected;
+        if (tree.isLeaf(i))
+        {
+            ++leaves;
+            SVertexRange range = tree.getVertices(i);
+            for (unsigned j = 0; j < range.size(); ++j)
+            {
+                expected += range[j];
+            }
+        }
+        else
+        {
+            expected = tree.getBoundingVolume(tree.getLeft(i)) + tree.getBoundingVolume(tree.getRight(i));
+        }
+
+        for (unsigned axis = 0; axis < 8; ++axis)
+        {
+            EXPECT_EQ(expected.getMin(axis), tree.getBoundingVolume(i).getMin(axis));
+            EXPECT_EQ(expected.getMax(axis), tree.getBoundingVolume(i).getMax(axis));
+        }
+    }
+
+    EXPECT_EQ(vertices.size(), leaves);
+    vector<unsigned> indices = tree.getIndices();
+    std::sort(indices.begin(), indices.end());
+    for (unsigned i = 0; i < indices.size(); ++i)
+    {
+        EXPECT_EQ(i, indices[i]);
+        EXPECT_EQ(vertices[tree.getIndices()[i]], tree.getVertices()[i]);
+    }
+}
+
+TEST(LinearBuilderTest, testExpandBits)
+{
+    EXPECT_EQ(0x9u, expandBits(std::uint32_t(3)));
+    EXPECT_EQ(0x09249249u, expandBits(std::uint32_t(0x3ff)));
+    EXPECT_EQ(0x1249249249249249ull, expandBits(std::uint64_t(0x1fffff)));
+    EXPECT_EQ(0x9ull, expandBits(std::uint64_t(3)));
+}
+
+TEST(LinearBuilderTest, testRadixSort)
+{
+    vector<std::uint32_t> codes = {0x30201, 5, 0x30200, 7, 0};
+    vector<unsigned> indices = {0, 1, 2, 3, 4};
+    radixSort(codes, indices);
+
+    EXPECT_EQ(vector<std::uint32_t>({0, 5, 7, 0x30200, 0x30201}), codes);
+    EXPECT_EQ(vector<unsigned>({4, 1, 3, 2, 0}), indices);
+}
+
+TEST(LinearBuilderTest, testFindSplit)
+{
+    std::uint32_t codes[] = {0, 1, 2, 3, 4, 5};
+    EXPECT_EQ(4, findSplit(codes, 0, 6));
+    EXPECT_EQ(2, findSplit(codes, 0, 4));
+    EXPECT_EQ(1, findSplit(codes, 0, 2));
+
+    std::uint32_t same[] = {7, 7, 7, 7};
+    EXPECT_EQ(2, findSplit(same, 0, 4));
+}
+
+TEST(LinearBuilderTest, testCountLeadingZeros)
+{
+    EXPECT_EQ(32u, countLeadingZeros(std::uint32_t(0)));
+    EXPECT_EQ(31u, countLeadingZeros(std::uint32_t(1)));
+    EXPECT_EQ(0u, countLeadingZeros(std::uint32_t(0x80000000u)));
+    EXPECT_EQ(64u, countLeadingZeros(std::uint64_t(0)));
+    EXPECT_EQ(63u, countLeadingZeros(std::uint64_t(1)));
+    EXPECT_EQ(31u, countLeadingZeros(std::uint64_t(0x100000000ull)));
+    EXPECT_EQ(0u, countLeadingZeros(std::uint64_t(0x8000000000000000ull)));
+}
+
+TEST(LinearBuilderTest, testMortonCodesDegenerateExtent)
+{
+    // Extents are denormal or too large for the float range.
+    const float tiny = std::numeric_limits<float>::denorm_min();
+    const float huge = std::numeric_limits<float>::max();
+    TVertices vertices =
+    {
+        {0, 0, -huge},
+        {tiny, 3 * tiny, huge},
+        {2 * tiny, tiny, 0}
+    };
+
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    vector<std::uint32_t> codes;
+    getMortonCodes(vertices, bv, codes);
+    ASSERT_EQ(3u, codes.size());
+    for (unsigned i = 0; i < codes.size(); ++i)
+    {
+        EXPECT_GT(1u << 30, codes[i]);
+    }
+
+    vector<std::uint64_t> codes64;
+    getMortonCodes(vertices, bv, codes64);
+    ASSERT_EQ(3u, codes64.size());
+    for (unsigned i = 0; i < codes64.size(); ++i)
+    {
+        EXPECT_GT(1ull << 63, codes64[i]);
+    }
+
+    TFlatTreeKDop16 tree;
+    buildLinearTree<TKDop16>(vertices, tree);
+    expectValid(tree, vertices);
+}
+
+TEST(LinearBuilderTest, testBuildTriangle)
+{
+    TVertices triangle =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    TFlatTreeKDop16 tree;
+    buildLinearTree<TKDop16>(triangle, tree);
+
+    ASSERT_EQ(5, tree.getNodes().size());
+    EXPECT_EQ(1, tree.getBoundingVolume(0).getMin(0));
+    EXPECT_EQ(5, tree.getBoundingVolume(0).getMax(0));
+    EXPECT_EQ(1, tree.getBoundingVolume(0).getMin(1));
+    EXPECT_EQ(5, tree.getBoundingVolume(0).getMax(1));
+    expectValid(tree, triangle);
+}
+
+TEST(LinearBuilderTest, testBuildEmpty)
+{
+    TFlatTreeKDop16 tree;
+    buildLinearTree<TKDop16>(TVertices(), tree);
+    EXPECT_TRUE(tree.empty());
+}
+
+TEST(LinearBuilderTest, testBuildGrid)
+{
+    TVertices vertices = getGrid(10, 1);
+    TFlatTreeKDop16 tree;
+    buildLinearTree<TKDop16>(vertices, tree);
+    EXPECT_EQ(2 * vertices.size() - 1, tree.getNodes().size());
+    expectValid(tree, vertices);
+
+    TFlatTreeKDop16 tree64;
+    buildLinearTree<TKDop16, std::uint64_t>(vertices, tree64);
+    expectValid(tree64, vertices);
+}
+
+TEST(LinearBuilderTest, testBuildDuplicates)
+{
+    TVertices vertices(1000, SVertex(1, 2, 3));
+    vertices.push_back(SVertex(5, 5, 5));
+
+    TFlatTreeKDop16 tree;
+    buildLinearTree<TKDop16>(vertices, tree);
+    expectValid(tree, vertices);
+
+    // Equal codes are split in the middle.
+    EXPECT_GE(12, getDepth(tree));
+}
+
+TEST(LinearBuilderTest, testCollided)
+{
+    TVertices grid = getGrid(10, 2);
+    TVertices vertices1(grid.begin(), grid.begin() + 600);
+    TVertices vertices2(grid.begin() + 400, grid.end());
+
+    TFlatTreeKDop16 tree1;
+    TFlatTreeKDop16 tree2;
+    buildLinearTree<TKDop16>(vertices1, tree1);
+    buildTree<TKDop16>(vertices2, tree2);
+
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(tree1.collided(tree2, output));
+    EXPECT_EQ(200, output.size());
+    for (unsigned i = 0; i < output.size(); ++i)
+    {
+        EXPECT_EQ(tree1.getVertices(output[i].first)[0], tree2.getVertices(output[i].second)[0]);
+    }
+}
+
+TEST(LinearBuilderTest, testMaxLeafSize)
+{
+    TVertices vertices = getGrid(10, 4);
+    TFlatTreeKDop16 tree;
+    buildLinearTree<TKDop16>(vertices, tree, 8);
+
+    unsigned count = 0;
+    for (unsigned i = 0; i < tree.getNodes().size(); ++i)
+    {
+        if (tree.isLeaf(i))
+        {
+            EXPECT_GE(8u, tree.getVertices(i).size());
+            TKDop16 expected;
+            expected.merge(tree.getVertices(i).begin(), tree.getVertices(i).size());
+            for (unsigned axis = 0; axis < 8; ++axis)
+            {
+                EXPECT_EQ(expected.getMin(axis), tree.getBoundingVolume(i).getMin(axis));
+                EXPECT_EQ(expected.getMax(axis), tree.getBoundingVolume(i).getMax(axis));
+            }
+
+            count += tree.getVertices(i).size();
+        }
+    }
+
+    EXPECT_EQ(vertices.size(), count);
+    EXPECT_GT(vertices.size(), tree.getNodes().size());
+}
@@ -0,0 +1,221 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/builders/ParallelBuilder.hpp>
+#include <bvh3/splitters/SplitterByMedian.hpp>
+#include <bvh3/splitters/SplitterBySah.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <bvh3/tests/TestHelpers.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <random>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TFlatTreeKDop16;
+
+TEST(ParallelBuilderTest, testEmpty)
+{
+    TaskPool pool(2);
+    TFlatTreeKDop16 tree;
+    buildTree(TVertices(), tree, pool);
+
+    EXPECT_TRUE(tree.empty());
+}
+
+TEST(ParallelBuilderTest, testOneVertex)
+{
+    TaskPool pool(2);
+    TVertices vertices;
+    vertices.push_back(SVertex(1, 2, 3));
+    TFlatTreeKDop16 tree;
+    buildTree(vertices, tree, pool, 1, 2, 2);
+
+    ASSERT_EQ(1u, tree.getNodes().size());
+    EXPECT_TRUE(tree.isLeaf(0));
+    EXPECT_EQ(vertices, tree.getVertices());
+}
+
+TEST(ParallelBuilderTest, testSameAsSerial)
+{
+    TVertices vertices = getGrid(16, 1);
+    TFlatTreeKDop16 expected;
+    buildTree(vertices, expected);
+
+    for (unsigned threads = 1; threads <= 4; ++threads)
+    {
+        TaskPool pool(threads);
+        TFlatTreeKDop16 tree;
+        buildTree(vertices, tree, pool, 1, 16, 256);
+        expectEqualTrees(expected, tree);
+    }
+}
+
+TEST(ParallelBuilderTest, testSameAsSerialByDefault)
+{
+    TVertices vertices = getGrid(20, 2);
+    TFlatTreeKDop16 expected;
+    buildTree(vertices, expected);
+
+    TaskPool pool(3);
+    TFlatTreeKDop16 tree;
+    buildTree(vertices, tree, pool);
+    expectEqualTrees(expected, tree);
+}
+
+TEST(ParallelBuilderTest, testSameAsSerialBySah)
+{
+    TVertices vertices = getGrid(16, 3);
+    TFlatTreeKDop16 expected;
+    buildTree<TKDop16, SplitterBySah<TKDop16> >(vertices, expected);
+
+    TaskPool pool(4);
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16, SplitterBySah<TKDop16> >(vertices, tree, pool, 1, 8, 64);
+    expectEqualTrees(expected, tree);
+}
+
+TEST(ParallelBuilderTest, testSameAsSerialByMedian)
+{
+    TVertices vertices = getGrid(16, 5);
+    TFlatTreeKDop16 expected;
+    buildTree<TKDop16, SplitterByMedian<TKDop16> >(vertices, expected);
+
+    TaskPool pool(4);
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16, SplitterByMedian<TKDop16> >(vertices, tree, pool, 1, 8, 64);
+    expectEqualTrees(expected, tree);
+}
+
+TEST(ParallelBuilderTest, testSameAsSerialWithLeafSize)
+{
+    TVertices vertices = getGrid(16, 4);
+    TFlatTreeKDop16 expected;
+    buildTree(vertices, expected, 6);
+
+    TaskPool pool(4);
+    TFlatTreeKDop16 tree;
+    buildTree(vertices, tree, pool, 6, 4, 64);
+    ASSERT_EQ(expected.getNodes().size(), tree.getNodes().size());
+    for (unsigned i = 0; i < expected.getNodes().size(); ++i)
+    {
+        EXPECT_EQ(expected.getNodes()[i].index, tree.getNodes()[i].index);
+        EXPECT_EQ(expected.getNodes()[i].count, tree.getNodes()[i].count);
+        for (unsigned axis = 0; axis < 8; ++axis)
+        {
+            EXPECT_EQ(expected.getBoundingVolume(i).getMin(axis), tree.getBoundingVolume(i).getMin(axis));
+            EXPECT_EQ(expected.getBoundingVolume(i).getMax(axis), tree.getBoundingVolume(i).getMax(axis));
+        }
+    }
+}
+
+TEST(ParallelBuilderTest, testDuplicates)
+{
+    // Coincident clusters along a line, split by count once the center does not separate them.
+    TVertices vertices;
+    for (unsigned i = 0; i < 20000; ++i)
+    {
+        float t = i % 3 == 0 ? 0 : std::ldexp(1.0f, -int(i % 40));
+        vertices.push_back(SVertex(t, 0, 2 * t));
+    }
+
+    TFlatTreeKDop16 expected;
+    buildTree(vertices, expected);
+
+    TaskPool pool(4);
+    TFlatTreeKDop16 tree;
+    buildTree(vertices, tree, pool, 1, 16, 256);
+
+    expectEqualTrees(expected, tree);
+    EXPECT_GE(getDepthLimit(20000) + 1, getDepth(tree));
+}
+
+TEST(ParallelBuilderTest, testTiesOnSplitAxis)
+{
+    // Clusters along x so the depth limit splits by count, vertices of a cluster share x and differ by y.
+    TVertices vertices;
+    for (unsigned i = 0; i < 20000; ++i)
+    {
+        unsigned cluster = i % 40;
+        float x = cluster == 0 ? 0 : std::ldexp(1.0f, -int(cluster));
+        float y = std::ldexp(float(i / 40 % 25), -80);
+        vertices.push_back(SVertex(x, y, 0));
+    }
+
+    std::shuffle(vertices.begin(), vertices.end(), std::mt19937(7));
+
+    TFlatTreeKDop16 expected;
+    buildTree(vertices, expected);
+
+    // Coincident vertices too, so the halves depend on indices.
+    for (unsigned threads = 1; threads <= 4; threads += 3)
+    {
+        TaskPool pool(threads);
+        TFlatTreeKDop16 tree;
+        buildTree(vertices, tree, pool, 1, 16, 256);
+        expectEqualTrees(expected, tree);
+        EXPECT_GE(getDepthLimit(20000) + 1, getDepth(tree));
+    }
+}
+
+/**
+ * Splits by center and throws on one vertex, like a task running out of memory.
+ */
+class SplitterThrowing : public Splitter<SplitterThrowing>
+{
+public:
+
+    explicit SplitterThrowing(const TKDop16& bv)
+        : mSplitter(bv)
+    {
+    }
+
+    bool isLeft(const SVertex& vertex) const
+    {
+        if (vertex == SVertex(7, 7, 7))
+        {
+            throw std::bad_alloc();
+        }
+
+        return mSplitter.isLeft(vertex);
+    }
+
+private:
+
+    SplitterByCenter<TKDop16> mSplitter;
+};
+
+TEST(ParallelBuilderTest, testException)
+{
+    TVertices vertices = getGrid(16, 2);
+    TaskPool pool(4);
+
+    // Thrown in chunks of partitions, in subtree tasks and in the calling thread.
+    for (unsigned chunkCutoff = 256; chunkCutoff <= 65536; chunkCutoff *= 256)
+    {
+        TFlatTreeKDop16 tree;
+        EXPECT_THROW((buildTree<TKDop16, SplitterThrowing>(vertices, tree, pool, 1, 16, chunkCutoff)), std::bad_alloc);
+        EXPECT_TRUE(tree.empty());
+    }
+
+    // The pool is still usable.
+    TFlatTreeKDop16 expected;
+    buildTree(vertices, expected);
+    TFlatTreeKDop16 tree;
+    buildTree(vertices, tree, pool, 1, 16, 256);
+    expectEqualTrees(expected, tree);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
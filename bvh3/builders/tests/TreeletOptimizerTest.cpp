@@ -0,0 +1,242 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/builders/TreeletOptimizer.hpp>
+#include <bvh3/splitters/SplitterByMedian.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/Statistics.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <utility>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef Node<TKDop16> TNodeKDop16;
+
+/**
+ * Returns vertices of flat clusters of different sizes.
+ */
+TVertices getClusters(unsigned count, unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(0, 100);
+    std::normal_distribution<float> offset;
+    TVertices centers;
+    for (unsigned i = 0; i < 20; ++i)
+    {
+        centers.push_back(SVertex(position(generator), position(generator), position(generator)));
+    }
+
+    TVertices result;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const SVertex& center = centers[i % centers.size()];
+        float spread = 1 + i % 7;
+        result.push_back(
+            SVertex(
+                center.x + offset(generator) * spread,
+                center.y + offset(generator) * spread,
+                center.z + offset(generator) * spread / 10
+                )
+            );
+    }
+
+    return result;
+}
+
+/**
+ * Checks that ranges of nodes are contiguous and bounding volumes are exact.
+ */
+void validate(const TNodeKDop16* node)
+{
+    TKDop16 bv = createBoundingVolume<TKDop16>(node->getVertices().begin(), node->getVertices().size());
+    for (unsigned axis = 0; axis < 8; ++axis)
+    {
+        EXPECT_EQ(bv.getMin(axis), node->getBoundingVolume().getMin(axis));
+        EXPECT_EQ(bv.getMax(axis), node->getBoundingVolume().getMax(axis));
+    }
+
+    if (!node->isLeaf())
+    {
+        EXPECT_EQ(node->getBegin(), node->getLeft()->getBegin());
+        EXPECT_EQ(node->getLeft()->getEnd(), node->getRight()->getBegin());
+        EXPECT_EQ(node->getEnd(), node->getRight()->getEnd());
+        validate(node->getLeft());
+        validate(node->getRight());
+    }
+}
+
+/**
+ * Returns number of pairs of equal vertices of two trees.
+ */
+unsigned getVisited(const TNodeKDop16* root, const TNodeKDop16* query)
+{
+    unsigned result = 0;
+    root->visit(query, [&result](unsigned index, unsigned queryIndex) {
+        ++result;
+        return true;
+    });
+
+    return result;
+}
+
+TEST(TreeletOptimizerTest, testSmall)
+{
+    EXPECT_EQ(0, optimizeTree<TKDop16>(0));
+
+    TVertices vertex = {{1, 2, 3}};
+    auto root = buildTree<TKDop16>(vertex);
+    EXPECT_EQ(0, optimizeTree(root));
+    EXPECT_TRUE(root->isLeaf());
+    delete root;
+
+    // Two vertices have only one topology.
+    TVertices line = {{1, 2, 3}, {4, 5, 6}};
+    root = buildTree<TKDop16>(line);
+    EXPECT_EQ(0, optimizeTree(root));
+    validate(root);
+    delete root;
+}
+
+TEST(TreeletOptimizerTest, testOptimize)
+{
+    TVertices vertices = getClusters(5000, 1);
+    auto root = buildTree<TKDop16, SplitterByMedian<TKDop16> >(vertices);
+    TVertices queryVertices = getClusters(5000, 2);
+    for (unsigned i = 0; i < vertices.size(); i += 10)
+    {
+        queryVertices.push_back(vertices[i]);
+    }
+
+    auto query = buildTree<TKDop16>(queryVertices);
+    float cost = getSurfaceAreaCost(root);
+    EXPECT_EQ(500, getVisited(root, query));
+
+    EXPECT_LT(0, optimizeTree(root));
+    EXPECT_GT(cost * 0.95f, getSurfaceAreaCost(root));
+    // Balanced tree could become deeper but not deeper than built by other splitters.
+    EXPECT_GE(getDepthLimit(5000) + 1, getDepth(root));
+    validate(root);
+
+    // Reordered vertices are the same.
+    TVertices sorted(vertices);
+    TVertices optimized(root->getVertices().begin(), root->getVertices().end());
+    auto less = [](const SVertex& a, const SVertex& b) {
+        return std::make_tuple(a.x, a.y, a.z) < std::make_tuple(b.x, b.y, b.z);
+    };
+    std::sort(sorted.begin(), sorted.end(), less);
+    std::sort(optimized.begin(), optimized.end(), less);
+    EXPECT_EQ(sorted, optimized);
+
+    // Submitted indices follow reordered vertices.
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        EXPECT_EQ(vertices[root->getIndex(i)], root->getVertices()[i]);
+    }
+
+    EXPECT_EQ(500, getVisited(root, query));
+
+    delete root;
+    delete query;
+}
+
+TEST(TreeletOptimizerTest, testDepthBudget)
+{
+    // Distances grow twice, the cheapest tree is a chain deeper than the budget.
+    // Treelets are restructured by cheapest topologies that still fit it.
+    TVertices vertices;
+    for (unsigned i = 0; i < 24; ++i)
+    {
+        vertices.push_back(SVertex(std::ldexp(1.0f, i), i * 7 % 5, i * 3 % 4));
+    }
+
+    auto root = buildTree<TKDop16, SplitterByMedian<TKDop16> >(vertices);
+    float cost = getSurfaceAreaCost(root);
+
+    EXPECT_LT(0, optimizeTree(root));
+    EXPECT_GT(cost * 0.5f, getSurfaceAreaCost(root));
+    EXPECT_GE(getDepthLimit(24) + 1, getDepth(root));
+    validate(root);
+
+    delete root;
+}
+
+TEST(TreeletOptimizerTest, testSharedVertices)
+{
+    // Two trees on ranges of one array, only the first one is optimized.
+    TVertices clusters = getClusters(2000, 4);
+    auto vertices = std::make_shared<TVertices>(clusters);
+    auto first = buildTree<TKDop16, SplitterByMedian<TKDop16> >(vertices, 0, 1000);
+    auto second = buildTree<TKDop16>(vertices, 1000, 2000);
+    TVertices secondVertices(vertices->begin() + 1000, vertices->end());
+
+    auto query = buildTree<TKDop16>(TVertices(clusters.begin() + 500, clusters.begin() + 1500));
+    unsigned firstVisited = getVisited(first, query);
+    unsigned secondVisited = getVisited(second, query);
+    EXPECT_EQ(1000, firstVisited + secondVisited);
+
+    EXPECT_LT(0, optimizeTree(first));
+    ASSERT_EQ(2000, vertices->size());
+    EXPECT_EQ(0, first->getBegin());
+    EXPECT_EQ(1000, first->getEnd());
+    validate(first);
+    validate(second);
+
+    // The second tree and its vertices are not changed.
+    EXPECT_TRUE(std::equal(secondVertices.begin(), secondVertices.end(), vertices->begin() + 1000));
+    for (unsigned i = 0; i < vertices->size(); ++i)
+    {
+        const TNodeKDop16* root = i < 1000 ? first : second;
+        EXPECT_EQ(clusters[root->getIndex(i)], (*vertices)[i]);
+    }
+
+    EXPECT_EQ(firstVisited, getVisited(first, query));
+    EXPECT_EQ(secondVisited, getVisited(second, query));
+
+    delete first;
+    delete second;
+    delete query;
+}
+
+TEST(TreeletOptimizerTest, testParallelSameAsSerial)
+{
+    TVertices vertices = getClusters(20000, 3);
+    auto expected = buildTree<TKDop16, SplitterByMedian<TKDop16> >(vertices);
+    auto root = buildTree<TKDop16, SplitterByMedian<TKDop16> >(vertices);
+
+    TaskPool pool(4);
+    unsigned restructured = optimizeTree(expected);
+    EXPECT_EQ(restructured, TreeletOptimizer<TKDop16>(7, 3).optimize(root, pool, 64));
+    validate(root);
+
+    std::vector<std::pair<const TNodeKDop16*, const TNodeKDop16*> > stack(1, std::make_pair(expected, root));
+    while (!stack.empty())
+    {
+        const TNodeKDop16* a = stack.back().first;
+        const TNodeKDop16* b = stack.back().second;
+        stack.pop_back();
+        ASSERT_EQ(a->isLeaf(), b->isLeaf());
+        EXPECT_EQ(a->getBegin(), b->getBegin());
+        EXPECT_EQ(a->getEnd(), b->getEnd());
+        if (!a->isLeaf())
+        {
+            stack.push_back(std::make_pair(a->getLeft(), b->getLeft()));
+            stack.push_back(std::make_pair(a->getRight(), b->getRight()));
+        }
+    }
+
+    EXPECT_TRUE(
+        std::equal(expected->getVertices().begin(), expected->getVertices().end(), root->getVertices().begin())
+        );
+
+    delete expected;
+    delete root;
+}
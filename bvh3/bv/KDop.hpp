@@ -11,6 +11,15 @@
 
 #include <bvh3/types/SVertex.hpp>
 
+// Definitions are visible to let the compiler inline them.
+// Define BVH3_KDOP_OUT_OF_LINE in the whole program to use only instantiations from KDop library,
+// then kernels are declared and defined without inline in every translation unit.
+#ifdef BVH3_KDOP_OUT_OF_LINE
+#define BVH3_KDOP_INLINE
+#else
+#define BVH3_KDOP_INLINE inline
+#endif
+
 namespace NBvh3
 {
 
@@ -45,6 +54,25 @@ class KDop
 {
 public:
 
+    /**
+     * Number of directions.
+     */
+    static const unsigned DIRECTIONS = K / 2;
+
+    /**
+     * Returns direction vector by index of axis, not normalized.
+     */
+    static SVertex getDirection(unsigned axisIndex);
+
+    /**
+     * Returns distance of the vertex along the axis, not normalized.
+     * Rounded the same way as distances of vertices merged into KDop, so could be compared with getMin() and getMax().
+     *
+     * @param Vertex.
+     * @param Index of axis.
+     */
+    BVH3_KDOP_INLINE static float getDistance(const SVertex& vertex, unsigned axisIndex);
+
     /**
      * Default constructor to create empty object.
      */
@@ -58,7 +86,26 @@ public:
     /**
      * Checks if current KDop object overlabs other.
      */
-    bool overlapped(const KDop<K>& other) const;
+    BVH3_KDOP_INLINE bool overlapped(const KDop<K>& other) const;
+
+    /**
+     * Checks if the vertex is inside current KDop.
+     */
+    BVH3_KDOP_INLINE bool contains(const SVertex& vertex) const;
+
+    /**
+     * Checks if any of vertices is inside current KDop.
+     * Tests several vertices at once.
+     *
+     * @param Pointer to the first vertex.
+     * @param Number of vertices.
+     */
+    BVH3_KDOP_INLINE bool contains(const SVertex* vertices, unsigned count) const;
+
+    /**
+     * Checks if other KDop is inside current one.
+     */
+    BVH3_KDOP_INLINE bool contains(const KDop<K>& other) const;
 
     /**
      * Returns AABB width.
@@ -80,19 +127,54 @@ public:
      */
     SVertex getCenter() const;
 
+    /**
+     * Returns surface area of AABB of the KDop, not of the KDop itself.
+     * Used as cost of nodes by builders and statistics. Area of KDop itself needs to clip the box
+     * by every diagonal plane, it is hundreds times slower and cut edges could not be subtracted independently.
+     */
+    float getBoxSurfaceArea() const;
+
     /**
      * Marges by a vertex.
      *
      * @param Vertex to append to current KDop.
      */
-    KDop<K>& operator += (const SVertex& vertex);
+    BVH3_KDOP_INLINE KDop<K>& operator += (const SVertex& vertex);
+
+    /**
+     * Marges by array of vertices.
+     * Computes distances for several vertices at once.
+     *
+     * @param Pointer to the first vertex.
+     * @param Number of vertices.
+     */
+    BVH3_KDOP_INLINE KDop<K>& merge(const SVertex* vertices, unsigned count);
+
+    /**
+     * Marges by vertices referred by indices.
+     *
+     * @param All vertices.
+     * @param Indices of vertices to append.
+     * @param Number of indices.
+     */
+    BVH3_KDOP_INLINE KDop<K>& merge(const SVertex* vertices, const unsigned* indices, unsigned count);
+
+    /**
+     * Marges by vertices stored as separate arrays of coordinates.
+     *
+     * @param Axis x of vertices.
+     * @param Axis y of vertices.
+     * @param Axis z of vertices.
+     * @param Number of vertices.
+     */
+    BVH3_KDOP_INLINE KDop<K>& merge(const float* x, const float* y, const float* z, unsigned count);
 
     /**
      * Marges by another KDop.
      *
      * @param KDop to append to current.
      */
-    KDop<K>& operator += (const KDop<K>& other);
+    BVH3_KDOP_INLINE KDop<K>& operator += (const KDop<K>& other);
 
     /**
      * Creates new KDop, merged copy of current and other.
@@ -101,6 +183,13 @@ public:
      */
     KDop<K> operator + (const KDop<K>& other) const;
 
+    /**
+     * Moves all planes outwards, so the result contains current KDop moved by up to margin along each axis.
+     *
+     * @param Margin along x, y and z.
+     */
+    KDop<K>& inflate(float margin);
+
     /**
      * Returns min distance by index of axis.
      */
@@ -113,6 +202,15 @@ public:
 
 private:
 
+    /**
+     * Marges by vertices provided by the loader, SIMD_WIDTH vertices per step.
+     *
+     * @param Number of vertices.
+     * @param Loads packed coordinates and single vertices by index.
+     */
+    template<class TLoader>
+    BVH3_KDOP_INLINE KDop<K>& mergeBatch(unsigned count, const TLoader& loader);
+
     /**
      * Stores minimum distances for axes [0, K/2).
      */
@@ -126,4 +224,8 @@ private:
 
 } // namespace NBvh3
 
+#ifndef BVH3_KDOP_OUT_OF_LINE
+#include "KDop.inl"
+#endif
+
 #endif // BVH3_KDOP
\ No newline at end of file
@@ -0,0 +1,546 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_KDOP_INL
+#define BVH3_KDOP_INL
+
+#include "KDop.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace NBvh3
+{
+
+namespace detail
+{
+
+/**
+ * Computes the distances to planes with normals from KDop vectors.
+ * Works with single and packed coordinates.
+ *
+ * @tparam N Number of directions.
+ */
+template<unsigned N>
+struct SDistances;
+
+template<>
+struct SDistances<8>
+{
+    template<class T>
+    static inline void get(T x, T y, T z, T dists[])
+    {
+        dists[0] = x;
+        dists[1] = y;
+        dists[2] = z;
+        dists[3] = simdAdd(x, y);
+        dists[4] = simdAdd(x, z);
+        dists[5] = simdAdd(y, z);
+        dists[6] = simdSub(x, y);
+        dists[7] = simdSub(x, z);
+    }
+};
+
+template<>
+struct SDistances<9>
+{
+    template<class T>
+    static inline void get(T x, T y, T z, T dists[])
+    {
+        SDistances<8>::get(x, y, z, dists);
+
+        dists[8] = simdSub(y, z);
+    }
+};
+
+template<>
+struct SDistances<12>
+{
+    template<class T>
+    static inline void get(T x, T y, T z, T dists[])
+    {
+        SDistances<9>::get(x, y, z, dists);
+
+        dists[9] = simdSub(simdAdd(x, y), z);
+        dists[10] = simdSub(simdAdd(x, z), y);
+        dists[11] = simdSub(simdAdd(y, z), x);
+    }
+};
+
+/// Returns the distances to planes with normals from KDop vectors.
+///
+/// @params Vertex with coordinates.
+/// @param[out] Result distances.
+template<unsigned K>
+inline void getDistances(const SVertex& vertex, float dists[])
+{
+    SDistances<K>::get(vertex.x, vertex.y, vertex.z, dists);
+}
+
+/**
+ * Loads packed coordinates from array of vertices.
+ */
+struct SVertexLoader
+{
+    inline void load(unsigned i, TSimdFloats& x, TSimdFloats& y, TSimdFloats& z) const
+    {
+        float xs[SIMD_WIDTH];
+        float ys[SIMD_WIDTH];
+        float zs[SIMD_WIDTH];
+        for (unsigned j = 0; j < SIMD_WIDTH; ++j)
+        {
+            const SVertex& vertex = vertices[i + j];
+            xs[j] = vertex.x;
+            ys[j] = vertex.y;
+            zs[j] = vertex.z;
+        }
+
+        x = simdLoad(xs);
+        y = simdLoad(ys);
+        z = simdLoad(zs);
+    }
+
+    inline const SVertex& get(unsigned i) const
+    {
+        return vertices[i];
+    }
+
+    const SVertex* vertices;
+};
+
+/**
+ * Loads packed coordinates of vertices referred by indices.
+ */
+struct SIndexedVertexLoader
+{
+    inline void load(unsigned i, TSimdFloats& x, TSimdFloats& y, TSimdFloats& z) const
+    {
+        float xs[SIMD_WIDTH];
+        float ys[SIMD_WIDTH];
+        float zs[SIMD_WIDTH];
+        for (unsigned j = 0; j < SIMD_WIDTH; ++j)
+        {
+            const SVertex& vertex = vertices[indices[i + j]];
+            xs[j] = vertex.x;
+            ys[j] = vertex.y;
+            zs[j] = vertex.z;
+        }
+
+        x = simdLoad(xs);
+        y = simdLoad(ys);
+        z = simdLoad(zs);
+    }
+
+    inline const SVertex& get(unsigned i) const
+    {
+        return vertices[indices[i]];
+    }
+
+    const SVertex* vertices;
+    const unsigned* indices;
+};
+
+/**
+ * Loads packed coordinates from separate arrays of coordinates.
+ */
+struct SCoordinatesLoader
+{
+    inline void load(unsigned i, TSimdFloats& x, TSimdFloats& y, TSimdFloats& z) const
+    {
+        x = simdLoad(xs + i);
+        y = simdLoad(ys + i);
+        z = simdLoad(zs + i);
+    }
+
+    inline SVertex get(unsigned i) const
+    {
+        return SVertex(xs[i], ys[i], zs[i]);
+    }
+
+    const float* xs;
+    const float* ys;
+    const float* zs;
+};
+
+/**
+ * Widens the range by the value.
+ */
+inline void setMinMax(float value, float& minValue, float& maxValue)
+{
+    maxValue = simdMax(maxValue, value);
+    minValue = simdMin(minValue, value);
+}
+
+} // namespace detail
+
+template<unsigned K>
+const unsigned KDop<K>::DIRECTIONS;
+
+template<unsigned K>
+SVertex KDop<K>::getDirection(unsigned axisIndex)
+{
+    static const SVertex directions[12] =
+    {
+        {1, 0, 0},
+        {0, 1, 0},
+        {0, 0, 1},
+        {1, 1, 0},
+        {1, 0, 1},
+        {0, 1, 1},
+        {1, -1, 0},
+        {1, 0, -1},
+        {0, 1, -1},
+        {1, 1, -1},
+        {1, -1, 1},
+        {-1, 1, 1}
+    };
+
+    return directions[axisIndex];
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE float KDop<K>::getDistance(const SVertex& vertex, unsigned axisIndex)
+{
+    // The same operations as detail::SDistances.
+    float x = vertex.x;
+    float y = vertex.y;
+    float z = vertex.z;
+    switch (axisIndex)
+    {
+        case 0: return x;
+        case 1: return y;
+        case 2: return z;
+        case 3: return x + y;
+        case 4: return x + z;
+        case 5: return y + z;
+        case 6: return x - y;
+        case 7: return x - z;
+        case 8: return y - z;
+        case 9: return (x + y) - z;
+        case 10: return (x + z) - y;
+        case 11: return (y + z) - x;
+    }
+
+    return 0;
+}
+
+template<unsigned K>
+KDop<K>::KDop() throw()
+{
+    float max = std::numeric_limits<float>::max();
+    for(unsigned i = 0; i < K / 2; ++i)
+    {
+        mMin[i] = max;
+        mMax[i] = -max;
+    }
+}
+
+template<unsigned K>
+KDop<K>::KDop(const SVertex& vertex) throw()
+{
+    float dists[K / 2];
+    detail::getDistances<K / 2>(vertex, dists);
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        mMin[i] = mMax[i] = dists[i];
+    }
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE KDop<K>& KDop<K>::operator += (const SVertex& vertex)
+{
+    float dists[K / 2];
+    detail::getDistances<K / 2>(vertex, dists);
+    for(unsigned i = 0; i < K / 2; ++i)
+    {
+        detail::setMinMax(dists[i], mMin[i], mMax[i]);
+    }
+
+    return *this;
+}
+
+template<unsigned K>
+template<class TLoader>
+BVH3_KDOP_INLINE KDop<K>& KDop<K>::mergeBatch(unsigned count, const TLoader& loader)
+{
+    // Leaves are mostly shorter than one packed load.
+    if (count < SIMD_WIDTH)
+    {
+        for (unsigned v = 0; v < count; ++v)
+        {
+            *this += loader.get(v);
+        }
+
+        return *this;
+    }
+
+    TSimdFloats mins[K / 2];
+    TSimdFloats maxs[K / 2];
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        mins[i] = simdSet(mMin[i]);
+        maxs[i] = simdSet(mMax[i]);
+    }
+
+    unsigned v = 0;
+    for (; v + SIMD_WIDTH <= count; v += SIMD_WIDTH)
+    {
+        TSimdFloats x, y, z;
+        loader.load(v, x, y, z);
+
+        TSimdFloats dists[K / 2];
+        detail::SDistances<K / 2>::get(x, y, z, dists);
+        for (unsigned i = 0; i < K / 2; ++i)
+        {
+            mins[i] = simdMin(mins[i], dists[i]);
+            maxs[i] = simdMax(maxs[i], dists[i]);
+        }
+    }
+
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        mMin[i] = simdReduceMin(mins[i]);
+        mMax[i] = simdReduceMax(maxs[i]);
+    }
+
+    for (; v < count; ++v)
+    {
+        *this += loader.get(v);
+    }
+
+    return *this;
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE KDop<K>& KDop<K>::merge(const SVertex* vertices, unsigned count)
+{
+    detail::SVertexLoader loader = {vertices};
+    return mergeBatch(count, loader);
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE KDop<K>& KDop<K>::merge(const SVertex* vertices, const unsigned* indices, unsigned count)
+{
+    detail::SIndexedVertexLoader loader = {vertices, indices};
+    return mergeBatch(count, loader);
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE KDop<K>& KDop<K>::merge(const float* x, const float* y, const float* z, unsigned count)
+{
+    detail::SCoordinatesLoader loader = {x, y, z};
+    return mergeBatch(count, loader);
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE KDop<K>& KDop<K>::operator += (const KDop<K>& other)
+{
+    // Branchless to be vectorized.
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        mMin[i] = simdMin(mMin[i], other.mMin[i]);
+        mMax[i] = simdMax(mMax[i], other.mMax[i]);
+    }
+
+    return *this;
+}
+
+template<unsigned K>
+KDop<K> KDop<K>::operator + (const KDop<K>& other) const
+{
+    return KDop<K>(*this) += other;
+}
+
+template<unsigned K>
+KDop<K>& KDop<K>::inflate(float margin)
+{
+    // Planes are moved by the biggest distance of corners of the cube with the margin.
+    float shifts[K / 2] = {};
+    for (unsigned c = 0; c < 8; ++c)
+    {
+        float dists[K / 2];
+        SVertex corner(c & 1 ? margin : -margin, c & 2 ? margin : -margin, c & 4 ? margin : -margin);
+        detail::getDistances<K / 2>(corner, dists);
+        for (unsigned i = 0; i < K / 2; ++i)
+        {
+            shifts[i] = std::max(shifts[i], dists[i]);
+        }
+    }
+
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        mMin[i] -= shifts[i];
+        mMax[i] += shifts[i];
+    }
+
+    return *this;
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE bool KDop<K>::overlapped(const KDop<K>& other) const
+{
+#ifdef BVH3_SSE
+    // Compares all axes without branches and collects separated ones into one mask.
+    unsigned i = 0;
+    __m128 separated = _mm_setzero_ps();
+#ifdef BVH3_AVX
+    for (; i + 8 <= K / 2; i += 8)
+    {
+        __m256 axes = _mm256_or_ps(
+            _mm256_cmp_ps(_mm256_loadu_ps(mMin + i), _mm256_loadu_ps(other.mMax + i), _CMP_GT_OQ),
+            _mm256_cmp_ps(_mm256_loadu_ps(mMax + i), _mm256_loadu_ps(other.mMin + i), _CMP_LT_OQ)
+            );
+
+        separated = _mm_or_ps(separated, _mm256_castps256_ps128(axes));
+        separated = _mm_or_ps(separated, _mm256_extractf128_ps(axes, 1));
+    }
+#endif
+    for (; i + 4 <= K / 2; i += 4)
+    {
+        separated = _mm_or_ps(separated, _mm_cmpgt_ps(_mm_loadu_ps(mMin + i), _mm_loadu_ps(other.mMax + i)));
+        separated = _mm_or_ps(separated, _mm_cmplt_ps(_mm_loadu_ps(mMax + i), _mm_loadu_ps(other.mMin + i)));
+    }
+
+    for (; i < K / 2; ++i)
+    {
+        separated = _mm_or_ps(separated, _mm_cmpgt_ss(_mm_load_ss(mMin + i), _mm_load_ss(other.mMax + i)));
+        separated = _mm_or_ps(separated, _mm_cmplt_ss(_mm_load_ss(mMax + i), _mm_load_ss(other.mMin + i)));
+    }
+
+    return _mm_movemask_ps(separated) == 0;
+#else
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        if (mMin[i] > other.mMax[i] || mMax[i] < other.mMin[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+#endif
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE bool KDop<K>::contains(const SVertex& vertex) const
+{
+    float dists[K / 2];
+    detail::getDistances<K / 2>(vertex, dists);
+    bool result = true;
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        result &= dists[i] >= mMin[i] && dists[i] <= mMax[i];
+    }
+
+    return result;
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE bool KDop<K>::contains(const KDop<K>& other) const
+{
+    bool result = true;
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        result &= other.mMin[i] >= mMin[i] && other.mMax[i] <= mMax[i];
+    }
+
+    return result;
+}
+
+template<unsigned K>
+BVH3_KDOP_INLINE bool KDop<K>::contains(const SVertex* vertices, unsigned count) const
+{
+    detail::SVertexLoader loader = {vertices};
+    unsigned v = 0;
+    for (; v + SIMD_WIDTH <= count; v += SIMD_WIDTH)
+    {
+        TSimdFloats x, y, z;
+        loader.load(v, x, y, z);
+
+        TSimdFloats dists[K / 2];
+        detail::SDistances<K / 2>::get(x, y, z, dists);
+        TSimdFloats inside = simdInRange(dists[0], simdSet(mMin[0]), simdSet(mMax[0]));
+        for (unsigned i = 1; i < K / 2; ++i)
+        {
+            inside = simdAnd(inside, simdInRange(dists[i], simdSet(mMin[i]), simdSet(mMax[i])));
+        }
+
+        if (simdMask(inside) != 0)
+        {
+            return true;
+        }
+    }
+
+    for (; v < count; ++v)
+    {
+        if (contains(vertices[v]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<unsigned K>
+float KDop<K>::getWidth() const
+{
+    return mMax[0] - mMin[0];
+}
+
+template<unsigned K>
+float KDop<K>::getHeight() const
+{
+    return mMax[1] - mMin[1];
+}
+
+template<unsigned K>
+float KDop<K>::getDepth() const
+{
+    return mMax[2] - mMin[2];
+}
+
+template<unsigned K>
+SVertex KDop<K>::getCenter() const
+{
+    return SVertex(
+        mMin[0] + mMax[0], 
+        mMin[1] + mMax[1],
+        mMin[2] + mMax[2]
+        ) * 0.5;
+}
+
+template<unsigned K>
+float KDop<K>::getBoxSurfaceArea() const
+{
+    if (mMin[0] > mMax[0])
+    {
+        return 0;
+    }
+
+    float width = getWidth();
+    float height = getHeight();
+    float depth = getDepth();
+    return 2 * (width * height + width * depth + height * depth);
+}
+
+template<unsigned K>
+float KDop<K>::getMin(unsigned i) const
+{
+    return i < K / 2 ? mMin[i] : 0;
+}
+
+template<unsigned K>
+float KDop<K>::getMax(unsigned i) const
+{
+    return i < K / 2 ? mMax[i] : 0;
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_KDOP_INL
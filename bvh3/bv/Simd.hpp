@@ -0,0 +1,273 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_SIMD
+#define BVH3_SIMD
+
+// Selects SIMD instruction sets available for the target.
+// BVH3_SSE is defined if SSE is available, BVH3_AVX if AVX is also available.
+// Define BVH3_NO_SIMD to use scalar code only.
+
+#if !defined(BVH3_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define BVH3_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(BVH3_SSE) && defined(__AVX__)
+#define BVH3_AVX
+#include <immintrin.h>
+#endif
+
+namespace NBvh3
+{
+
+#if defined(BVH3_AVX)
+
+/**
+ * Packed floats of the widest available register.
+ */
+typedef __m256 TSimdFloats;
+
+/**
+ * Number of floats in TSimdFloats.
+ */
+const unsigned SIMD_WIDTH = 8;
+
+/**
+ * Loads packed floats from unaligned memory.
+ */
+inline TSimdFloats simdLoad(const float* values)
+{
+    return _mm256_loadu_ps(values);
+}
+
+/**
+ * Sets all packed floats to the value.
+ */
+inline TSimdFloats simdSet(float value)
+{
+    return _mm256_set1_ps(value);
+}
+
+/**
+ * Adds packed floats.
+ */
+inline TSimdFloats simdAdd(TSimdFloats a, TSimdFloats b)
+{
+    return _mm256_add_ps(a, b);
+}
+
+/**
+ * Subtracts packed floats.
+ */
+inline TSimdFloats simdSub(TSimdFloats a, TSimdFloats b)
+{
+    return _mm256_sub_ps(a, b);
+}
+
+/**
+ * Returns packed minimums.
+ */
+inline TSimdFloats simdMin(TSimdFloats a, TSimdFloats b)
+{
+    return _mm256_min_ps(a, b);
+}
+
+/**
+ * Returns packed maximums.
+ */
+inline TSimdFloats simdMax(TSimdFloats a, TSimdFloats b)
+{
+    return _mm256_max_ps(a, b);
+}
+
+/**
+ * Stores packed floats to unaligned memory.
+ */
+inline void simdStore(float* values, TSimdFloats a)
+{
+    _mm256_storeu_ps(values, a);
+}
+
+/**
+ * Returns packed masks with all bits set where min <= value <= max.
+ */
+inline TSimdFloats simdInRange(TSimdFloats value, TSimdFloats min, TSimdFloats max)
+{
+    return _mm256_and_ps(_mm256_cmp_ps(value, min, _CMP_GE_OQ), _mm256_cmp_ps(value, max, _CMP_LE_OQ));
+}
+
+/**
+ * Returns bitwise and of packed masks.
+ */
+inline TSimdFloats simdAnd(TSimdFloats a, TSimdFloats b)
+{
+    return _mm256_and_ps(a, b);
+}
+
+/**
+ * Returns one bit per packed mask.
+ */
+inline unsigned simdMask(TSimdFloats a)
+{
+    return _mm256_movemask_ps(a);
+}
+
+#elif defined(BVH3_SSE)
+
+typedef __m128 TSimdFloats;
+
+const unsigned SIMD_WIDTH = 4;
+
+inline TSimdFloats simdLoad(const float* values)
+{
+    return _mm_loadu_ps(values);
+}
+
+inline TSimdFloats simdSet(float value)
+{
+    return _mm_set1_ps(value);
+}
+
+inline TSimdFloats simdAdd(TSimdFloats a, TSimdFloats b)
+{
+    return _mm_add_ps(a, b);
+}
+
+inline TSimdFloats simdSub(TSimdFloats a, TSimdFloats b)
+{
+    return _mm_sub_ps(a, b);
+}
+
+inline TSimdFloats simdMin(TSimdFloats a, TSimdFloats b)
+{
+    return _mm_min_ps(a, b);
+}
+
+inline TSimdFloats simdMax(TSimdFloats a, TSimdFloats b)
+{
+    return _mm_max_ps(a, b);
+}
+
+inline void simdStore(float* values, TSimdFloats a)
+{
+    _mm_storeu_ps(values, a);
+}
+
+inline TSimdFloats simdInRange(TSimdFloats value, TSimdFloats min, TSimdFloats max)
+{
+    return _mm_and_ps(_mm_cmpge_ps(value, min), _mm_cmple_ps(value, max));
+}
+
+inline TSimdFloats simdAnd(TSimdFloats a, TSimdFloats b)
+{
+    return _mm_and_ps(a, b);
+}
+
+inline unsigned simdMask(TSimdFloats a)
+{
+    return _mm_movemask_ps(a);
+}
+
+#else
+
+typedef float TSimdFloats;
+
+const unsigned SIMD_WIDTH = 1;
+
+inline TSimdFloats simdLoad(const float* values)
+{
+    return *values;
+}
+
+inline TSimdFloats simdSet(float value)
+{
+    return value;
+}
+
+inline void simdStore(float* values, TSimdFloats a)
+{
+    *values = a;
+}
+
+// Masks are 1 or 0.
+
+inline TSimdFloats simdInRange(TSimdFloats value, TSimdFloats min, TSimdFloats max)
+{
+    return value >= min && value <= max ? 1 : 0;
+}
+
+inline TSimdFloats simdAnd(TSimdFloats a, TSimdFloats b)
+{
+    return a != 0 && b != 0 ? 1 : 0;
+}
+
+inline unsigned simdMask(TSimdFloats a)
+{
+    return a != 0;
+}
+
+#endif
+
+// Scalar versions to share code between packed and single values.
+
+inline float simdAdd(float a, float b)
+{
+    return a + b;
+}
+
+inline float simdSub(float a, float b)
+{
+    return a - b;
+}
+
+inline float simdMin(float a, float b)
+{
+    return b < a ? b : a;
+}
+
+inline float simdMax(float a, float b)
+{
+    return b > a ? b : a;
+}
+
+/**
+ * Returns minimum of all packed floats.
+ */
+inline float simdReduceMin(TSimdFloats a)
+{
+    float values[SIMD_WIDTH];
+    simdStore(values, a);
+    float result = values[0];
+    for (unsigned i = 1; i < SIMD_WIDTH; ++i)
+    {
+        result = simdMin(result, values[i]);
+    }
+
+    return result;
+}
+
+/**
+ * Returns maximum of all packed floats.
+ */
+inline float simdReduceMax(TSimdFloats a)
+{
+    float values[SIMD_WIDTH];
+    simdStore(values, a);
+    float result = values[0];
+    for (unsigned i = 1; i < SIMD_WIDTH; ++i)
+    {
+        result = simdMax(result, values[i]);
+    }
+
+    return result;
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_SIMD
@@ -11,10 +11,40 @@
 
 #include "KDop.hpp"
 #include <bvh3/types/SVertex.hpp>
+#include <bvh3/types/STransform.hpp>
  
 namespace NBvh3
 {
 
+/**
+ * Creates bounding volume based on continuous vertices.
+ *
+ * @param Pointer to the first vertex.
+ * @param Number of vertices.
+ */
+template<class TBv>
+TBv createBoundingVolume(const SVertex* vertices, unsigned size)
+{
+    TBv bv;
+    bv.merge(vertices, size);
+    return bv;
+}
+
+/**
+ * Creates bounding volume based on vertices referred by indices.
+ *
+ * @param All vertices.
+ * @param Indices of applied vertices.
+ * @param Number of indices.
+ */
+template<class TBv>
+TBv createBoundingVolume(const SVertex* vertices, const unsigned* indices, unsigned size)
+{
+    TBv bv;
+    bv.merge(vertices, indices, size);
+    return bv;
+}
+
 /**
  * Creates bounding volume based on vertices.
  *
@@ -23,13 +53,33 @@ namespace NBvh3
 template<class TBv>
 TBv createBoundingVolume(const TVertices& vertices)
 {
-    TBv bv;
-    for (unsigned i = 0; i < vertices.size(); ++i)
+    return createBoundingVolume<TBv>(vertices.data(), vertices.size());
+}
+
+/**
+ * Creates bounding volume containing the transformed one.
+ * Corners of the box of the first three axes are transformed,
+ * so the result is conservative but could be bigger than the exact one.
+ *
+ * @param Bounding volume.
+ * @param Transform to apply.
+ */
+template<class TBv>
+TBv transformBoundingVolume(const TBv& bv, const STransform& transform)
+{
+    TBv result;
+    for (unsigned i = 0; i < 8; ++i)
     {
-        bv += vertices[i];
+        SVertex corner(
+            i & 1 ? bv.getMax(0) : bv.getMin(0),
+            i & 2 ? bv.getMax(1) : bv.getMin(1),
+            i & 4 ? bv.getMax(2) : bv.getMin(2)
+            );
+
+        result += transform(corner);
     }
 
-    return bv;
+    return result;
 }
 
 } // namespace NBvh3
@@ -4,8 +4,11 @@
  */
 
 #include <bvh3/bv/KDop.hpp>
+#include <bvh3/bv/all.hpp>
 #include <gtest/gtest.h>
+#include <cmath>
 #include <vector>
+#include <random>
 
 using namespace NBvh3;
 using namespace std;
@@ -300,3 +303,333 @@ TEST(KDopTest, testoverlappedDotNeg2)
     EXPECT_FALSE(bv1.overlapped(bv2));
     EXPECT_FALSE(bv2.overlapped(bv1));
 }
+
+/**
+ * Checks overlapping axis by axis without shortcuts.
+ */
+template<unsigned K>
+bool isOverlapped(const KDop<K>& bv1, const KDop<K>& bv2)
+{
+    bool result = true;
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        result = result && bv1.getMin(i) <= bv2.getMax(i) && bv1.getMax(i) >= bv2.getMin(i);
+    }
+
+    return result;
+}
+
+template<unsigned K>
+void testOverlappedRandom()
+{
+    std::mt19937 generator(K);
+    std::uniform_int_distribution<int> distribution(0, 6);
+    unsigned overlapped = 0;
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        KDop<K> bv1;
+        KDop<K> bv2;
+        for (unsigned j = 0; j < 2; ++j)
+        {
+            bv1 += SVertex(distribution(generator), distribution(generator), distribution(generator));
+            bv2 += SVertex(distribution(generator), distribution(generator), distribution(generator));
+        }
+
+        bool expected = isOverlapped(bv1, bv2);
+        overlapped += expected;
+        EXPECT_EQ(expected, bv1.overlapped(bv2));
+        EXPECT_EQ(expected, bv2.overlapped(bv1));
+    }
+
+    // Both outcomes are tested.
+    EXPECT_LT(0, overlapped);
+    EXPECT_GT(10000, overlapped);
+}
+
+TEST(KDopTest, testOverlappedRandom16)
+{
+    testOverlappedRandom<16>();
+}
+
+TEST(KDopTest, testOverlappedRandom18)
+{
+    testOverlappedRandom<18>();
+}
+
+TEST(KDopTest, testOverlappedRandom24)
+{
+    testOverlappedRandom<24>();
+}
+
+TEST(KDopTest, testOverlappedLastAxis)
+{
+    // Separated only by (-1,1,1) direction.
+    KDop<24> bv1;
+    bv1 += SVertex(0, 0, 1);
+    bv1 += SVertex(2, 1, 2);
+    bv1 += SVertex(2, 1, 0);
+    KDop<24> bv2;
+    bv2 += SVertex(2, 3, 2);
+    bv2 += SVertex(0, 0, 3);
+    bv2 += SVertex(0, 2, 2);
+
+    for (unsigned i = 0; i < 11; ++i)
+    {
+        EXPECT_TRUE(bv1.getMin(i) <= bv2.getMax(i) && bv1.getMax(i) >= bv2.getMin(i));
+    }
+
+    EXPECT_TRUE(bv1.getMax(11) < bv2.getMin(11));
+    EXPECT_FALSE(bv1.overlapped(bv2));
+    EXPECT_FALSE(bv2.overlapped(bv1));
+    EXPECT_TRUE(bv1.overlapped(bv1));
+}
+
+template<unsigned K>
+void expectEqual(const KDop<K>& expected, const KDop<K>& bv)
+{
+    for (unsigned i = 0; i < K / 2; ++i)
+    {
+        EXPECT_EQ(expected.getMin(i), bv.getMin(i));
+        EXPECT_EQ(expected.getMax(i), bv.getMax(i));
+    }
+}
+
+template<unsigned K>
+void testMerge()
+{
+    std::mt19937 generator(K);
+    std::uniform_real_distribution<float> distribution(-100, 100);
+    unsigned counts[] = {0, 1, 3, 8, 16, 17, 100, 1001};
+    for (unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        unsigned count = counts[c];
+        TVertices vertices(count);
+        vector<float> x(count);
+        vector<float> y(count);
+        vector<float> z(count);
+        vector<unsigned> indices(count);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            vertices[i] = SVertex(distribution(generator), distribution(generator), distribution(generator));
+            x[i] = vertices[i].x;
+            y[i] = vertices[i].y;
+            z[i] = vertices[i].z;
+            indices[i] = count - i - 1;
+        }
+
+        KDop<K> expected({1, 2, 3});
+        for (unsigned i = 0; i < count; ++i)
+        {
+            expected += vertices[i];
+        }
+
+        KDop<K> bv1({1, 2, 3});
+        bv1.merge(vertices.data(), count);
+        expectEqual(expected, bv1);
+
+        KDop<K> bv2({1, 2, 3});
+        bv2.merge(vertices.data(), indices.data(), count);
+        expectEqual(expected, bv2);
+
+        KDop<K> bv3({1, 2, 3});
+        bv3.merge(x.data(), y.data(), z.data(), count);
+        expectEqual(expected, bv3);
+    }
+}
+
+TEST(KDopTest, testMerge16)
+{
+    testMerge<16>();
+}
+
+TEST(KDopTest, testMerge18)
+{
+    testMerge<18>();
+}
+
+TEST(KDopTest, testMerge24)
+{
+    testMerge<24>();
+}
+
+TEST(KDopTest, testMergeEmpty)
+{
+    KDop<16> bv;
+    bv.merge(0, 0u);
+    EXPECT_FALSE(bv.overlapped(bv));
+}
+
+template<unsigned K>
+void testContains()
+{
+    std::mt19937 generator(K);
+    std::uniform_real_distribution<float> distribution(-10, 10);
+    for (unsigned count = 0; count < 40; ++count)
+    {
+        KDop<K> bv;
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            bv += SVertex(distribution(generator), distribution(generator), distribution(generator));
+        }
+
+        TVertices vertices;
+        bool expected = false;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            SVertex vertex(distribution(generator), distribution(generator), distribution(generator));
+            vertices.push_back(vertex);
+            expected |= bv.overlapped(KDop<K>(vertex));
+            EXPECT_EQ(bv.overlapped(KDop<K>(vertex)), bv.contains(vertex));
+        }
+
+        EXPECT_EQ(expected, bv.contains(vertices.data(), count));
+    }
+}
+
+TEST(KDopTest, testContains16)
+{
+    testContains<16>();
+}
+
+TEST(KDopTest, testContains18)
+{
+    testContains<18>();
+}
+
+TEST(KDopTest, testContains24)
+{
+    testContains<24>();
+}
+
+TEST(KDopTest, testContainsLastVertex)
+{
+    KDop<16> bv({1, 2, 3});
+    bv += SVertex(2, 3, 4);
+    TVertices vertices(20, SVertex(10, 10, 10));
+    EXPECT_FALSE(bv.contains(vertices.data(), vertices.size()));
+
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        TVertices other(vertices);
+        other[i] = SVertex(1, 2, 3);
+        EXPECT_TRUE(bv.contains(other.data(), other.size()));
+    }
+}
+
+TEST(KDopTest, testTransformBoundingVolume)
+{
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> distribution(-10, 10);
+    for (unsigned i = 0; i < 20; ++i)
+    {
+        TVertices vertices;
+        for (unsigned j = 0; j < 10; ++j)
+        {
+            vertices.push_back(SVertex(distribution(generator), distribution(generator), distribution(generator)));
+        }
+
+        SVertex axis(distribution(generator), distribution(generator), distribution(generator));
+        float length = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+        STransform transform(axis * (1 / length), distribution(generator), SVertex(distribution(generator), 0, 1));
+        KDop<16> bv = transformBoundingVolume(createBoundingVolume<KDop<16> >(vertices), transform);
+        for (unsigned j = 0; j < vertices.size(); ++j)
+        {
+            // Allows rounding errors on the boundary.
+            KDop<16> vertex(transform(vertices[j]));
+            for (unsigned axis = 0; axis < 8; ++axis)
+            {
+                EXPECT_LE(bv.getMin(axis) - 0.001f, vertex.getMin(axis));
+                EXPECT_GE(bv.getMax(axis) + 0.001f, vertex.getMax(axis));
+            }
+        }
+    }
+
+    KDop<16> box({0, 0, 0});
+    box += SVertex(1, 2, 3);
+    KDop<16> moved = transformBoundingVolume(box, STransform(SVertex(1, 1, 1)));
+    EXPECT_EQ(1, moved.getMin(0));
+    EXPECT_EQ(2, moved.getMax(0));
+    EXPECT_EQ(4, moved.getMax(2));
+}
+
+TEST(KDopTest, testContainsKDop)
+{
+    KDop<16> box;
+    KDop<16> inner;
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        box += SVertex(i & 1 ? 4 : 0, i & 2 ? 4 : 0, i & 4 ? 4 : 0);
+        inner += SVertex(i & 1 ? 2 : 1, i & 2 ? 3 : 1, i & 4 ? 4 : 1);
+    }
+
+    EXPECT_TRUE(box.contains(box));
+    EXPECT_TRUE(box.contains(inner));
+    EXPECT_FALSE(inner.contains(box));
+
+    inner += SVertex(4, 4, 4.5f);
+    EXPECT_FALSE(box.contains(inner));
+
+    // The corner is inside the box but cut by diagonal planes of the other KDop.
+    KDop<16> triangle({0, 0, 0});
+    triangle += SVertex(4, 0, 0);
+    triangle += SVertex(0, 4, 0);
+    EXPECT_FALSE(triangle.contains(KDop<16>({3, 3, 0})));
+    EXPECT_TRUE(box.contains(KDop<16>({3, 3, 0})));
+}
+
+TEST(KDopTest, testInflate)
+{
+    KDop<18> box({0, 0, 0});
+    box += SVertex(1, 2, 3);
+    KDop<18> fat = KDop<18>(box).inflate(0.5f);
+
+    EXPECT_TRUE(fat.contains(box));
+    EXPECT_FLOAT_EQ(-0.5f, fat.getMin(0));
+    EXPECT_FLOAT_EQ(1.5f, fat.getMax(0));
+    EXPECT_FLOAT_EQ(3.5f, fat.getMax(2));
+
+    // Moved by up to the margin along every axis it is still inside.
+    for (unsigned c = 0; c < 8; ++c)
+    {
+        float x = c & 1 ? 0.5f : -0.5f;
+        float y = c & 2 ? 0.5f : -0.5f;
+        float z = c & 4 ? 0.5f : -0.5f;
+        KDop<18> moved({x, y, z});
+        moved += SVertex(1 + x, 2 + y, 3 + z);
+        EXPECT_TRUE(fat.contains(moved));
+    }
+
+    KDop<18> far({0.6f, 0, 0});
+    far += SVertex(1.6f, 2, 3);
+    EXPECT_FALSE(fat.contains(far));
+}
+
+TEST(KDopTest, testGetDirection)
+{
+    EXPECT_EQ(8, KDop<16>::DIRECTIONS);
+    EXPECT_EQ(12, KDop<24>::DIRECTIONS);
+
+    SVertex vertex(3, -2, 5);
+    KDop<24> bv(vertex);
+    for (unsigned i = 0; i < KDop<24>::DIRECTIONS; ++i)
+    {
+        SVertex d = KDop<24>::getDirection(i);
+        EXPECT_FLOAT_EQ(vertex.x * d.x + vertex.y * d.y + vertex.z * d.z, bv.getMin(i));
+    }
+}
+
+TEST(KDopTest, testGetDistance)
+{
+    // Distances are exactly the same as of merged vertices, including rounding of diagonal axes.
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> distribution(-100, 100);
+    for (unsigned v = 0; v < 1000; ++v)
+    {
+        SVertex vertex(distribution(generator), distribution(generator), distribution(generator));
+        KDop<24> bv(vertex);
+        for (unsigned i = 0; i < KDop<24>::DIRECTIONS; ++i)
+        {
+            EXPECT_EQ(bv.getMin(i), KDop<24>::getDistance(vertex, i));
+        }
+    }
+}
@@ -0,0 +1,414 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_TASKPOOL
+#define BVH3_TASKPOOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Pool of threads executing tasks with work stealing.
+ * Every worker has own queue: pushes and pops its tasks from the back
+ * and steals tasks of others from the front when own queue is empty.
+ * Threads that are not workers push to a shared queue.
+ */
+class TaskPool
+{
+public:
+
+    /**
+     * Task to execute.
+     */
+    typedef std::function<void()> TTask;
+
+    /**
+     * @param Number of worker threads, 0 to use number of hardware threads.
+     */
+    explicit TaskPool(unsigned threads = 0);
+
+    /**
+     * Stops workers. Pending tasks are not executed.
+     */
+    ~TaskPool();
+
+    /**
+     * Returns number of worker threads.
+     */
+    unsigned getSize() const;
+
+    /**
+     * Queues the task to be executed by any thread.
+     * The task should not throw, use TaskGroup to get exceptions of tasks.
+     */
+    void push(const TTask& task);
+
+    /**
+     * Executes one queued task in current thread.
+     *
+     * @return false If there is no queued tasks.
+     */
+    bool runOne();
+
+private:
+
+    TaskPool(const TaskPool&);
+    TaskPool& operator = (const TaskPool&);
+
+    /**
+     * Queue of tasks of one thread.
+     */
+    struct SQueue
+    {
+        std::mutex mutex;
+        std::deque<TTask> tasks;
+    };
+
+    /**
+     * Returns index of the queue of current thread.
+     */
+    unsigned getQueueIndex() const;
+
+    /**
+     * Takes a task from own queue or steals it from others.
+     *
+     * @param Index of own queue.
+     * @param[out] Found task.
+     * @return false If all queues are empty.
+     */
+    bool pop(unsigned index, TTask& task);
+
+    /**
+     * Executes tasks in a worker thread until the pool is stopped.
+     */
+    void work(unsigned index);
+
+    /**
+     * Queues of workers and one shared queue of other threads at the end.
+     */
+    std::vector<std::unique_ptr<SQueue> > mQueues;
+
+    /**
+     * Worker threads.
+     */
+    std::vector<std::thread> mThreads;
+
+    /**
+     * Number of queued tasks.
+     * Signed since a task could be popped before its push is counted.
+     */
+    std::atomic<int> mQueued;
+
+    /**
+     * Set when workers should exit.
+     */
+    bool mStopped;
+
+    /**
+     * Protects sleeping of workers.
+     */
+    std::mutex mMutex;
+
+    /**
+     * Wakes up workers when tasks are queued.
+     */
+    std::condition_variable mWakeUp;
+};
+
+/**
+ * Group of tasks to wait for.
+ * Waiting thread executes queued tasks, so groups could be nested inside tasks.
+ */
+class TaskGroup
+{
+public:
+
+    /**
+     * @param Pool to execute tasks.
+     */
+    explicit TaskGroup(TaskPool& pool);
+
+    /**
+     * Waits for all tasks, e.g. when the scope is left by an exception.
+     * Exceptions of tasks are not rethrown, so wait() should be called at the end of the scope.
+     */
+    ~TaskGroup();
+
+    /**
+     * Queues the task to the pool.
+     */
+    void run(const TaskPool::TTask& task);
+
+    /**
+     * Waits for all tasks of the group, executing queued tasks meanwhile.
+     * Rethrows the first exception thrown by tasks.
+     */
+    void wait();
+
+private:
+
+    TaskGroup(const TaskGroup&);
+    TaskGroup& operator = (const TaskGroup&);
+
+    /**
+     * Executes tasks.
+     */
+    TaskPool& mPool;
+
+    /**
+     * Waits for all tasks without rethrowing exceptions.
+     */
+    void join();
+
+    /**
+     * Number of not finished tasks.
+     */
+    std::atomic<unsigned> mPending;
+
+    /**
+     * Protects the exception.
+     */
+    std::mutex mMutex;
+
+    /**
+     * First exception thrown by tasks.
+     */
+    std::exception_ptr mException;
+};
+
+/**
+ * Identifies worker of a pool running in current thread.
+ */
+struct SWorker
+{
+    /**
+     * Pool of the worker, 0 if current thread is not a worker.
+     */
+    const TaskPool* pool;
+
+    /**
+     * Index of the worker in the pool.
+     */
+    unsigned index;
+};
+
+/**
+ * Returns worker of current thread.
+ */
+inline SWorker& getCurrentWorker()
+{
+    static thread_local SWorker worker = {0, 0};
+    return worker;
+}
+
+inline TaskPool::TaskPool(unsigned threads)
+    : mQueued(0)
+    , mStopped(false)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i <= threads; ++i)
+    {
+        mQueues.push_back(std::unique_ptr<SQueue>(new SQueue()));
+    }
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        mThreads.push_back(std::thread(&TaskPool::work, this, i));
+    }
+}
+
+inline TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+
+    mWakeUp.notify_all();
+    for (unsigned i = 0; i < mThreads.size(); ++i)
+    {
+        mThreads[i].join();
+    }
+}
+
+inline unsigned TaskPool::getSize() const
+{
+    return mThreads.size();
+}
+
+inline unsigned TaskPool::getQueueIndex() const
+{
+    const SWorker& worker = getCurrentWorker();
+    return worker.pool == this ? worker.index : mThreads.size();
+}
+
+inline void TaskPool::push(const TTask& task)
+{
+    SQueue& queue = *mQueues[getQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mQueued;
+    }
+
+    mWakeUp.notify_one();
+}
+
+inline bool TaskPool::pop(unsigned index, TTask& task)
+{
+    if (mQueued <= 0)
+    {
+        return false;
+    }
+
+    {
+        SQueue& own = *mQueues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --mQueued;
+            return true;
+        }
+    }
+
+    for (unsigned i = 1; i < mQueues.size(); ++i)
+    {
+        SQueue& other = *mQueues[(index + i) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty())
+        {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            --mQueued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+inline bool TaskPool::runOne()
+{
+    TTask task;
+    if (!pop(getQueueIndex(), task))
+    {
+        return false;
+    }
+
+    task();
+    return true;
+}
+
+inline void TaskPool::work(unsigned index)
+{
+    SWorker& worker = getCurrentWorker();
+    worker.pool = this;
+    worker.index = index;
+
+    TTask task;
+    while (true)
+    {
+        if (pop(index, task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWakeUp.wait(lock, [this] { return mStopped || mQueued > 0; });
+        if (mStopped)
+        {
+            break;
+        }
+    }
+}
+
+inline TaskGroup::TaskGroup(TaskPool& pool)
+    : mPool(pool)
+    , mPending(0)
+{
+}
+
+inline TaskGroup::~TaskGroup()
+{
+    join();
+}
+
+inline void TaskGroup::run(const TaskPool::TTask& task)
+{
+    ++mPending;
+    mPool.push([this, task]
+        {
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (!mException)
+                {
+                    mException = std::current_exception();
+                }
+            }
+
+            // The group could be destroyed right after the last task is counted.
+            --mPending;
+        });
+}
+
+inline void TaskGroup::join()
+{
+    while (mPending != 0)
+    {
+        if (!mPool.runOne())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline void TaskGroup::wait()
+{
+    join();
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        exception.swap(mException);
+    }
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_TASKPOOL
@@ -0,0 +1,110 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/parallel/TaskPool.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace NBvh3;
+using namespace std;
+
+/**
+ * Sums [begin, end) range by forking halves.
+ */
+unsigned long long sum(TaskPool& pool, unsigned begin, unsigned end)
+{
+    if (end - begin <= 16)
+    {
+        unsigned long long result = 0;
+        for (unsigned i = begin; i < end; ++i)
+        {
+            result += i;
+        }
+
+        return result;
+    }
+
+    unsigned middle = (begin + end) / 2;
+    unsigned long long left = 0;
+    TaskGroup group(pool);
+    group.run([&pool, &left, begin, middle] { left = sum(pool, begin, middle); });
+    unsigned long long right = sum(pool, middle, end);
+    group.wait();
+
+    return left + right;
+}
+
+TEST(TaskPoolTest, testSize)
+{
+    TaskPool pool(3);
+    EXPECT_EQ(3u, pool.getSize());
+
+    TaskPool hardware;
+    EXPECT_LT(0u, hardware.getSize());
+}
+
+TEST(TaskPoolTest, testRunOneWithoutTasks)
+{
+    TaskPool pool(1);
+    EXPECT_FALSE(pool.runOne());
+}
+
+TEST(TaskPoolTest, testGroup)
+{
+    TaskPool pool(4);
+    atomic<unsigned> counter(0);
+    {
+        TaskGroup group(pool);
+        for (unsigned i = 0; i < 1000; ++i)
+        {
+            group.run([&counter] { ++counter; });
+        }
+    }
+
+    EXPECT_EQ(1000u, counter);
+}
+
+TEST(TaskPoolTest, testNestedGroups)
+{
+    for (unsigned threads = 1; threads <= 4; ++threads)
+    {
+        TaskPool pool(threads);
+        EXPECT_EQ(100000ull * 99999 / 2, sum(pool, 0, 100000));
+    }
+}
+
+TEST(TaskPoolTest, testException)
+{
+    TaskPool pool(2);
+    atomic<unsigned> counter(0);
+    TaskGroup group(pool);
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        group.run([&counter, i]
+            {
+                ++counter;
+                if (i % 10 == 0)
+                {
+                    throw runtime_error("failed");
+                }
+            });
+    }
+
+    EXPECT_THROW(group.wait(), runtime_error);
+    EXPECT_EQ(100u, counter);
+
+    // The exception is reported once and the group could be reused.
+    group.run([&counter] { ++counter; });
+    EXPECT_NO_THROW(group.wait());
+    EXPECT_EQ(101u, counter);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,347 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_INSTANCETREE
+#define BVH3_INSTANCETREE
+
+#include <bvh3/types/STransform.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Two-level hierarchy of instances of shared meshes.
+ * Every mesh has one bottom-level tree built in its own space and placed many times
+ * by rigid transforms. The top-level flat tree is built over bounding volumes of instances,
+ * so memory grows with number of unique meshes and only one node per instance is added.
+ * Trees of meshes are not owned.
+ *
+ * @param TBv Type of bounding volume.
+ */
+template<class TBv>
+class InstanceTree
+{
+public:
+
+    /**
+     * Id of missing mesh or instance.
+     */
+    static const unsigned NONE = ~0u;
+
+    /**
+     * Collided leaves of an instance and of a query.
+     */
+    struct SCollision
+    {
+        /**
+         * Id of the instance.
+         */
+        unsigned instance;
+
+        /**
+         * Leaf of the tree of the mesh.
+         */
+        const Node<TBv>* node;
+
+        /**
+         * Leaf of the query tree.
+         */
+        const Node<TBv>* query;
+    };
+
+    /**
+     * Array of collided leaves.
+     */
+    typedef std::vector<SCollision> TCollisions;
+
+    /**
+     * Adds the mesh.
+     *
+     * @param Root of the tree of the mesh.
+     * @return Id of the mesh, NONE if the root is 0.
+     */
+    unsigned addMesh(const Node<TBv>* root);
+
+    /**
+     * Places the mesh. The top-level tree should be rebuilt after.
+     *
+     * @param Id of the mesh.
+     * @param Transform from space of the mesh to the world.
+     * @return Id of the instance, NONE if the mesh is not found.
+     */
+    unsigned addInstance(unsigned mesh, const STransform& transform);
+
+    /**
+     * Returns number of instances.
+     */
+    unsigned size() const;
+
+    /**
+     * Returns bounding volume of the instance in the world.
+     * Computed from transformed bounding volumes of children of the root of the mesh.
+     */
+    const TBv& getBoundingVolume(unsigned instance) const;
+
+    /**
+     * Returns the top-level tree in depth-first order.
+     * Leaves refer to instances.
+     */
+    const typename FlatTree<TBv>::TNodes& getNodes() const;
+
+    /**
+     * Builds the top-level tree over instances.
+     */
+    void build();
+
+    /**
+     * Finds leaves of instances collided with leaves of the query.
+     * Trees of meshes are queried by Node::collidedLeaves() with inverse transforms of instances,
+     * so nodes of the query are transformed into space of instances only when visited.
+     *
+     * @param Query tree in the world.
+     * @param[out] Container to store collided leaves.
+     * @return true If collided.
+     */
+    bool collided(const Node<TBv>* query, TCollisions& output) const;
+
+private:
+
+    /**
+     * Placed mesh.
+     */
+    struct SInstance
+    {
+        /**
+         * Id of the mesh.
+         */
+        unsigned mesh;
+
+        /**
+         * Transform from space of the mesh to the world.
+         */
+        STransform transform;
+
+        /**
+         * Transform from the world to space of the mesh.
+         */
+        STransform inverse;
+    };
+
+    /**
+     * Appends a subtree on [begin, end) range of mOrder to top-level nodes.
+     *
+     * @param Centers of bounding volumes of instances.
+     * @param Number of levels the subtree could take below its root.
+     * @return Index of created node.
+     */
+    unsigned build(const TVertices& centers, unsigned begin, unsigned end, unsigned levels);
+
+    /**
+     * Roots of trees of meshes.
+     */
+    std::vector<const Node<TBv>*> mMeshes;
+
+    /**
+     * Placed meshes.
+     */
+    std::vector<SInstance> mInstances;
+
+    /**
+     * Bounding volumes of instances in the world.
+     */
+    std::vector<TBv> mBvs;
+
+    /**
+     * Top-level nodes in depth-first order, leaves refer to mOrder.
+     */
+    typename FlatTree<TBv>::TNodes mNodes;
+
+    /**
+     * Ids of instances ordered by leaves.
+     */
+    std::vector<unsigned> mOrder;
+};
+
+template<class TBv>
+const unsigned InstanceTree<TBv>::NONE;
+
+template<class TBv>
+unsigned InstanceTree<TBv>::addMesh(const Node<TBv>* root)
+{
+    if (root == 0)
+    {
+        return NONE;
+    }
+
+    mMeshes.push_back(root);
+    return mMeshes.size() - 1;
+}
+
+template<class TBv>
+unsigned InstanceTree<TBv>::addInstance(unsigned mesh, const STransform& transform)
+{
+    if (mesh >= mMeshes.size())
+    {
+        return NONE;
+    }
+
+    SInstance instance = {mesh, transform, transform.inverse()};
+    mInstances.push_back(instance);
+
+    // Children are transformed separately to get tighter bounding volume.
+    const Node<TBv>* root = mMeshes[mesh];
+    TBv bv;
+    if (root->isLeaf())
+    {
+        bv = transformBoundingVolume(root->getBoundingVolume(), transform);
+    }
+    else
+    {
+        bv = transformBoundingVolume(root->getLeft()->getBoundingVolume(), transform);
+        bv += transformBoundingVolume(root->getRight()->getBoundingVolume(), transform);
+    }
+
+    mBvs.push_back(bv);
+    return mInstances.size() - 1;
+}
+
+template<class TBv>
+unsigned InstanceTree<TBv>::size() const
+{
+    return mInstances.size();
+}
+
+template<class TBv>
+const TBv& InstanceTree<TBv>::getBoundingVolume(unsigned instance) const
+{
+    return mBvs[instance];
+}
+
+template<class TBv>
+const typename FlatTree<TBv>::TNodes& InstanceTree<TBv>::getNodes() const
+{
+    return mNodes;
+}
+
+template<class TBv>
+void InstanceTree<TBv>::build()
+{
+    unsigned size = mInstances.size();
+    TVertices centers(size);
+    mOrder.resize(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        centers[i] = mBvs[i].getCenter();
+        mOrder[i] = i;
+    }
+
+    mNodes.clear();
+    if (size > 0)
+    {
+        mNodes.reserve(2 * size - 1);
+        build(centers, 0, size, getDepthLimit(size));
+    }
+}
+
+template<class TBv>
+unsigned InstanceTree<TBv>::build(const TVertices& centers, unsigned begin, unsigned end, unsigned levels)
+{
+    unsigned result = mNodes.size();
+    mNodes.push_back(SFlatNode<TBv>());
+    TBv bv = mBvs[mOrder[begin]];
+    for (unsigned i = begin + 1; i < end; ++i)
+    {
+        bv += mBvs[mOrder[i]];
+    }
+
+    std::uint32_t index = begin;
+    std::uint32_t count = end - begin;
+    if (count > 1)
+    {
+        // Instances with the same center or too deep subtrees are split by count.
+        unsigned* first = mOrder.data() + begin;
+        unsigned* last = mOrder.data() + end;
+        TBv centersBv = createBoundingVolume<TBv>(centers.data(), first, count);
+        unsigned middle = begin;
+        if (!needsSplitByCount(count, levels))
+        {
+            SplitterByCenter<TBv> splitter(centersBv);
+            middle = splitter.partition(centers.data(), first, last) - mOrder.data();
+        }
+
+        if (middle == begin || middle == end)
+        {
+            middle = partitionByCount(centersBv, centers.data(), first, last) - mOrder.data();
+        }
+
+        build(centers, begin, middle, levels - 1);
+        index = build(centers, middle, end, levels - 1);
+        count = 0;
+    }
+
+    SFlatNode<TBv>& node = mNodes[result];
+    node.bv = bv;
+    node.index = index;
+    node.count = count;
+
+    return result;
+}
+
+template<class TBv>
+bool InstanceTree<TBv>::collided(const Node<TBv>* query, TCollisions& output) const
+{
+    unsigned size = output.size();
+    if (query == 0 || mNodes.empty())
+    {
+        return false;
+    }
+
+    const TBv& queryBv = query->getBoundingVolume();
+    typename Node<TBv>::TCollidedNodes nodes;
+    std::vector<unsigned> stack(1, 0);
+    while (!stack.empty())
+    {
+        unsigned index = stack.back();
+        const SFlatNode<TBv>& node = mNodes[index];
+        stack.pop_back();
+        if (!node.bv.overlapped(queryBv))
+        {
+            continue;
+        }
+
+        if (node.count == 0)
+        {
+            stack.push_back(node.index);
+            stack.push_back(index + 1);
+            continue;
+        }
+
+        for (unsigned i = node.index; i < node.index + node.count; ++i)
+        {
+            const SInstance& instance = mInstances[mOrder[i]];
+            nodes.clear();
+            if (mBvs[mOrder[i]].overlapped(queryBv) && mMeshes[instance.mesh]->collidedLeaves(query, instance.inverse, nodes))
+            {
+                for (unsigned j = 0; j < nodes.size(); ++j)
+                {
+                    SCollision collision = {mOrder[i], nodes[j].first, nodes[j].second};
+                    output.push_back(collision);
+                }
+            }
+        }
+    }
+
+    return output.size() != size;
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_INSTANCETREE
@@ -0,0 +1,287 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_SCENE
+#define BVH3_SCENE
+
+#include <bvh3/Node.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Broad phase over many objects, each one with own tree.
+ * Keeps bounding volumes of roots sorted by minimum along the first axis and finds
+ * candidate pairs by sweep and prune. Objects move a bit between frames,
+ * so the order is restored by insertion sort in almost linear time.
+ * Trees are not owned by the scene.
+ *
+ * @param TBv Type of bounding volume.
+ */
+template<class TBv>
+class Scene
+{
+public:
+
+    /**
+     * Id of missing object.
+     */
+    static const unsigned NONE = ~0u;
+
+    /**
+     * Pair of object ids, the first one is smaller.
+     */
+    typedef std::pair<unsigned, unsigned> TObjectPair;
+
+    /**
+     * Array of pairs of objects.
+     */
+    typedef std::vector<TObjectPair> TObjectPairs;
+
+    /**
+     * Collided pair of objects.
+     */
+    struct SCollision
+    {
+        /**
+         * Id of the first object.
+         */
+        unsigned first;
+
+        /**
+         * Id of the second object.
+         */
+        unsigned second;
+
+        /**
+         * Collided leaves of the first and the second trees.
+         */
+        typename Node<TBv>::TCollidedNodes nodes;
+    };
+
+    /**
+     * Array of collided objects.
+     */
+    typedef std::vector<SCollision> TCollisions;
+
+    /**
+     * Adds the object.
+     * Ids of removed objects are reused.
+     *
+     * @param Root of the tree of the object.
+     * @return Id of the object, NONE if the root is 0.
+     */
+    unsigned add(const Node<TBv>* root);
+
+    /**
+     * Replaces the tree of the object, for example after it has been moved and rebuilt.
+     *
+     * @param Id of the object.
+     * @param New root of the tree.
+     * @return false If there is no such object or the root is 0.
+     */
+    bool update(unsigned id, const Node<TBv>* root);
+
+    /**
+     * Removes the object.
+     *
+     * @param Id of the object.
+     * @return false If there is no such object.
+     */
+    bool remove(unsigned id);
+
+    /**
+     * Returns number of objects.
+     */
+    unsigned size() const;
+
+    /**
+     * Returns root of the tree of the object, 0 if there is no such object.
+     */
+    const Node<TBv>* getRoot(unsigned id) const;
+
+    /**
+     * Finds pairs of objects with overlapped bounding volumes of roots.
+     *
+     * @param[out] Container to store candidate pairs, sorted by ids.
+     */
+    void findPairs(TObjectPairs& output);
+
+    /**
+     * Checks candidate pairs of objects by Node::collidedLeaves(),
+     * so objects with overlapped roots but without overlapped leaves are not reported.
+     *
+     * @param[out] Container to store collided objects with collided leaves.
+     * @return true If any objects collided.
+     */
+    bool collided(TCollisions& output);
+
+private:
+
+    /**
+     * Roots of trees by ids, 0 for removed objects.
+     */
+    std::vector<const Node<TBv>*> mRoots;
+
+    /**
+     * Ids of removed objects.
+     */
+    std::vector<unsigned> mFree;
+
+    /**
+     * Ids of objects sorted by minimum of the first axis.
+     */
+    std::vector<unsigned> mOrder;
+
+    /**
+     * Minimum of the first axis by ids.
+     */
+    std::vector<float> mMin;
+
+    /**
+     * Maximum of the first axis by ids.
+     */
+    std::vector<float> mMax;
+
+    /**
+     * Candidate pairs of the last query.
+     */
+    TObjectPairs mPairs;
+};
+
+template<class TBv>
+const unsigned Scene<TBv>::NONE;
+
+template<class TBv>
+unsigned Scene<TBv>::add(const Node<TBv>* root)
+{
+    if (root == 0)
+    {
+        return NONE;
+    }
+
+    unsigned id = mRoots.size();
+    if (!mFree.empty())
+    {
+        id = mFree.back();
+        mFree.pop_back();
+    }
+    else
+    {
+        mRoots.push_back(0);
+        mMin.push_back(0);
+        mMax.push_back(0);
+    }
+
+    mRoots[id] = root;
+    mOrder.push_back(id);
+    update(id, root);
+
+    return id;
+}
+
+template<class TBv>
+bool Scene<TBv>::update(unsigned id, const Node<TBv>* root)
+{
+    if (root == 0 || getRoot(id) == 0)
+    {
+        return false;
+    }
+
+    mRoots[id] = root;
+    mMin[id] = root->getBoundingVolume().getMin(0);
+    mMax[id] = root->getBoundingVolume().getMax(0);
+    return true;
+}
+
+template<class TBv>
+bool Scene<TBv>::remove(unsigned id)
+{
+    if (getRoot(id) == 0)
+    {
+        return false;
+    }
+
+    mRoots[id] = 0;
+    mOrder.erase(std::find(mOrder.begin(), mOrder.end(), id));
+    mFree.push_back(id);
+    return true;
+}
+
+template<class TBv>
+unsigned Scene<TBv>::size() const
+{
+    return mOrder.size();
+}
+
+template<class TBv>
+const Node<TBv>* Scene<TBv>::getRoot(unsigned id) const
+{
+    return id < mRoots.size() ? mRoots[id] : 0;
+}
+
+template<class TBv>
+void Scene<TBv>::findPairs(TObjectPairs& output)
+{
+    // Insertion sort is linear for almost sorted ids.
+    for (unsigned i = 1; i < mOrder.size(); ++i)
+    {
+        unsigned id = mOrder[i];
+        unsigned j = i;
+        for (; j > 0 && mMin[mOrder[j - 1]] > mMin[id]; --j)
+        {
+            mOrder[j] = mOrder[j - 1];
+        }
+
+        mOrder[j] = id;
+    }
+
+    unsigned size = output.size();
+    for (unsigned i = 0; i < mOrder.size(); ++i)
+    {
+        unsigned id = mOrder[i];
+        for (unsigned j = i + 1; j < mOrder.size() && mMin[mOrder[j]] <= mMax[id]; ++j)
+        {
+            unsigned other = mOrder[j];
+            if (mRoots[id]->overlapped(mRoots[other]))
+            {
+                output.push_back(id < other ? TObjectPair(id, other) : TObjectPair(other, id));
+            }
+        }
+    }
+
+    std::sort(output.begin() + size, output.end());
+}
+
+template<class TBv>
+bool Scene<TBv>::collided(TCollisions& output)
+{
+    mPairs.clear();
+    findPairs(mPairs);
+
+    unsigned size = output.size();
+    for (unsigned i = 0; i < mPairs.size(); ++i)
+    {
+        SCollision collision;
+        collision.first = mPairs[i].first;
+        collision.second = mPairs[i].second;
+        if (mRoots[collision.first]->collidedLeaves(mRoots[collision.second], collision.nodes))
+        {
+            output.push_back(std::move(collision));
+        }
+    }
+
+    return output.size() != size;
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_SCENE
@@ -0,0 +1,179 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/scene/InstanceTree.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <tuple>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef Node<TKDop16> TNodeKDop16;
+typedef InstanceTree<TKDop16> TInstanceTreeKDop16;
+
+/**
+ * Returns transform rotating by multiple of 90 degrees around z, so vertices stay exact.
+ */
+STransform getTransform(unsigned quarters, float x, float y, float z)
+{
+    float rotation[4][4] =
+    {
+        {1, 0, 0, 1},
+        {0, -1, 1, 0},
+        {-1, 0, 0, -1},
+        {0, 1, -1, 0}
+    };
+
+    STransform result(SVertex(x, y, z));
+    result.rotation[0] = rotation[quarters % 4][0];
+    result.rotation[1] = rotation[quarters % 4][1];
+    result.rotation[3] = rotation[quarters % 4][2];
+    result.rotation[4] = rotation[quarters % 4][3];
+    return result;
+}
+
+/**
+ * Returns distinct vertices of a box.
+ */
+TVertices getBox(unsigned x, unsigned y, unsigned z)
+{
+    TVertices result;
+    for (unsigned i = 0; i < x; ++i)
+    {
+        for (unsigned j = 0; j < y; ++j)
+        {
+            for (unsigned k = 0; k < z; ++k)
+            {
+                result.push_back(SVertex(i, j, k));
+            }
+        }
+    }
+
+    return result;
+}
+
+TEST(InstanceTreeTest, testTransform)
+{
+    STransform transform(SVertex(0, 0, 1), 0.3f, SVertex(1, 2, 3));
+    STransform identity = transform * transform.inverse();
+    SVertex vertex(4, 5, 6);
+    SVertex result = identity(vertex);
+    EXPECT_NEAR(vertex.x, result.x, 1e-5f);
+    EXPECT_NEAR(vertex.y, result.y, 1e-5f);
+    EXPECT_NEAR(vertex.z, result.z, 1e-5f);
+
+    result = transform.inverse()(transform(vertex));
+    EXPECT_NEAR(vertex.x, result.x, 1e-5f);
+    EXPECT_NEAR(vertex.y, result.y, 1e-5f);
+    EXPECT_NEAR(vertex.z, result.z, 1e-5f);
+
+    EXPECT_EQ(SVertex(-1, 3, 3), getTransform(1, 1, 2, 3)(SVertex(1, 2, 0)));
+}
+
+TEST(InstanceTreeTest, testCollided)
+{
+    TVertices mesh1 = getBox(3, 2, 2);
+    TVertices mesh2 = getBox(1, 4, 1);
+    auto root1 = buildTree<TKDop16>(mesh1);
+    auto root2 = buildTree<TKDop16>(mesh2);
+
+    TInstanceTreeKDop16 instances;
+    EXPECT_EQ(0, instances.addMesh(root1));
+    EXPECT_EQ(1, instances.addMesh(root2));
+
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> position(0, 12);
+    vector<unsigned> meshes;
+    vector<STransform> transforms;
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        meshes.push_back(i % 2);
+        transforms.push_back(getTransform(i, position(generator), position(generator), position(generator)));
+        EXPECT_EQ(i, instances.addInstance(meshes[i], transforms[i]));
+    }
+
+    instances.build();
+    EXPECT_EQ(2 * instances.size() - 1, instances.getNodes().size());
+
+    TVertices queryVertices = getBox(8, 8, 8);
+    auto query = buildTree<TKDop16>(queryVertices);
+
+    // Pairs of equal vertices of instances placed explicitly and of the query.
+    typedef tuple<unsigned, SVertex, SVertex> TMatch;
+    auto less = [](const TMatch& a, const TMatch& b)
+    {
+        return make_tuple(get<0>(a), get<1>(a).x, get<1>(a).y, get<1>(a).z, get<2>(a).x, get<2>(a).y, get<2>(a).z)
+            < make_tuple(get<0>(b), get<1>(b).x, get<1>(b).y, get<1>(b).z, get<2>(b).x, get<2>(b).y, get<2>(b).z);
+    };
+
+    vector<TMatch> expected;
+    for (unsigned i = 0; i < meshes.size(); ++i)
+    {
+        const TVertices& mesh = meshes[i] == 0 ? mesh1 : mesh2;
+        for (unsigned j = 0; j < mesh.size(); ++j)
+        {
+            SVertex placed = transforms[i](mesh[j]);
+            if (find(queryVertices.begin(), queryVertices.end(), placed) != queryVertices.end())
+            {
+                expected.push_back(TMatch(i, mesh[j], placed));
+            }
+        }
+    }
+
+    TInstanceTreeKDop16::TCollisions output;
+    EXPECT_TRUE(instances.collided(query, output));
+    vector<TMatch> matches;
+    for (unsigned i = 0; i < output.size(); ++i)
+    {
+        ASSERT_TRUE(output[i].node->isLeaf());
+        ASSERT_TRUE(output[i].query->isLeaf());
+        matches.push_back(TMatch(output[i].instance, output[i].node->getVertices()[0], output[i].query->getVertices()[0]));
+    }
+
+    std::sort(expected.begin(), expected.end(), less);
+    std::sort(matches.begin(), matches.end(), less);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_LT(expected.size(), 100 * mesh1.size());
+    EXPECT_TRUE(expected == matches);
+
+    // The query far away from instances.
+    TVertices far = {{100, 100, 100}};
+    auto farQuery = buildTree<TKDop16>(far);
+    output.clear();
+    EXPECT_FALSE(instances.collided(farQuery, output));
+
+    TInstanceTreeKDop16 empty;
+    EXPECT_FALSE(empty.collided(query, output));
+
+    delete root1;
+    delete root2;
+    delete query;
+    delete farQuery;
+}
+
+TEST(InstanceTreeTest, testInvalidMesh)
+{
+    TVertices mesh = getBox(2, 2, 2);
+    auto root = buildTree<TKDop16>(mesh);
+
+    TInstanceTreeKDop16 instances;
+    EXPECT_EQ(TInstanceTreeKDop16::NONE, instances.addMesh(0));
+    EXPECT_EQ(TInstanceTreeKDop16::NONE, instances.addInstance(0, getTransform(0, 0, 0, 0)));
+
+    EXPECT_EQ(0, instances.addMesh(root));
+    EXPECT_EQ(TInstanceTreeKDop16::NONE, instances.addInstance(1, getTransform(0, 0, 0, 0)));
+    EXPECT_EQ(TInstanceTreeKDop16::NONE, instances.addInstance(TInstanceTreeKDop16::NONE, getTransform(0, 0, 0, 0)));
+    EXPECT_EQ(0, instances.size());
+
+    EXPECT_EQ(0, instances.addInstance(0, getTransform(1, 1, 0, 0)));
+    instances.build();
+    EXPECT_EQ(1, instances.getNodes().size());
+
+    delete root;
+}
@@ -0,0 +1,202 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/scene/Scene.hpp>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef Node<TKDop16> TNodeKDop16;
+typedef Scene<TKDop16> TSceneKDop16;
+
+/**
+ * Returns vertices of a small grid at the position.
+ */
+TVertices getObject(float x, float y, float z)
+{
+    TVertices result;
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        result.push_back(SVertex(x + (i & 1), y + ((i >> 1) & 1), z + ((i >> 2) & 1)));
+    }
+
+    return result;
+}
+
+/**
+ * Returns pairs of objects with overlapped roots by testing every pair of ids below the number.
+ */
+TSceneKDop16::TObjectPairs getPairsByBruteForce(const TSceneKDop16& scene, unsigned ids)
+{
+    TSceneKDop16::TObjectPairs result;
+    for (unsigned i = 0; i < ids; ++i)
+    {
+        for (unsigned j = i + 1; j < ids; ++j)
+        {
+            if (scene.getRoot(i) != 0 && scene.getRoot(i)->overlapped(scene.getRoot(j)))
+            {
+                result.push_back(make_pair(i, j));
+            }
+        }
+    }
+
+    return result;
+}
+
+TEST(SceneTest, testFindPairs)
+{
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> position(0, 20);
+    std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+    vector<SVertex> positions;
+    vector<TNodeKDop16*> roots;
+    TSceneKDop16 scene;
+    for (unsigned i = 0; i < 200; ++i)
+    {
+        positions.push_back(SVertex(position(generator), position(generator), position(generator)));
+        roots.push_back(buildTree<TKDop16>(getObject(positions[i].x, positions[i].y, positions[i].z)));
+        EXPECT_EQ(i, scene.add(roots[i]));
+    }
+
+    EXPECT_EQ(200, scene.size());
+    for (unsigned frame = 0; frame < 10; ++frame)
+    {
+        TSceneKDop16::TObjectPairs pairs;
+        scene.findPairs(pairs);
+        EXPECT_FALSE(pairs.empty());
+        EXPECT_EQ(getPairsByBruteForce(scene, roots.size()), pairs);
+
+        // Moves all objects.
+        for (unsigned i = 0; i < roots.size(); ++i)
+        {
+            positions[i] = SVertex(positions[i].x + step(generator), positions[i].y + step(generator), positions[i].z);
+            delete roots[i];
+            roots[i] = buildTree<TKDop16>(getObject(positions[i].x, positions[i].y, positions[i].z));
+            scene.update(i, roots[i]);
+        }
+    }
+
+    for (unsigned i = 0; i < roots.size(); ++i)
+    {
+        delete roots[i];
+    }
+}
+
+TEST(SceneTest, testCollided)
+{
+    auto root1 = buildTree<TKDop16>(getObject(0, 0, 0));
+    auto root2 = buildTree<TKDop16>(getObject(1, 1, 1));
+    auto root3 = buildTree<TKDop16>(getObject(5, 0, 0));
+    auto root4 = buildTree<TKDop16>(getObject(0.5f, 5, 0));
+
+    TSceneKDop16 scene;
+    scene.add(root1);
+    scene.add(root2);
+    scene.add(root3);
+    scene.add(root4);
+
+    TSceneKDop16::TCollisions output;
+    EXPECT_TRUE(scene.collided(output));
+    ASSERT_EQ(1, output.size());
+    EXPECT_EQ(0, output[0].first);
+    EXPECT_EQ(1, output[0].second);
+
+    // Only the common corner is found.
+    TNodeKDop16::TCollidedNodes expected;
+    EXPECT_TRUE(root1->collidedLeaves(root2, expected));
+    EXPECT_EQ(expected, output[0].nodes);
+    ASSERT_EQ(1, output[0].nodes.size());
+    EXPECT_EQ(SVertex(1, 1, 1), output[0].nodes[0].first->getVertices()[0]);
+
+    // Moves the second object away from the first one.
+    delete root2;
+    root2 = buildTree<TKDop16>(getObject(10, 10, 10));
+    scene.update(1, root2);
+    output.clear();
+    EXPECT_FALSE(scene.collided(output));
+    EXPECT_TRUE(output.empty());
+
+    // Roots overlap, but vertices are between each other.
+    auto root5 = buildTree<TKDop16>(getObject(0.5f, 0.5f, 0.5f));
+    scene.add(root5);
+    TSceneKDop16::TObjectPairs pairs;
+    scene.findPairs(pairs);
+    EXPECT_EQ(1, pairs.size());
+    EXPECT_FALSE(scene.collided(output));
+
+    TSceneKDop16 empty;
+    EXPECT_FALSE(empty.collided(output));
+
+    delete root1;
+    delete root2;
+    delete root3;
+    delete root4;
+    delete root5;
+}
+
+TEST(SceneTest, testAddRemove)
+{
+    vector<TNodeKDop16*> roots;
+    for (unsigned i = 0; i < 6; ++i)
+    {
+        roots.push_back(buildTree<TKDop16>(getObject(i * 0.5f, 0, 0)));
+    }
+
+    TSceneKDop16 scene;
+    EXPECT_EQ(TSceneKDop16::NONE, scene.add(0));
+    EXPECT_EQ(0, scene.size());
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(i, scene.add(roots[i]));
+    }
+
+    EXPECT_FALSE(scene.update(0, 0));
+    EXPECT_FALSE(scene.update(10, roots[4]));
+    EXPECT_EQ(roots[0], scene.getRoot(0));
+
+    EXPECT_TRUE(scene.remove(1));
+    EXPECT_FALSE(scene.remove(1));
+    EXPECT_FALSE(scene.remove(10));
+    EXPECT_FALSE(scene.update(1, roots[4]));
+    EXPECT_EQ(3, scene.size());
+    EXPECT_EQ(0, scene.getRoot(1));
+
+    TSceneKDop16::TObjectPairs pairs;
+    scene.findPairs(pairs);
+    EXPECT_EQ(getPairsByBruteForce(scene, 4), pairs);
+    TSceneKDop16::TCollisions output;
+    EXPECT_TRUE(scene.collided(output));
+    for (unsigned i = 0; i < output.size(); ++i)
+    {
+        EXPECT_NE(1, output[i].first);
+        EXPECT_NE(1, output[i].second);
+    }
+
+    // Ids of removed objects are reused.
+    EXPECT_EQ(1, scene.add(roots[4]));
+    EXPECT_EQ(4, scene.add(roots[5]));
+    EXPECT_EQ(5, scene.size());
+    pairs.clear();
+    scene.findPairs(pairs);
+    EXPECT_EQ(getPairsByBruteForce(scene, 5), pairs);
+
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        EXPECT_TRUE(scene.remove(i));
+    }
+
+    EXPECT_EQ(0, scene.size());
+    output.clear();
+    EXPECT_FALSE(scene.collided(output));
+
+    for (unsigned i = 0; i < roots.size(); ++i)
+    {
+        delete roots[i];
+    }
+}
@@ -10,33 +10,241 @@
 #define BVH3_SPLITTER
 
 #include <bvh3/types/SVertex.hpp>
+#include <algorithm>
 
 namespace NBvh3
 {
 
 /**
- * Base abstract splitter class.
+ * Base splitter class with static interface.
+ * Builders get the splitter as a template parameter and call it directly,
+ * so isLeft() is inlined into loops over vertices without virtual calls.
+ *
+ * A splitter is derived as class TSplitter : public Splitter<TSplitter>, is constructed by
+ * TSplitter(bv) or TSplitter(vertices, bv) and defines isLeft() and split().
+ * Other functions have default implementations and could be hidden by own ones.
+ *
+ * @tparam TSplitter Derived splitter.
  */
+template<class TSplitter>
 class Splitter
 {
 public:
 
+    /**
+     * Splits original vertices to 2 vectors.
+     * Should be defined by the derived splitter.
+     *
+     * @param[out] Vertices that are located left.
+     * @param[out] Vertices that are located right.
+     */
+    void split(TVertices& left, TVertices& right) const;
+
+    /**
+     * Reorders vertices in place so left ones go first.
+     * By default vertices are partitioned by isLeft().
+     *
+     * @param First vertex of the range.
+     * @param Vertex after the last one.
+     * @return First vertex of the right part.
+     */
+    SVertex* partition(SVertex* begin, SVertex* end) const
+    {
+        const TSplitter& splitter = getSplitter();
+        return std::partition(
+            begin,
+            end,
+            [&splitter](const SVertex& vertex) { return splitter.isLeft(vertex); }
+            );
+    }
+
+    /**
+     * Reorders indices of vertices in place so indices of left vertices go first.
+     * By default indices are partitioned by isLeft().
+     *
+     * @param All vertices the indices refer to.
+     * @param First index of the range.
+     * @param Index after the last one.
+     * @return First index of the right part.
+     */
+    unsigned* partition(const SVertex* vertices, unsigned* begin, unsigned* end) const
+    {
+        const TSplitter& splitter = getSplitter();
+        return std::partition(
+            begin,
+            end,
+            [&splitter, vertices](unsigned index) { return splitter.isLeft(vertices[index]); }
+            );
+    }
+
+    /**
+     * Prepares the splitter to check vertices of the range by isLeft(),
+     * e.g. to partition the range by chunks in parallel.
+     *
+     * @param All vertices the indices refer to.
+     * @param First index of the range.
+     * @param Index after the last one.
+     */
+    void prepare(const SVertex*, const unsigned*, const unsigned*)
+    {
+    }
+
+    /**
+     * Checks if the vertex belongs to the left part.
+     * Returns the same as partition() when prepare() is called for the same range.
+     * Should be defined by the derived splitter.
+     */
+    bool isLeft(const SVertex& vertex) const;
+
+protected:
+
     /**
      * Destructor.
+     * Splitters are not deleted by pointers to the base class.
      */
     ~Splitter()
     {
     }
 
+private:
+
     /**
-     * Splits original vertices to 2 vectors.
-     *
-     * @param[out] Vertices that are located left.
-     * @param[out] Vertices that are located right.
-     */    
-    virtual void split(TVertices& left, TVertices& right) const = 0;
+     * Returns the derived splitter.
+     */
+    const TSplitter& getSplitter() const
+    {
+        return static_cast<const TSplitter&>(*this);
+    }
 };
 
+/**
+ * Returns number of levels below the root of a balanced tree over the number of leaves.
+ */
+inline unsigned getBalancedDepth(unsigned size)
+{
+    unsigned result = 0;
+    while (result < 32 && (1ull << result) < size)
+    {
+        ++result;
+    }
+
+    return result;
+}
+
+/**
+ * Returns number of levels below the root a builder could take for the number of vertices.
+ * Trees are not deeper than twice a balanced one.
+ */
+inline unsigned getDepthLimit(unsigned size)
+{
+    return 2 * getBalancedDepth(size);
+}
+
+/**
+ * Checks if a range should be split by count instead of the splitter,
+ * because the rest of levels is just enough for a balanced subtree.
+ *
+ * @param Number of vertices of the range.
+ * @param Number of levels left below the node of the range.
+ */
+inline bool needsSplitByCount(unsigned size, unsigned levels)
+{
+    return levels <= getBalancedDepth(size);
+}
+
+/**
+ * Returns index of the longest of the first three axes of the bounding volume.
+ */
+template<class TBv>
+unsigned getLongestAxis(const TBv& bv)
+{
+    float width = bv.getWidth();
+    float height = bv.getHeight();
+    float depth = bv.getDepth();
+    if (width >= height && width >= depth)
+    {
+        return 0;
+    }
+
+    return height >= depth ? 1 : 2;
+}
+
+/**
+ * Compares vertices along the axis, then along next axes.
+ */
+inline bool lessFromAxis(const SVertex& a, const SVertex& b, unsigned axis)
+{
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        unsigned next = (axis + i) % 3;
+        if (a[next] != b[next])
+        {
+            return a[next] < b[next];
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Reorders vertices so the first half of them goes first along the longest axis.
+ * Used when a splitter leaves one part empty, e.g. for coincident vertices,
+ * or when the tree would become too deep.
+ * Ties are ordered by other axes, so the halves do not depend on the order of vertices.
+ *
+ * @param Bounding volume of the vertices.
+ * @param First vertex of the range.
+ * @param Vertex after the last one.
+ * @return First vertex of the right part, the middle of the range.
+ */
+template<class TBv>
+SVertex* partitionByCount(const TBv& bv, SVertex* begin, SVertex* end)
+{
+    unsigned axis = getLongestAxis(bv);
+    SVertex* middle = begin + (end - begin) / 2;
+    std::nth_element(
+        begin,
+        middle,
+        end,
+        [axis](const SVertex& a, const SVertex& b) { return lessFromAxis(a, b, axis); }
+        );
+
+    return middle;
+}
+
+/**
+ * Reorders indices of vertices so the first half of them goes first along the longest axis.
+ * Coincident vertices are ordered by indices, so the halves do not depend on the order of indices.
+ *
+ * @param Bounding volume of the vertices.
+ * @param All vertices the indices refer to.
+ * @param First index of the range.
+ * @param Index after the last one.
+ * @return First index of the right part, the middle of the range.
+ */
+template<class TBv>
+unsigned* partitionByCount(const TBv& bv, const SVertex* vertices, unsigned* begin, unsigned* end)
+{
+    unsigned axis = getLongestAxis(bv);
+    unsigned* middle = begin + (end - begin) / 2;
+    std::nth_element(
+        begin,
+        middle,
+        end,
+        [axis, vertices](unsigned a, unsigned b)
+        {
+            if (lessFromAxis(vertices[a], vertices[b], axis))
+            {
+                return true;
+            }
+
+            return !lessFromAxis(vertices[b], vertices[a], axis) && a < b;
+        }
+        );
+
+    return middle;
+}
+
 } // namespace NBvh3
 
 #endif // BVH3_SPLITTER
\ No newline at end of file
@@ -10,6 +10,7 @@
 #define BVH3_SPLITTERBYCENTER
 
 #include "Splitter.hpp"
+#include <algorithm>
 #include <iostream>
 namespace NBvh3
 {
@@ -18,7 +19,7 @@ namespace NBvh3
  * Template class to split vertices by a center of bounding volume created on submitted vertices.
  */
 template<class TBv>
-class SplitterByCenter : public Splitter
+class SplitterByCenter : public Splitter<SplitterByCenter<TBv> >
 {
 public:
 
@@ -30,10 +31,22 @@ public:
      */
     SplitterByCenter(const TVertices& vertices, const TBv& bv);
 
+    /**
+     * Creates splitter without own vertices, only partition() could be used.
+     *
+     * @param Bounding volume of vertices to partition.
+     */
+    SplitterByCenter(const TBv& bv);
+
     /**
      * @copydoc Splitter::split()
      */
-    virtual void split(TVertices& left, TVertices& right) const;
+    void split(TVertices& left, TVertices& right) const;
+
+    /**
+     * @copydoc Splitter::isLeft()
+     */
+    bool isLeft(const SVertex& vertex) const;
 
 private:
 
@@ -42,10 +55,16 @@ private:
      */
     bool isRight(const SVertex& vertex) const;
 
+    /**
+     * Finds axis and its center value.
+     */
+    void init();
+
     /**
      * Submitted vertices.
+     * Could be 0 if only partition() is used.
      */
-    const TVertices& mVertices;
+    const TVertices* mVertices;
 
     /**
      * Produces bounding volume of vertices.
@@ -68,10 +87,26 @@ SplitterByCenter<TBv>::SplitterByCenter(
     const TVertices& vertices,
     const TBv& bv
     )
-    : mVertices(vertices)
+    : mVertices(&vertices)
+    , mBv(bv)
+    , mAxis(2)
+    , mAxisValue(0)
+{
+    init();
+}
+
+template<class TBv>
+SplitterByCenter<TBv>::SplitterByCenter(const TBv& bv)
+    : mVertices(0)
     , mBv(bv)
     , mAxis(2)
     , mAxisValue(0)
+{
+    init();
+}
+
+template<class TBv>
+void SplitterByCenter<TBv>::init()
 {
     SVertex center = mBv.getCenter();
 
@@ -93,18 +128,30 @@ bool SplitterByCenter<TBv>::isRight(const SVertex& vertex) const
     return vertex[mAxis] > mAxisValue;
 }
 
+template<class TBv>
+bool SplitterByCenter<TBv>::isLeft(const SVertex& vertex) const
+{
+    return !isRight(vertex);
+}
+
 template<class TBv>
 void SplitterByCenter<TBv>::split(TVertices& left, TVertices& right) const
 {
-    for (unsigned i = 0; i < mVertices.size(); ++i)
+    if (mVertices == 0)
+    {
+        return;
+    }
+
+    const TVertices& vertices = *mVertices;
+    for (unsigned i = 0; i < vertices.size(); ++i)
     {
-        if (isRight(mVertices[i]))
+        if (isRight(vertices[i]))
         {
-            right.push_back(mVertices[i]);
+            right.push_back(vertices[i]);
         }
         else
         {
-            left.push_back(mVertices[i]);
+            left.push_back(vertices[i]);
         }
     }
 }
@@ -0,0 +1,312 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GKU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_SPLITTERBYDIRECTION
+#define BVH3_SPLITTERBYDIRECTION
+
+#include "Splitter.hpp"
+#include "SplitterByCenter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace NBvh3
+{
+
+/**
+ * Template class to split vertices by the center along the best of all directions of KDop,
+ * including diagonal ones, instead of the longest of x, y and z.
+ * Every direction is scored by both parts split by its center as sum of their widths
+ * along all directions multiplied by number of vertices, so diagonal structures
+ * like ramps and rotated buildings are separated along their own directions.
+ * Widths are taken from getMin() and getMax() normalized by length of directions.
+ */
+template<class TBv>
+class SplitterByDirection : public Splitter<SplitterByDirection<TBv> >
+{
+public:
+
+    /**
+     * Default constructor.
+     *
+     * @param Applied vertices to split.
+     * @param Bounding volume of applied vertices.
+     */
+    SplitterByDirection(const TVertices& vertices, const TBv& bv);
+
+    /**
+     * Creates splitter without own vertices, only partition() could be used.
+     *
+     * @param Bounding volume of vertices to partition.
+     */
+    SplitterByDirection(const TBv& bv);
+
+    /**
+     * @copydoc Splitter::split()
+     */
+    void split(TVertices& left, TVertices& right) const;
+
+    /**
+     * @copydoc Splitter::partition()
+     */
+    SVertex* partition(SVertex* begin, SVertex* end) const;
+
+    /**
+     * @copydoc Splitter::partition()
+     */
+    unsigned* partition(const SVertex* vertices, unsigned* begin, unsigned* end) const;
+
+    /**
+     * Finds the best direction of the range.
+     *
+     * @copydoc Splitter::prepare()
+     */
+    void prepare(const SVertex* vertices, const unsigned* begin, const unsigned* end);
+
+    /**
+     * @copydoc Splitter::isLeft()
+     */
+    bool isLeft(const SVertex& vertex) const;
+
+    /**
+     * Returns sum of widths of the bounding volume along all directions.
+     */
+    static float getWidth(const TBv& bv);
+
+private:
+
+    /**
+     * Splitting plane.
+     */
+    struct SPlane
+    {
+        /**
+         * Index of direction, TBv::DIRECTIONS if not found.
+         */
+        unsigned axis;
+
+        /**
+         * Distance of the plane, vertices above it go right.
+         */
+        float value;
+    };
+
+    /**
+     * Checks if the vertex belongs to the left part of the plane.
+     */
+    bool isLeft(const SVertex& vertex, const SPlane& plane) const;
+
+    /**
+     * Finds the direction with minimal cost.
+     *
+     * @param Number of vertices.
+     * @param Returns vertex by its number.
+     */
+    template<class TGetter>
+    SPlane findPlane(unsigned size, const TGetter& getter) const;
+
+    /**
+     * Submitted vertices.
+     * Could be 0 if only partition() is used.
+     */
+    const TVertices* mVertices;
+
+    /**
+     * Produces bounding volume of vertices.
+     */
+    const TBv& mBv;
+
+    /**
+     * Used if all vertices are coincident.
+     */
+    SplitterByCenter<TBv> mFallback;
+
+    /**
+     * Plane found by prepare().
+     */
+    SPlane mPlane;
+};
+
+template<class TBv>
+SplitterByDirection<TBv>::SplitterByDirection(const TVertices& vertices, const TBv& bv)
+    : mVertices(&vertices)
+    , mBv(bv)
+    , mFallback(vertices, bv)
+{
+    mPlane.axis = TBv::DIRECTIONS;
+    mPlane.value = 0;
+}
+
+template<class TBv>
+SplitterByDirection<TBv>::SplitterByDirection(const TBv& bv)
+    : mVertices(0)
+    , mBv(bv)
+    , mFallback(bv)
+{
+    mPlane.axis = TBv::DIRECTIONS;
+    mPlane.value = 0;
+}
+
+template<class TBv>
+float SplitterByDirection<TBv>::getWidth(const TBv& bv)
+{
+    float result = 0;
+    for (unsigned axis = 0; axis < TBv::DIRECTIONS; ++axis)
+    {
+        SVertex direction = TBv::getDirection(axis);
+        float length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+        result += (bv.getMax(axis) - bv.getMin(axis)) / length;
+    }
+
+    return result;
+}
+
+template<class TBv>
+bool SplitterByDirection<TBv>::isLeft(const SVertex& vertex, const SPlane& plane) const
+{
+    // Distances are rounded by KDop the same way as in findPlane().
+    return TBv::getDistance(vertex, plane.axis) <= plane.value;
+}
+
+template<class TBv>
+template<class TGetter>
+typename SplitterByDirection<TBv>::SPlane SplitterByDirection<TBv>::findPlane(unsigned size, const TGetter& getter) const
+{
+    const unsigned directions = TBv::DIRECTIONS;
+    float centers[directions];
+    for (unsigned axis = 0; axis < directions; ++axis)
+    {
+        centers[axis] = (mBv.getMin(axis) + mBv.getMax(axis)) * 0.5f;
+    }
+
+    // Left and right parts for every direction.
+    TBv bvs[directions][2];
+    unsigned counts[directions][2] = {{0}};
+    for (unsigned i = 0; i < size; ++i)
+    {
+        TBv point(getter(i));
+        for (unsigned axis = 0; axis < directions; ++axis)
+        {
+            unsigned side = point.getMin(axis) > centers[axis];
+            bvs[axis][side] += point;
+            ++counts[axis][side];
+        }
+    }
+
+    SPlane result = {directions, 0};
+    float bestCost = std::numeric_limits<float>::max();
+    for (unsigned axis = 0; axis < directions; ++axis)
+    {
+        if (counts[axis][0] == 0 || counts[axis][1] == 0)
+        {
+            continue;
+        }
+
+        float cost = getWidth(bvs[axis][0]) * counts[axis][0] + getWidth(bvs[axis][1]) * counts[axis][1];
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            result.axis = axis;
+            result.value = centers[axis];
+        }
+    }
+
+    return result;
+}
+
+template<class TBv>
+void SplitterByDirection<TBv>::split(TVertices& left, TVertices& right) const
+{
+    if (mVertices == 0)
+    {
+        return;
+    }
+
+    const TVertices& vertices = *mVertices;
+    SPlane plane = findPlane(
+        vertices.size(),
+        [&vertices](unsigned i) -> const SVertex& { return vertices[i]; }
+        );
+
+    if (plane.axis == TBv::DIRECTIONS)
+    {
+        mFallback.split(left, right);
+        return;
+    }
+
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        if (isLeft(vertices[i], plane))
+        {
+            left.push_back(vertices[i]);
+        }
+        else
+        {
+            right.push_back(vertices[i]);
+        }
+    }
+}
+
+template<class TBv>
+SVertex* SplitterByDirection<TBv>::partition(SVertex* begin, SVertex* end) const
+{
+    SPlane plane = findPlane(
+        end - begin,
+        [begin](unsigned i) -> const SVertex& { return begin[i]; }
+        );
+
+    if (plane.axis == TBv::DIRECTIONS)
+    {
+        return mFallback.partition(begin, end);
+    }
+
+    return std::partition(
+        begin,
+        end,
+        [this, &plane](const SVertex& vertex) { return isLeft(vertex, plane); }
+        );
+}
+
+template<class TBv>
+unsigned* SplitterByDirection<TBv>::partition(const SVertex* vertices, unsigned* begin, unsigned* end) const
+{
+    SPlane plane = findPlane(
+        end - begin,
+        [vertices, begin](unsigned i) -> const SVertex& { return vertices[begin[i]]; }
+        );
+
+    if (plane.axis == TBv::DIRECTIONS)
+    {
+        return mFallback.partition(vertices, begin, end);
+    }
+
+    return std::partition(
+        begin,
+        end,
+        [this, vertices, &plane](unsigned index) { return isLeft(vertices[index], plane); }
+        );
+}
+
+template<class TBv>
+void SplitterByDirection<TBv>::prepare(const SVertex* vertices, const unsigned* begin, const unsigned* end)
+{
+    mPlane = findPlane(
+        end - begin,
+        [vertices, begin](unsigned i) -> const SVertex& { return vertices[begin[i]]; }
+        );
+}
+
+template<class TBv>
+bool SplitterByDirection<TBv>::isLeft(const SVertex& vertex) const
+{
+    return mPlane.axis == TBv::DIRECTIONS ? mFallback.isLeft(vertex) : isLeft(vertex, mPlane);
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_SPLITTERBYDIRECTION
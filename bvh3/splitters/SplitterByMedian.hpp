@@ -0,0 +1,179 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GKU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_SPLITTERBYMEDIAN
+#define BVH3_SPLITTERBYMEDIAN
+
+#include "Splitter.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Template class to split vertices by the median along the longest axis of bounding volume.
+ * Vertices are split in halves by position, so trees are not deeper than ceil(log2(n)) levels below the root.
+ * Vertices with the same value along the axis are ordered by other axes,
+ * e.g. quantized vertices of scanners share values along every axis.
+ * The median is found by std::nth_element in linear time.
+ */
+template<class TBv>
+class SplitterByMedian : public Splitter<SplitterByMedian<TBv> >
+{
+public:
+
+    /**
+     * Default constructor.
+     *
+     * @param Applied vertices to split.
+     * @param Bounding volume of applied vertices.
+     */
+    SplitterByMedian(const TVertices& vertices, const TBv& bv);
+
+    /**
+     * Creates splitter without own vertices, only partition() could be used.
+     *
+     * @param Bounding volume of vertices to partition.
+     */
+    SplitterByMedian(const TBv& bv);
+
+    /**
+     * @copydoc Splitter::split()
+     */
+    void split(TVertices& left, TVertices& right) const;
+
+    /**
+     * @copydoc Splitter::partition()
+     */
+    SVertex* partition(SVertex* begin, SVertex* end) const;
+
+    /**
+     * @copydoc Splitter::partition()
+     */
+    unsigned* partition(const SVertex* vertices, unsigned* begin, unsigned* end) const;
+
+    /**
+     * Finds the median of the range.
+     *
+     * @copydoc Splitter::prepare()
+     */
+    void prepare(const SVertex* vertices, const unsigned* begin, const unsigned* end);
+
+    /**
+     * Checks if the vertex is less than the median found by prepare().
+     * The same as partition() for distinct vertices, coincident copies of the median go right.
+     */
+    bool isLeft(const SVertex& vertex) const;
+
+private:
+
+    /**
+     * Compares vertices along the axis, then along next axes.
+     */
+    bool less(const SVertex& a, const SVertex& b) const;
+
+    /**
+     * Submitted vertices.
+     * Could be 0 if only partition() is used.
+     */
+    const TVertices* mVertices;
+
+    /**
+     * Number of axis to split along.
+     */
+    unsigned mAxis;
+
+    /**
+     * Median found by prepare().
+     */
+    SVertex mMedian;
+};
+
+template<class TBv>
+SplitterByMedian<TBv>::SplitterByMedian(const TVertices& vertices, const TBv& bv)
+    : mVertices(&vertices)
+    , mAxis(getLongestAxis(bv))
+{
+}
+
+template<class TBv>
+SplitterByMedian<TBv>::SplitterByMedian(const TBv& bv)
+    : mVertices(0)
+    , mAxis(getLongestAxis(bv))
+{
+}
+
+template<class TBv>
+void SplitterByMedian<TBv>::split(TVertices& left, TVertices& right) const
+{
+    if (mVertices == 0 || mVertices->empty())
+    {
+        return;
+    }
+
+    TVertices vertices(*mVertices);
+    SVertex* middle = partition(vertices.data(), vertices.data() + vertices.size());
+    left.insert(left.end(), vertices.data(), middle);
+    right.insert(right.end(), middle, vertices.data() + vertices.size());
+}
+
+template<class TBv>
+bool SplitterByMedian<TBv>::less(const SVertex& a, const SVertex& b) const
+{
+    return lessFromAxis(a, b, mAxis);
+}
+
+template<class TBv>
+SVertex* SplitterByMedian<TBv>::partition(SVertex* begin, SVertex* end) const
+{
+    SVertex* middle = begin + (end - begin) / 2;
+    std::nth_element(begin, middle, end, [this](const SVertex& a, const SVertex& b) { return less(a, b); });
+    return middle;
+}
+
+template<class TBv>
+unsigned* SplitterByMedian<TBv>::partition(const SVertex* vertices, unsigned* begin, unsigned* end) const
+{
+    unsigned* middle = begin + (end - begin) / 2;
+    std::nth_element(
+        begin,
+        middle,
+        end,
+        [this, vertices](unsigned a, unsigned b) { return less(vertices[a], vertices[b]); }
+        );
+
+    return middle;
+}
+
+template<class TBv>
+void SplitterByMedian<TBv>::prepare(const SVertex* vertices, const unsigned* begin, const unsigned* end)
+{
+    TVertices values(end - begin);
+    for (unsigned i = 0; i < values.size(); ++i)
+    {
+        values[i] = vertices[begin[i]];
+    }
+
+    if (!values.empty())
+    {
+        TVertices::iterator middle = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), middle, values.end(), [this](const SVertex& a, const SVertex& b) { return less(a, b); });
+        mMedian = *middle;
+    }
+}
+
+template<class TBv>
+bool SplitterByMedian<TBv>::isLeft(const SVertex& vertex) const
+{
+    return less(vertex, mMedian);
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_SPLITTERBYMEDIAN
@@ -0,0 +1,375 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GKU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_SPLITTERBYSAH
+#define BVH3_SPLITTERBYSAH
+
+#include "Splitter.hpp"
+#include "SplitterByCenter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace NBvh3
+{
+
+/**
+ * Template class to split vertices by binned surface area heuristic.
+ * Vertices are distributed to bins along x, y and z axes,
+ * the split between bins with minimal sum of areas of bounding volumes
+ * multiplied by number of vertices is chosen.
+ * Area is provided by TBv::getBoxSurfaceArea(), the same cost as used by getSurfaceAreaCost(),
+ * so diagonal planes of KDop do not change the cost.
+ */
+template<class TBv>
+class SplitterBySah : public Splitter<SplitterBySah<TBv> >
+{
+public:
+
+    /**
+     * Number of bins per axis.
+     */
+    static const unsigned BINS = 16;
+
+    /**
+     * Default constructor.
+     *
+     * @param Applied vertices to split.
+     * @param Bounding volume of applied vertices.
+     */
+    SplitterBySah(const TVertices& vertices, const TBv& bv);
+
+    /**
+     * Creates splitter without own vertices, only partition() could be used.
+     *
+     * @param Bounding volume of vertices to partition.
+     */
+    SplitterBySah(const TBv& bv);
+
+    /**
+     * @copydoc Splitter::split()
+     */
+    void split(TVertices& left, TVertices& right) const;
+
+    /**
+     * @copydoc Splitter::partition()
+     */
+    SVertex* partition(SVertex* begin, SVertex* end) const;
+
+    /**
+     * @copydoc Splitter::partition()
+     */
+    unsigned* partition(const SVertex* vertices, unsigned* begin, unsigned* end) const;
+
+    /**
+     * Finds the split plane of the range.
+     *
+     * @copydoc Splitter::prepare()
+     */
+    void prepare(const SVertex* vertices, const unsigned* begin, const unsigned* end);
+
+    /**
+     * @copydoc Splitter::isLeft()
+     */
+    bool isLeft(const SVertex& vertex) const;
+
+private:
+
+    /**
+     * Defines chosen split plane.
+     */
+    struct SPlane
+    {
+        /**
+         * Number of axis.
+         */
+        unsigned axis;
+
+        /**
+         * Last bin of the left part.
+         * BINS if vertices could not be split by bins.
+         */
+        unsigned bin;
+
+        /**
+         * Start of the first bin along the axis.
+         */
+        float min;
+
+        /**
+         * Number of bins per unit along the axis, see getScale().
+         */
+        float scale;
+    };
+
+    /**
+     * Returns index of bin of the value.
+     *
+     * @param Value along the axis.
+     * @param Start of the first bin along the axis.
+     * @param Number of bins per unit along the axis.
+     */
+    static unsigned getBin(float value, float min, float scale);
+
+    /**
+     * Returns number of bins per unit along the axis.
+     * 0 if the extent is too small to be split by bins, e.g. zero or denormal.
+     */
+    float getScale(unsigned axis) const;
+
+    /**
+     * Checks if the vertex is located left from the plane.
+     */
+    bool isLeft(const SVertex& vertex, const SPlane& plane) const;
+
+    /**
+     * Finds the plane with minimal cost.
+     *
+     * @param Number of vertices.
+     * @param Returns vertex by its number.
+     */
+    template<class TGetter>
+    SPlane findPlane(unsigned size, const TGetter& getter) const;
+
+    /**
+     * Submitted vertices.
+     * Could be 0 if only partition() is used.
+     */
+    const TVertices* mVertices;
+
+    /**
+     * Produces bounding volume of vertices.
+     */
+    const TBv& mBv;
+
+    /**
+     * Used if vertices could not be split by bins.
+     */
+    SplitterByCenter<TBv> mFallback;
+
+    /**
+     * Plane found by prepare().
+     */
+    SPlane mPlane;
+};
+
+template<class TBv>
+SplitterBySah<TBv>::SplitterBySah(const TVertices& vertices, const TBv& bv)
+    : mVertices(&vertices)
+    , mBv(bv)
+    , mFallback(bv)
+{
+    SPlane plane = {0, BINS, 0, 0};
+    mPlane = plane;
+}
+
+template<class TBv>
+SplitterBySah<TBv>::SplitterBySah(const TBv& bv)
+    : mVertices(0)
+    , mBv(bv)
+    , mFallback(bv)
+{
+    SPlane plane = {0, BINS, 0, 0};
+    mPlane = plane;
+}
+
+template<class TBv>
+unsigned SplitterBySah<TBv>::getBin(float value, float min, float scale)
+{
+    return std::min(unsigned((value - min) * scale), BINS - 1);
+}
+
+template<class TBv>
+float SplitterBySah<TBv>::getScale(unsigned axis) const
+{
+    // BINS / extent overflows to inf for denormal extents, inf * 0 is NaN and not a bin.
+    float extent = mBv.getMax(axis) - mBv.getMin(axis);
+    float scale = BINS / extent;
+    return extent > 0 && std::isfinite(scale) ? scale : 0;
+}
+
+template<class TBv>
+bool SplitterBySah<TBv>::isLeft(const SVertex& vertex, const SPlane& plane) const
+{
+    return getBin(vertex[plane.axis], plane.min, plane.scale) <= plane.bin;
+}
+
+template<class TBv>
+template<class TGetter>
+typename SplitterBySah<TBv>::SPlane SplitterBySah<TBv>::findPlane(unsigned size, const TGetter& getter) const
+{
+    SPlane result = {0, BINS, 0, 0};
+    float bestCost = std::numeric_limits<float>::max();
+    float mins[3];
+    float scales[3];
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        mins[axis] = mBv.getMin(axis);
+        scales[axis] = getScale(axis);
+    }
+
+    TBv bvs[3][BINS];
+    unsigned counts[3][BINS] = {{0}};
+    for (unsigned i = 0; i < size; ++i)
+    {
+        const SVertex& vertex = getter(i);
+        TBv point(vertex);
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+            unsigned bin = getBin(vertex[axis], mins[axis], scales[axis]);
+            bvs[axis][bin] += point;
+            ++counts[axis][bin];
+        }
+    }
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        // Areas and counts of right parts starting from bin.
+        // Areas are recomputed only after non empty bins.
+        float rightAreas[BINS];
+        unsigned rightCounts[BINS];
+        TBv right;
+        unsigned rightCount = 0;
+        float rightArea = 0;
+        for (unsigned bin = BINS - 1; bin > 0; --bin)
+        {
+            if (counts[axis][bin] != 0)
+            {
+                right += bvs[axis][bin];
+                rightCount += counts[axis][bin];
+                rightArea = right.getBoxSurfaceArea();
+            }
+
+            rightAreas[bin] = rightArea;
+            rightCounts[bin] = rightCount;
+        }
+
+        TBv left;
+        unsigned leftCount = 0;
+        float leftArea = 0;
+        for (unsigned bin = 0; bin + 1 < BINS; ++bin)
+        {
+            if (counts[axis][bin] == 0)
+            {
+                continue;
+            }
+
+            left += bvs[axis][bin];
+            leftCount += counts[axis][bin];
+            leftArea = left.getBoxSurfaceArea();
+            if (rightCounts[bin + 1] == 0)
+            {
+                continue;
+            }
+
+            float cost = leftArea * leftCount + rightAreas[bin + 1] * rightCounts[bin + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                result.axis = axis;
+                result.bin = bin;
+                result.min = mins[axis];
+                result.scale = scales[axis];
+            }
+        }
+    }
+
+    return result;
+}
+
+template<class TBv>
+void SplitterBySah<TBv>::split(TVertices& left, TVertices& right) const
+{
+    if (mVertices == 0)
+    {
+        return;
+    }
+
+    const TVertices& vertices = *mVertices;
+    SPlane plane = findPlane(
+        vertices.size(),
+        [&vertices](unsigned i) -> const SVertex& { return vertices[i]; }
+        );
+
+    if (plane.bin == BINS)
+    {
+        SplitterByCenter<TBv>(vertices, mBv).split(left, right);
+        return;
+    }
+
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        if (isLeft(vertices[i], plane))
+        {
+            left.push_back(vertices[i]);
+        }
+        else
+        {
+            right.push_back(vertices[i]);
+        }
+    }
+}
+
+template<class TBv>
+SVertex* SplitterBySah<TBv>::partition(SVertex* begin, SVertex* end) const
+{
+    SPlane plane = findPlane(
+        end - begin,
+        [begin](unsigned i) -> const SVertex& { return begin[i]; }
+        );
+
+    if (plane.bin == BINS)
+    {
+        return mFallback.partition(begin, end);
+    }
+
+    return std::partition(
+        begin,
+        end,
+        [this, &plane](const SVertex& vertex) { return isLeft(vertex, plane); }
+        );
+}
+
+template<class TBv>
+unsigned* SplitterBySah<TBv>::partition(const SVertex* vertices, unsigned* begin, unsigned* end) const
+{
+    SPlane plane = findPlane(
+        end - begin,
+        [vertices, begin](unsigned i) -> const SVertex& { return vertices[begin[i]]; }
+        );
+
+    if (plane.bin == BINS)
+    {
+        return mFallback.partition(vertices, begin, end);
+    }
+
+    return std::partition(
+        begin,
+        end,
+        [this, vertices, &plane](unsigned index) { return isLeft(vertices[index], plane); }
+        );
+}
+
+template<class TBv>
+void SplitterBySah<TBv>::prepare(const SVertex* vertices, const unsigned* begin, const unsigned* end)
+{
+    mPlane = findPlane(
+        end - begin,
+        [vertices, begin](unsigned i) -> const SVertex& { return vertices[begin[i]]; }
+        );
+}
+
+template<class TBv>
+bool SplitterBySah<TBv>::isLeft(const SVertex& vertex) const
+{
+    return mPlane.bin == BINS ? mFallback.isLeft(vertex) : isLeft(vertex, mPlane);
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_SPLITTERBYSAH
@@ -5,7 +5,11 @@
 
 #include <bvh3/bv/all.hpp>
 #include <bvh3/splitters/SplitterByCenter.hpp>
+#include <bvh3/splitters/SplitterByDirection.hpp>
+#include <bvh3/splitters/SplitterByMedian.hpp>
+#include <bvh3/splitters/SplitterBySah.hpp>
 #include <gtest/gtest.h>
+#include <type_traits>
 
 using namespace NBvh3;
 using namespace std;
@@ -29,3 +33,52 @@ TEST(SplitterByCenter, testSplit)
     EXPECT_EQ(SVertex(1, 5, 0), left[1]);
     EXPECT_EQ(SVertex(5, 4, 0), right[0]);
 }
+
+TEST(SplitterByCenter, testPartitionIndices)
+{
+    TVertices vertices =
+    {
+        {5, 4, 0},
+        {3, 1, 0},
+        {1, 5, 0}
+    };
+
+    unsigned indices[] = {0, 1, 2};
+    KDop<16> bv = createBoundingVolume<KDop<16> >(vertices);
+    SplitterByCenter<KDop<16> > s(bv);
+    unsigned* middle = s.partition(vertices.data(), indices, indices + 3);
+
+    EXPECT_EQ(2, middle - indices);
+    EXPECT_EQ(0, indices[2]);
+    EXPECT_TRUE(indices[0] == 1 || indices[0] == 2);
+    EXPECT_TRUE(indices[1] == 1 || indices[1] == 2);
+
+    // Vertices are not touched.
+    EXPECT_EQ(SVertex(5, 4, 0), vertices[0]);
+}
+
+TEST(SplitterByCenter, testStaticInterface)
+{
+    // Splitters are called by builders without virtual functions.
+    EXPECT_FALSE(is_polymorphic<SplitterByCenter<KDop<16> > >::value);
+    EXPECT_FALSE(is_polymorphic<SplitterByMedian<KDop<16> > >::value);
+    EXPECT_FALSE(is_polymorphic<SplitterBySah<KDop<16> > >::value);
+    EXPECT_FALSE(is_polymorphic<SplitterByDirection<KDop<16> > >::value);
+
+    // Default partition() is the same as isLeft().
+    TVertices vertices =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0},
+        {4, 2, 0}
+    };
+
+    SplitterByCenter<KDop<16> > s(createBoundingVolume<KDop<16> >(vertices));
+    SVertex* middle = s.partition(vertices.data(), vertices.data() + vertices.size());
+    ASSERT_EQ(2, middle - vertices.data());
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        EXPECT_EQ(i < 2, s.isLeft(vertices[i]));
+    }
+}
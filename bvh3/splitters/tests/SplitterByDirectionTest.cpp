@@ -0,0 +1,136 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/splitters/SplitterByDirection.hpp>
+#include <bvh3/splitters/SplitterByCenter.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <gtest/gtest.h>
+
+using namespace NBvh3;
+using namespace std;
+
+namespace
+{
+
+/**
+ * Two parallel rails along (1, 1, 0) separated along (1, -1, 0)
+ * by a bit less than their length, so x and y ranges of the rails overlap.
+ */
+TVertices getRails(unsigned count)
+{
+    TVertices result;
+    float shift = count * 0.8f;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float t = float(i);
+        result.push_back(SVertex(t, t, 0));
+        result.push_back(SVertex(t + shift, t - shift, 0));
+    }
+
+    return result;
+}
+
+} // namespace
+
+TEST(SplitterByDirection, testSplit)
+{
+    TVertices vertices =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0},
+        {4, 2, 0}
+    };
+
+    SplitterByDirection<KDop<16> > s(vertices, createBoundingVolume<KDop<16> >(vertices));
+    TVertices left, right;
+    s.split(left, right);
+
+    EXPECT_EQ(4, left.size() + right.size());
+    EXPECT_FALSE(left.empty());
+    EXPECT_FALSE(right.empty());
+}
+
+TEST(SplitterByDirection, testRails)
+{
+    TVertices vertices = getRails(100);
+    KDop<16> bv = createBoundingVolume<KDop<16> >(vertices);
+    SplitterByDirection<KDop<16> > s(vertices, bv);
+    TVertices left, right;
+    s.split(left, right);
+
+    // Rails are separated along (1, -1, 0).
+    ASSERT_EQ(100, left.size());
+    ASSERT_EQ(100, right.size());
+    for (unsigned i = 0; i < left.size(); ++i)
+    {
+        EXPECT_EQ(left[i].x, left[i].y);
+        EXPECT_EQ(right[i].x, right[i].y + 160);
+    }
+
+    // The center along x cuts both rails.
+    SplitterByCenter<KDop<16> > center(vertices, bv);
+    TVertices centerLeft, centerRight;
+    center.split(centerLeft, centerRight);
+    unsigned mixed = 0;
+    for (unsigned i = 0; i < centerLeft.size(); ++i)
+    {
+        mixed += centerLeft[i].x != centerLeft[i].y;
+    }
+
+    EXPECT_LT(0, mixed);
+    EXPECT_GT(centerLeft.size(), mixed);
+    EXPECT_LT(
+        SplitterByDirection<KDop<16> >::getWidth(createBoundingVolume<KDop<16> >(left)),
+        SplitterByDirection<KDop<16> >::getWidth(createBoundingVolume<KDop<16> >(centerLeft))
+        );
+}
+
+TEST(SplitterByDirection, testPartitionIndices)
+{
+    TVertices vertices = getRails(10);
+    vector<unsigned> indices(vertices.size());
+    for (unsigned i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = i;
+    }
+
+    KDop<16> bv = createBoundingVolume<KDop<16> >(vertices);
+    SplitterByDirection<KDop<16> > s(bv);
+    unsigned* begin = indices.data();
+    unsigned* end = begin + indices.size();
+    unsigned* middle = s.partition(vertices.data(), begin, end);
+    ASSERT_EQ(10, middle - begin);
+
+    // The same as isLeft() after prepare().
+    s.prepare(vertices.data(), begin, end);
+    for (unsigned i = 0; i < indices.size(); ++i)
+    {
+        EXPECT_EQ(i < 10, s.isLeft(vertices[indices[i]]));
+    }
+
+    // Coincident vertices are left to the builder.
+    TVertices coincident(4, SVertex(1, 1, 1));
+    SplitterByDirection<KDop<16> > c(createBoundingVolume<KDop<16> >(coincident));
+    SVertex* split = c.partition(coincident.data(), coincident.data() + 4);
+    EXPECT_TRUE(split == coincident.data() || split == coincident.data() + 4);
+}
+
+TEST(SplitterByDirection, testBuildTree)
+{
+    TVertices vertices = getRails(1000);
+
+    FlatTree<KDop<16> > tree;
+    buildTree<KDop<16>, SplitterByDirection<KDop<16> > >(vertices, tree);
+    EXPECT_EQ(vertices.size() * 2 - 1, tree.getNodes().size());
+
+    auto root = buildTree<KDop<16>, SplitterByDirection<KDop<16> > >(vertices);
+    EXPECT_FALSE(root->getLeft()->getBoundingVolume().overlapped(root->getRight()->getBoundingVolume()));
+    EXPECT_EQ(1000, root->getLeft()->getVertices().size());
+    delete root;
+}
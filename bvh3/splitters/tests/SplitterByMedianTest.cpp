@@ -0,0 +1,139 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/splitters/SplitterByMedian.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <bvh3/tests/TestHelpers.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace NBvh3;
+using namespace std;
+
+TEST(SplitterByMedian, testSplit)
+{
+    TVertices vertices =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0},
+        {4, 2, 0}
+    };
+
+    // The longest axis is x, the median is 4.
+    SplitterByMedian<KDop<16> > s(vertices, createBoundingVolume<KDop<16> >(vertices));
+    TVertices left, right;
+    s.split(left, right);
+
+    ASSERT_EQ(2, left.size());
+    ASSERT_EQ(2, right.size());
+    EXPECT_GT(4, left[0].x);
+    EXPECT_GT(4, left[1].x);
+    EXPECT_LE(4, right[0].x);
+    EXPECT_LE(4, right[1].x);
+}
+
+TEST(SplitterByMedian, testPartitionIndices)
+{
+    // Skewed along y, the center would leave one vertex on the right.
+    TVertices vertices =
+    {
+        {0, 100, 0},
+        {0, 3, 0},
+        {0, 1, 0},
+        {0, 2, 0},
+        {0, 0, 0}
+    };
+
+    unsigned indices[] = {0, 1, 2, 3, 4};
+    KDop<16> bv = createBoundingVolume<KDop<16> >(vertices);
+    SplitterByMedian<KDop<16> > s(bv);
+    unsigned* middle = s.partition(vertices.data(), indices, indices + 5);
+
+    ASSERT_EQ(2, middle - indices);
+    EXPECT_EQ(4, max(indices[0], indices[1]));
+    EXPECT_EQ(2, min(indices[0], indices[1]));
+
+    // The same as isLeft() after prepare().
+    s.prepare(vertices.data(), indices, indices + 5);
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(i < 2, s.isLeft(vertices[indices[i]]));
+    }
+}
+
+TEST(SplitterByMedian, testDuplicates)
+{
+    TVertices vertices(5, SVertex(1, 1, 1));
+    vertices.push_back(SVertex(0, 0, 0));
+
+    // Vertices are split by position, coincident ones too.
+    SplitterByMedian<KDop<16> > s(createBoundingVolume<KDop<16> >(vertices));
+    SVertex* middle = s.partition(vertices.data(), vertices.data() + vertices.size());
+    ASSERT_EQ(3, middle - vertices.data());
+    EXPECT_EQ(SVertex(0, 0, 0), *std::min_element(vertices.data(), middle, [](const SVertex& a, const SVertex& b) { return a.x < b.x; }));
+
+    TVertices coincident(4, SVertex(1, 1, 1));
+    EXPECT_EQ(coincident.data() + 2, s.partition(coincident.data(), coincident.data() + 4));
+}
+
+TEST(SplitterByMedian, testTiedAxisValues)
+{
+    // Distinct vertices of grids share values along every axis, ties are ordered by other axes.
+    unsigned sizes[] = {10, 16, 47};
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        TVertices vertices = getGrid(sizes[i], i);
+        unsigned count = vertices.size();
+
+        FlatTree<KDop<16> > tree;
+        buildTree<KDop<16>, SplitterByMedian<KDop<16> > >(vertices, tree);
+        EXPECT_EQ(getBalancedDepth(count) + 1, getDepth(tree));
+
+        auto root = buildTree<KDop<16>, SplitterByMedian<KDop<16> > >(vertices);
+        EXPECT_EQ(getBalancedDepth(count) + 1, getDepth(root));
+        delete root;
+    }
+
+    // isLeft() after prepare() splits the same vertices as partition().
+    TVertices vertices = getGrid(6, 3);
+    vector<unsigned> indices(vertices.size());
+    for (unsigned i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = i;
+    }
+
+    SplitterByMedian<KDop<16> > s(createBoundingVolume<KDop<16> >(vertices));
+    s.prepare(vertices.data(), indices.data(), indices.data() + indices.size());
+    unsigned* middle = s.partition(vertices.data(), indices.data(), indices.data() + indices.size());
+    ASSERT_EQ(indices.size() / 2, middle - indices.data());
+    for (unsigned i = 0; i < indices.size(); ++i)
+    {
+        EXPECT_EQ(i < indices.size() / 2, s.isLeft(vertices[indices[i]]));
+    }
+}
+
+TEST(SplitterByMedian, testBalancedTree)
+{
+    // Exponentially skewed distinct vertices.
+    TVertices vertices;
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        vertices.push_back(SVertex(std::pow(1.01f, float(i)), 0, 0));
+    }
+
+    FlatTree<KDop<16> > tree;
+    buildTree<KDop<16>, SplitterByMedian<KDop<16> > >(vertices, tree);
+    EXPECT_EQ(11, getDepth(tree));
+
+    auto root = buildTree<KDop<16>, SplitterByMedian<KDop<16> > >(vertices);
+    EXPECT_EQ(500, root->getLeft()->getVertices().size());
+    delete root;
+}
@@ -0,0 +1,178 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/splitters/SplitterBySah.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+
+TEST(SplitterBySah, testSplit)
+{
+    TVertices vertices =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    SplitterBySah<TKDop16> s(vertices, bv);
+    TVertices left, right;
+    s.split(left, right);
+
+    EXPECT_EQ(3, left.size() + right.size());
+    EXPECT_FALSE(left.empty());
+    EXPECT_FALSE(right.empty());
+}
+
+TEST(SplitterBySah, testPartitionClusters)
+{
+    // Long sparse cluster along x and a dense one far by y.
+    // Center of x would cut the first cluster, SAH separates clusters.
+    TVertices vertices;
+    for (unsigned i = 0; i < 20; ++i)
+    {
+        vertices.push_back(SVertex(i * 10, 0, 0));
+        vertices.push_back(SVertex(i * 0.1f, 50, 0));
+    }
+
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    SplitterBySah<TKDop16> s(bv);
+    SVertex* middle = s.partition(vertices.data(), vertices.data() + vertices.size());
+
+    ASSERT_EQ(20, middle - vertices.data());
+    for (unsigned i = 1; i < 20; ++i)
+    {
+        EXPECT_EQ(vertices[0].y, vertices[i].y);
+        EXPECT_EQ(vertices[20].y, vertices[20 + i].y);
+    }
+}
+
+TEST(SplitterBySah, testPartitionIndices)
+{
+    TVertices vertices =
+    {
+        {0, 0, 0},
+        {100, 0, 0},
+        {1, 0, 0},
+        {101, 0, 0}
+    };
+
+    unsigned indices[] = {0, 1, 2, 3};
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    SplitterBySah<TKDop16> s(bv);
+    unsigned* middle = s.partition(vertices.data(), indices, indices + 4);
+
+    ASSERT_EQ(2, middle - indices);
+    EXPECT_GT(50, vertices[indices[0]].x);
+    EXPECT_GT(50, vertices[indices[1]].x);
+    EXPECT_LT(50, vertices[indices[2]].x);
+    EXPECT_LT(50, vertices[indices[3]].x);
+}
+
+TEST(SplitterBySah, testPrepare)
+{
+    TVertices vertices;
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> distribution(0, 100);
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        vertices.push_back(SVertex(distribution(generator), distribution(generator) * 0.1f, 0));
+    }
+
+    vector<unsigned> indices(vertices.size());
+    for (unsigned i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = i;
+    }
+
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    SplitterBySah<TKDop16> s(bv);
+    s.prepare(vertices.data(), indices.data(), indices.data() + indices.size());
+    unsigned* middle = s.partition(vertices.data(), indices.data(), indices.data() + indices.size());
+
+    for (unsigned* i = indices.data(); i != middle; ++i)
+    {
+        EXPECT_TRUE(s.isLeft(vertices[*i]));
+    }
+
+    for (unsigned* i = middle; i != indices.data() + indices.size(); ++i)
+    {
+        EXPECT_FALSE(s.isLeft(vertices[*i]));
+    }
+}
+
+TEST(SplitterBySah, testPartitionCloseVertices)
+{
+    TVertices vertices =
+    {
+        {0, 0, 0},
+        {0.001f, 0, 0},
+        {100, 0, 0}
+    };
+
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    SplitterBySah<TKDop16> s(bv);
+    SVertex* middle = s.partition(vertices.data(), vertices.data() + 3);
+    EXPECT_EQ(2, middle - vertices.data());
+
+    TVertices close(vertices.begin(), vertices.begin() + 2);
+    TKDop16 closeBv = createBoundingVolume<TKDop16>(close);
+    SplitterBySah<TKDop16> closeSplitter(closeBv);
+    middle = closeSplitter.partition(close.data(), close.data() + 2);
+    EXPECT_EQ(1, middle - close.data());
+}
+
+TEST(SplitterBySah, testPartitionDenormalExtent)
+{
+    // Extent along x is denormal, its bins would be computed by infinite scale.
+    TVertices vertices;
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        vertices.push_back(SVertex(i % 2 ? 1e-40f : 0, i, 0));
+    }
+
+    TKDop16 bv = createBoundingVolume<TKDop16>(vertices);
+    SplitterBySah<TKDop16> s(bv);
+    SVertex* middle = s.partition(vertices.data(), vertices.data() + vertices.size());
+    ASSERT_LT(0, middle - vertices.data());
+    ASSERT_GT(8, middle - vertices.data());
+
+    // Vertices are split along y.
+    for (SVertex* i = vertices.data(); i != middle; ++i)
+    {
+        for (SVertex* j = middle; j != vertices.data() + vertices.size(); ++j)
+        {
+            EXPECT_LT(i->y, j->y);
+        }
+    }
+}
+
+TEST(SplitterBySah, testBuildTree)
+{
+    TVertices vertices;
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> distribution(0, 100);
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        vertices.push_back(SVertex(distribution(generator), distribution(generator), distribution(generator)));
+    }
+
+    FlatTree<TKDop16> tree;
+    buildTree<TKDop16, SplitterBySah<TKDop16> >(vertices, tree);
+    EXPECT_EQ(2 * vertices.size() - 1, tree.getNodes().size());
+
+    FlatTree<TKDop16> other;
+    buildTree<TKDop16>(vertices, other);
+    FlatTree<TKDop16>::TCollidedNodes output;
+    EXPECT_TRUE(tree.collided(other, output));
+    EXPECT_EQ(vertices.size(), output.size());
+}
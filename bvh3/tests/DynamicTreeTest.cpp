@@ -0,0 +1,334 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/DynamicTree.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef DynamicTree<TKDop16> TTree;
+
+/**
+ * Checks links, heights and bounding volumes of the subtree.
+ *
+ * @return Number of leaves.
+ */
+unsigned validate(const TTree& tree, unsigned index)
+{
+    const TTree::TNodes& nodes = tree.getNodes();
+    const SDynamicNode<TKDop16>& node = nodes[index];
+    EXPECT_GE(node.height, 0);
+    if (node.left == TTree::NONE)
+    {
+        EXPECT_EQ(TTree::NONE, node.right);
+        EXPECT_EQ(0, node.height);
+        return 1;
+    }
+
+    const SDynamicNode<TKDop16>& left = nodes[node.left];
+    const SDynamicNode<TKDop16>& right = nodes[node.right];
+    EXPECT_EQ(index, left.parent);
+    EXPECT_EQ(index, right.parent);
+    EXPECT_EQ(1 + max(left.height, right.height), node.height);
+    EXPECT_TRUE(node.bv.contains(left.bv));
+    EXPECT_TRUE(node.bv.contains(right.bv));
+
+    return validate(tree, node.left) + validate(tree, node.right);
+}
+
+void validate(const TTree& tree)
+{
+    if (tree.getRoot() == TTree::NONE)
+    {
+        EXPECT_EQ(0, tree.size());
+        return;
+    }
+
+    EXPECT_EQ(TTree::NONE, tree.getNodes()[tree.getRoot()].parent);
+    EXPECT_EQ(tree.size(), validate(tree, tree.getRoot()));
+}
+
+TKDop16 createBox(const SVertex& center, float size)
+{
+    TKDop16 result;
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        result += SVertex(center.x + (i & 1 ? size : -size), center.y + (i & 2 ? size : -size), center.z + (i & 4 ? size : -size));
+    }
+
+    return result;
+}
+
+/**
+ * Compares the query against all objects.
+ */
+void checkQuery(const TTree& tree, const vector<unsigned>& proxies, const TKDop16& query)
+{
+    vector<unsigned> found;
+    tree.query(query, [&found](unsigned proxy) { found.push_back(proxy); return true; });
+
+    vector<unsigned> expected;
+    for (unsigned i = 0; i < proxies.size(); ++i)
+    {
+        if (tree.getBoundingVolume(proxies[i]).overlapped(query))
+        {
+            expected.push_back(proxies[i]);
+        }
+    }
+
+    sort(found.begin(), found.end());
+    sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, found);
+}
+
+TEST(DynamicTreeTest, testEmpty)
+{
+    TTree tree;
+    EXPECT_EQ(0, tree.size());
+    EXPECT_EQ(-1, tree.getHeight());
+    EXPECT_EQ(TTree::NONE, tree.getRoot());
+
+    unsigned visited = 0;
+    EXPECT_TRUE(tree.query(createBox(SVertex(0, 0, 0), 1), [&visited](unsigned) { ++visited; return true; }));
+    EXPECT_EQ(0, visited);
+}
+
+TEST(DynamicTreeTest, testInsertRemove)
+{
+    TTree tree(0.5f);
+    unsigned a = tree.insert(createBox(SVertex(0, 0, 0), 1), 10);
+    EXPECT_EQ(0, tree.getHeight());
+    EXPECT_EQ(10, tree.getData(a));
+    EXPECT_FLOAT_EQ(-1.5f, tree.getBoundingVolume(a).getMin(0));
+
+    unsigned b = tree.insert(createBox(SVertex(5, 0, 0), 1), 20);
+    EXPECT_EQ(1, tree.getHeight());
+    EXPECT_EQ(2, tree.size());
+    validate(tree);
+
+    vector<unsigned> found;
+    tree.query(createBox(SVertex(5, 0, 0), 0.1f), [&found](unsigned proxy) { found.push_back(proxy); return true; });
+    EXPECT_EQ(vector<unsigned>(1, b), found);
+
+    tree.remove(a);
+    EXPECT_EQ(0, tree.getHeight());
+    EXPECT_EQ(b, tree.getRoot());
+    validate(tree);
+
+    // Released nodes are reused.
+    unsigned nodes = tree.getNodes().size();
+    tree.insert(createBox(SVertex(1, 0, 0), 1), 30);
+    EXPECT_EQ(nodes, tree.getNodes().size());
+    validate(tree);
+}
+
+TEST(DynamicTreeTest, testMove)
+{
+    TTree tree(0.5f);
+    unsigned a = tree.insert(createBox(SVertex(0, 0, 0), 1), 0);
+    tree.insert(createBox(SVertex(5, 0, 0), 1), 1);
+
+    // Still inside the inflated bounding volume.
+    EXPECT_FALSE(tree.move(a, createBox(SVertex(0.4f, -0.4f, 0.2f), 1)));
+    EXPECT_FLOAT_EQ(-1.5f, tree.getBoundingVolume(a).getMin(0));
+
+    EXPECT_TRUE(tree.move(a, createBox(SVertex(10, 0, 0), 1)));
+    EXPECT_FLOAT_EQ(8.5f, tree.getBoundingVolume(a).getMin(0));
+    validate(tree);
+}
+
+TEST(DynamicTreeTest, testQueryStop)
+{
+    TTree tree;
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        tree.insert(createBox(SVertex(i, 0, 0), 1), i);
+    }
+
+    unsigned visited = 0;
+    EXPECT_FALSE(tree.query(createBox(SVertex(5, 0, 0), 10), [&visited](unsigned) { return ++visited < 3; }));
+    EXPECT_EQ(3, visited);
+}
+
+TEST(DynamicTreeTest, testChurn)
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> position(0, 100);
+    std::uniform_real_distribution<float> step(-1, 1);
+
+    TTree tree(0.5f);
+    vector<SVertex> centers;
+    vector<unsigned> proxies;
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        centers.push_back(SVertex(position(generator), position(generator), position(generator)));
+        proxies.push_back(tree.insert(createBox(centers.back(), 0.5f), i));
+    }
+
+    validate(tree);
+    EXPECT_LE(tree.getHeight(), 2 * std::log2(1000.0f));
+
+    for (unsigned frame = 0; frame < 10; ++frame)
+    {
+        // Removes and inserts some objects, moves others.
+        for (unsigned i = 0; i < proxies.size(); ++i)
+        {
+            if (i % 10 == frame)
+            {
+                tree.remove(proxies[i]);
+                centers[i] = SVertex(position(generator), position(generator), position(generator));
+                proxies[i] = tree.insert(createBox(centers[i], 0.5f), i);
+            }
+            else
+            {
+                centers[i] = SVertex(centers[i].x + step(generator), centers[i].y + step(generator), centers[i].z + step(generator));
+                tree.move(proxies[i], createBox(centers[i], 0.5f));
+            }
+
+            EXPECT_TRUE(tree.getBoundingVolume(proxies[i]).contains(createBox(centers[i], 0.5f)));
+        }
+
+        validate(tree);
+        EXPECT_EQ(1000, tree.size());
+        EXPECT_LE(tree.getHeight(), 2 * std::log2(1000.0f));
+        for (unsigned i = 0; i < 10; ++i)
+        {
+            checkQuery(tree, proxies, createBox(SVertex(position(generator), position(generator), position(generator)), 10));
+        }
+    }
+
+    for (unsigned i = 0; i < proxies.size(); ++i)
+    {
+        EXPECT_EQ(i, tree.getData(proxies[i]));
+    }
+
+    // Removes all but one.
+    for (unsigned i = 1; i < proxies.size(); ++i)
+    {
+        tree.remove(proxies[i]);
+    }
+
+    validate(tree);
+    EXPECT_EQ(1, tree.size());
+    EXPECT_EQ(0, tree.getHeight());
+}
+
+TEST(DynamicTreeTest, testSortedInsertions)
+{
+    // Objects inserted along a line would make a list without rotations.
+    TTree tree(0);
+    for (unsigned i = 0; i < 1024; ++i)
+    {
+        tree.insert(createBox(SVertex(i, 0, 0), 0.4f), i);
+    }
+
+    validate(tree);
+    EXPECT_LE(tree.getHeight(), 15);
+}
+
+TEST(DynamicTreeTest, testInsertManyDepth)
+{
+    // Clusters of coincident boxes along a line, distances between them grow twice.
+    vector<TKDop16> bvs;
+    vector<unsigned> data;
+    for (unsigned i = 0; i < 20000; ++i)
+    {
+        float t = std::ldexp(1.0f, -int(i % 40));
+        bvs.push_back(createBox(SVertex(t, 0, 2 * t), 0));
+        data.push_back(i);
+    }
+
+    TTree tree(0);
+    vector<unsigned> proxies;
+    tree.insertMany(bvs, data, proxies);
+    validate(tree);
+    EXPECT_GE(int(getDepthLimit(20000)), tree.getHeight());
+}
+
+TEST(DynamicTreeTest, testInsertManyRemoveMany)
+{
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> position(0, 100);
+
+    TTree tree(0.1f);
+    vector<unsigned> proxies;
+    tree.insertMany(vector<TKDop16>(), vector<unsigned>(), proxies);
+    EXPECT_EQ(0, tree.size());
+    EXPECT_TRUE(proxies.empty());
+
+    for (unsigned i = 0; i < 500; ++i)
+    {
+        proxies.push_back(tree.insert(createBox(SVertex(position(generator), position(generator), position(generator)), 0.5f), i));
+    }
+
+    // Streams a level in: a batch in a corner and one over the whole space with duplicates.
+    for (unsigned batch = 0; batch < 2; ++batch)
+    {
+        vector<TKDop16> bvs;
+        vector<unsigned> data;
+        for (unsigned i = 0; i < 2000; ++i)
+        {
+            float scale = batch == 0 ? 0.2f : 1;
+            SVertex center(position(generator) * scale, position(generator) * scale, i % 3 == 0 ? 50 : position(generator));
+            bvs.push_back(createBox(i % 10 == 0 ? SVertex(1, 1, 1) : center, 0.5f));
+            data.push_back(proxies.size() + i);
+        }
+
+        tree.insertMany(bvs, data, proxies);
+        validate(tree);
+        for (unsigned i = 0; i < bvs.size(); ++i)
+        {
+            EXPECT_TRUE(tree.getBoundingVolume(proxies[proxies.size() - bvs.size() + i]).contains(bvs[i]));
+        }
+    }
+
+    EXPECT_EQ(4500, tree.size());
+    EXPECT_LE(tree.getHeight(), 2 * std::log2(4500.0f));
+    for (unsigned i = 0; i < proxies.size(); ++i)
+    {
+        EXPECT_EQ(i, tree.getData(proxies[i]));
+    }
+
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        checkQuery(tree, proxies, createBox(SVertex(position(generator), position(generator), position(generator)), 10));
+    }
+
+    // Unloads every third object and then the first batch.
+    vector<unsigned> removed;
+    vector<unsigned> kept;
+    for (unsigned i = 0; i < proxies.size(); ++i)
+    {
+        (i % 3 == 0 || (i >= 500 && i < 2500) ? removed : kept).push_back(proxies[i]);
+    }
+
+    tree.removeMany(removed);
+    validate(tree);
+    EXPECT_EQ(kept.size(), tree.size());
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        checkQuery(tree, kept, createBox(SVertex(position(generator), position(generator), position(generator)), 10));
+    }
+
+    tree.insert(createBox(SVertex(0, 0, 0), 1), 0);
+    validate(tree);
+
+    tree.removeMany(vector<unsigned>(1, kept[0]));
+    kept.erase(kept.begin());
+    validate(tree);
+
+    // Repeated proxies are removed once.
+    kept.push_back(kept.back());
+    tree.removeMany(kept);
+    EXPECT_EQ(1, tree.size());
+    EXPECT_EQ(0, tree.getHeight());
+    validate(tree);
+}
@@ -0,0 +1,605 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/Node.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <bvh3/splitters/SplitterBySah.hpp>
+#include <bvh3/tests/TestHelpers.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TFlatTreeKDop16;
+
+/**
+ * Checks that flat subtree equals to pointer based subtree.
+ */
+void expectEqualTrees(const TFlatTreeKDop16& tree, unsigned node, const Node<TKDop16>* root)
+{
+    ASSERT_TRUE(root != 0);
+    EXPECT_EQ(root->isLeaf(), tree.isLeaf(node));
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        EXPECT_EQ(root->getBoundingVolume().getMin(i), tree.getBoundingVolume(node).getMin(i));
+        EXPECT_EQ(root->getBoundingVolume().getMax(i), tree.getBoundingVolume(node).getMax(i));
+    }
+
+    if (tree.isLeaf(node))
+    {
+        EXPECT_EQ(1, tree.getVertices(node).size());
+        EXPECT_EQ(root->getVertices()[0], tree.getVertices(node)[0]);
+    }
+    else
+    {
+        expectEqualTrees(tree, tree.getLeft(node), root->getLeft());
+        expectEqualTrees(tree, tree.getRight(node), root->getRight());
+    }
+}
+
+/**
+ * Moves every vertex by a wave depending on its position.
+ */
+TVertices deform(const TVertices& vertices, float time)
+{
+    TVertices result(vertices);
+    for (unsigned i = 0; i < result.size(); ++i)
+    {
+        result[i].x += std::sin(result[i].y + time);
+        result[i].z += std::cos(result[i].x * 0.5f + time);
+    }
+
+    return result;
+}
+
+TEST(FlatTreeTest, testBuildTree)
+{
+    TVertices triangle =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(triangle, tree);
+
+    ASSERT_EQ(5, tree.getNodes().size());
+    EXPECT_EQ(5, tree.getNodes().capacity());
+    EXPECT_EQ(1, tree.getBoundingVolume(0).getMin(0));
+    EXPECT_EQ(5, tree.getBoundingVolume(0).getMax(0));
+    EXPECT_FALSE(tree.isLeaf(0));
+
+    // Left child is next to its parent.
+    EXPECT_EQ(1, tree.getLeft(0));
+    EXPECT_EQ(4, tree.getRight(0));
+    EXPECT_FALSE(tree.isLeaf(1));
+    EXPECT_EQ(2, tree.getLeft(1));
+    EXPECT_EQ(3, tree.getRight(1));
+
+    EXPECT_TRUE(tree.isLeaf(2));
+    EXPECT_EQ(SVertex(3, 1, 0), tree.getVertices(2)[0]);
+    EXPECT_TRUE(tree.isLeaf(3));
+    EXPECT_EQ(SVertex(1, 5, 0), tree.getVertices(3)[0]);
+    EXPECT_TRUE(tree.isLeaf(4));
+    EXPECT_EQ(1, tree.getVertices(4).size());
+    EXPECT_EQ(SVertex(5, 4, 0), tree.getVertices(4)[0]);
+
+    ASSERT_EQ(3, tree.getIndices().size());
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(triangle[tree.getIndices()[i]], tree.getVertices()[i]);
+    }
+}
+
+TEST(FlatTreeTest, testBuildTreeEmpty)
+{
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(TVertices(), tree);
+    EXPECT_TRUE(tree.empty());
+
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_FALSE(tree.collided(tree, output));
+    EXPECT_EQ(0, output.size());
+}
+
+TEST(FlatTreeTest, testBuildTreeEqualsNode)
+{
+    TVertices vertices = getGrid(8, 1);
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(vertices, tree);
+    auto root = buildTree<TKDop16>(vertices);
+
+    EXPECT_EQ(2 * vertices.size() - 1, tree.getNodes().size());
+    expectEqualTrees(tree, 0, root);
+
+    delete root;
+}
+
+/**
+ * Returns collinear vertices clustered at exponentially closer points, each one many times.
+ */
+TVertices getSkewedLine(unsigned size)
+{
+    TVertices result(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        float t = std::ldexp(1.0f, -int(i % 120));
+        result[i] = SVertex(t, 2 * t, 3 * t);
+    }
+
+    return result;
+}
+
+/**
+ * Checks that every vertex is in exactly one leaf.
+ */
+void expectAllVertices(const TFlatTreeKDop16& tree, unsigned size)
+{
+    vector<unsigned> indices = tree.getIndices();
+    ASSERT_EQ(size, indices.size());
+    sort(indices.begin(), indices.end());
+    for (unsigned i = 0; i < size; ++i)
+    {
+        ASSERT_EQ(i, indices[i]);
+    }
+
+    unsigned leaves = 0;
+    for (unsigned i = 0; i < tree.getNodes().size(); ++i)
+    {
+        leaves += tree.isLeaf(i) ? tree.getVertices(i).size() : 0;
+    }
+
+    EXPECT_EQ(size, leaves);
+}
+
+TEST(FlatTreeTest, testBuildTreeCoincident)
+{
+    unsigned size = 1 << 20;
+    TVertices vertices(size, SVertex(1, 2, 3));
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(vertices, tree);
+
+    // Split by halves into a balanced tree.
+    EXPECT_EQ(21, getDepth(tree));
+    expectAllVertices(tree, size);
+
+    buildTree<TKDop16>(TVertices(1000, SVertex(0, 0, 0)), tree, 4);
+    EXPECT_EQ(9, getDepth(tree));
+    expectAllVertices(tree, 1000);
+}
+
+TEST(FlatTreeTest, testBuildTreeCollinear)
+{
+    unsigned size = 1 << 20;
+    TVertices vertices = getSkewedLine(size);
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(vertices, tree);
+
+    EXPECT_GE(getDepthLimit(size) + 1, getDepth(tree));
+    expectAllVertices(tree, size);
+
+    vertices = getSkewedLine(100000);
+    buildTree<TKDop16, SplitterBySah<TKDop16> >(vertices, tree, 2);
+    EXPECT_GE(getDepthLimit(100000) + 1, getDepth(tree));
+    expectAllVertices(tree, 100000);
+}
+
+TEST(FlatTreeTest, testRelocatable)
+{
+    TVertices vertices = getGrid(4, 1);
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(vertices, tree);
+
+    TFlatTreeKDop16 copy(tree);
+    TFlatTreeKDop16 moved(std::move(tree));
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(copy.collided(moved, output));
+    EXPECT_EQ(vertices.size(), output.size());
+}
+
+TEST(FlatTreeTest, testCollidedNeg)
+{
+    TVertices triangle1 =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    TVertices triangle2 =
+    {
+        {2, 1, 0},
+        {0, 2, 0},
+        {0, 1, 0}
+    };
+
+    TFlatTreeKDop16 tree1;
+    TFlatTreeKDop16 tree2;
+    buildTree<TKDop16>(triangle1, tree1);
+    buildTree<TKDop16>(triangle2, tree2);
+
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_FALSE(tree1.collided(tree2, output));
+    EXPECT_EQ(0, output.size());
+}
+
+TEST(FlatTreeTest, testCollidedTriangles)
+{
+    TVertices triangle1 =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    TVertices triangle2 =
+    {
+        {3, 1, 0},
+        {4, 2, 0},
+        {6, 1, 0}
+    };
+
+    TFlatTreeKDop16 tree1;
+    TFlatTreeKDop16 tree2;
+    buildTree<TKDop16>(triangle1, tree1);
+    buildTree<TKDop16>(triangle2, tree2);
+
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(tree1.collided(tree2, output));
+    ASSERT_EQ(1, output.size());
+    EXPECT_EQ(SVertex(3, 1, 0), tree1.getVertices(output[0].first)[0]);
+    EXPECT_EQ(SVertex(3, 1, 0), tree2.getVertices(output[0].second)[0]);
+}
+
+TEST(FlatTreeTest, testCollidedGrids)
+{
+    TVertices grid = getGrid(10, 2);
+    TVertices vertices1(grid.begin(), grid.begin() + 600);
+    TVertices vertices2(grid.begin() + 400, grid.end());
+
+    TFlatTreeKDop16 tree1;
+    TFlatTreeKDop16 tree2;
+    buildTree<TKDop16>(vertices1, tree1);
+    buildTree<TKDop16>(vertices2, tree2);
+
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(tree1.collided(tree2, output));
+
+    // Only the same vertices overlap.
+    EXPECT_EQ(200, output.size());
+    for (unsigned i = 0; i < output.size(); ++i)
+    {
+        EXPECT_TRUE(tree1.isLeaf(output[i].first));
+        EXPECT_TRUE(tree2.isLeaf(output[i].second));
+        EXPECT_EQ(tree1.getVertices(output[i].first)[0], tree2.getVertices(output[i].second)[0]);
+    }
+}
+
+TEST(FlatTreeTest, testRefitSameVertices)
+{
+    TVertices vertices = getGrid(8, 3);
+    TFlatTreeKDop16 expected;
+    buildTree<TKDop16>(vertices, expected);
+
+    TFlatTreeKDop16 tree(expected);
+    EXPECT_TRUE(tree.refit(vertices));
+    expectEqualTrees(expected, tree);
+}
+
+TEST(FlatTreeTest, testRefitWrongSize)
+{
+    TVertices vertices = getGrid(8, 3);
+    TFlatTreeKDop16 expected;
+    buildTree<TKDop16>(vertices, expected);
+    TFlatTreeKDop16 tree(expected);
+
+    TVertices deformed = deform(vertices, 1);
+    deformed.pop_back();
+    EXPECT_FALSE(tree.refit(deformed));
+    expectEqualTrees(expected, tree);
+
+    TaskPool pool(2);
+    EXPECT_FALSE(tree.refit(deformed, pool, 1));
+    EXPECT_FALSE(tree.refit(TVertices(), pool, 1));
+    expectEqualTrees(expected, tree);
+
+    TFlatTreeKDop16 empty;
+    EXPECT_TRUE(empty.refit(TVertices()));
+    EXPECT_FALSE(empty.refit(vertices));
+}
+
+TEST(FlatTreeTest, testRefit)
+{
+    TVertices vertices = getGrid(8, 4);
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(vertices, tree);
+    TFlatTreeKDop16::TNodes nodes = tree.getNodes();
+
+    TVertices deformed = deform(vertices, 1);
+    tree.refit(deformed);
+
+    ASSERT_EQ(nodes.size(), tree.getNodes().size());
+    for (unsigned i = 0; i < nodes.size(); ++i)
+    {
+        EXPECT_EQ(nodes[i].index, tree.getNodes()[i].index);
+        EXPECT_EQ(nodes[i].count, tree.getNodes()[i].count);
+
+        TKDop16 expected;
+        if (tree.isLeaf(i))
+        {
+            expected += tree.getVertices(i)[0];
+            EXPECT_EQ(deformed[tree.getIndices()[nodes[i].index]], tree.getVertices(i)[0]);
+        }
+        else
+        {
+            expected = tree.getBoundingVolume(tree.getLeft(i)) + tree.getBoundingVolume(tree.getRight(i));
+        }
+
+        for (unsigned axis = 0; axis < 8; ++axis)
+        {
+            EXPECT_EQ(expected.getMin(axis), tree.getBoundingVolume(i).getMin(axis));
+            EXPECT_EQ(expected.getMax(axis), tree.getBoundingVolume(i).getMax(axis));
+        }
+    }
+
+    TFlatTreeKDop16 query;
+    buildTree<TKDop16>(deformed, query);
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(tree.collided(query, output));
+    EXPECT_EQ(deformed.size(), output.size());
+}
+
+TEST(FlatTreeTest, testRefitParallel)
+{
+    TVertices vertices = getGrid(12, 5);
+    TFlatTreeKDop16 expected;
+    buildTree<TKDop16>(vertices, expected);
+    TFlatTreeKDop16 tree(expected);
+
+    TVertices deformed = deform(vertices, 2);
+    expected.refit(deformed);
+
+    TaskPool pool(4);
+    tree.refit(deformed, pool, 16);
+    expectEqualTrees(expected, tree);
+
+    tree.refit(vertices, pool, 1);
+    expected.refit(vertices);
+    expectEqualTrees(expected, tree);
+}
+
+TEST(FlatTreeTest, testMaxLeafSize)
+{
+    TVertices vertices = getGrid(10, 6);
+    for (unsigned maxLeafSize = 1; maxLeafSize <= 16; maxLeafSize *= 2)
+    {
+        TFlatTreeKDop16 tree;
+        buildTree<TKDop16>(vertices, tree, maxLeafSize);
+
+        unsigned leaves = 0;
+        unsigned count = 0;
+        for (unsigned i = 0; i < tree.getNodes().size(); ++i)
+        {
+            if (tree.isLeaf(i))
+            {
+                ++leaves;
+                count += tree.getVertices(i).size();
+                EXPECT_GE(maxLeafSize, tree.getVertices(i).size());
+                EXPECT_EQ(count, tree.getNodes()[i].index + tree.getVertices(i).size());
+            }
+        }
+
+        EXPECT_EQ(vertices.size(), count);
+        EXPECT_EQ(2 * leaves - 1, tree.getNodes().size());
+        if (maxLeafSize > 1)
+        {
+            EXPECT_GT(2 * vertices.size() - 1, tree.getNodes().size());
+        }
+    }
+}
+
+TEST(FlatTreeTest, testCollidedLeaves)
+{
+    TVertices grid = getGrid(10, 7);
+    TVertices vertices1(grid.begin(), grid.begin() + 600);
+    TVertices vertices2(grid.begin() + 400, grid.end());
+
+    for (unsigned maxLeafSize = 1; maxLeafSize <= 16; maxLeafSize *= 2)
+    {
+        TFlatTreeKDop16 tree1;
+        TFlatTreeKDop16 tree2;
+        buildTree<TKDop16>(vertices1, tree1, maxLeafSize);
+        buildTree<TKDop16>(vertices2, tree2, 3);
+
+        TFlatTreeKDop16::TCollidedNodes output;
+        EXPECT_TRUE(tree1.collided(tree2, output));
+
+        // Every common vertex is found in a pair of leaves.
+        unsigned found = 0;
+        for (unsigned i = 0; i < output.size(); ++i)
+        {
+            SVertexRange leaf1 = tree1.getVertices(output[i].first);
+            SVertexRange leaf2 = tree2.getVertices(output[i].second);
+            for (unsigned j = 0; j < leaf1.size(); ++j)
+            {
+                found += std::count(leaf2.begin(), leaf2.end(), leaf1[j]);
+            }
+        }
+
+        EXPECT_EQ(200, found);
+        for (unsigned i = 0; i < output.size(); ++i)
+        {
+            SVertexRange leaf1 = tree1.getVertices(output[i].first);
+            SVertexRange leaf2 = tree2.getVertices(output[i].second);
+            EXPECT_TRUE(std::find_first_of(leaf1.begin(), leaf1.end(), leaf2.begin(), leaf2.end()) != leaf1.end());
+        }
+    }
+}
+
+TEST(FlatTreeTest, testCollidedLeavesInterleaved)
+{
+    // Grids shifted by half of a cell have no equal vertices, but their leaves contain vertices of each other.
+    TVertices vertices1 = getGrid(8, 9);
+    TVertices vertices2(vertices1);
+    for (unsigned i = 0; i < vertices2.size(); ++i)
+    {
+        vertices2[i] = SVertex(vertices2[i].x + 0.5f, vertices2[i].y + 0.5f, vertices2[i].z + 0.5f);
+    }
+
+    vertices2.push_back(vertices1[10]);
+    for (unsigned maxLeafSize = 1; maxLeafSize <= 16; maxLeafSize *= 2)
+    {
+        TFlatTreeKDop16 tree1;
+        TFlatTreeKDop16 tree2;
+        buildTree<TKDop16>(vertices1, tree1, maxLeafSize);
+        buildTree<TKDop16>(vertices2, tree2, maxLeafSize);
+
+        TFlatTreeKDop16::TCollidedNodes output;
+        EXPECT_TRUE(tree1.collided(tree2, output));
+        ASSERT_EQ(1, output.size());
+        EXPECT_TRUE(tree1.intersects(tree2));
+
+        unsigned visited = 0;
+        tree1.visit(tree2, [&visited](unsigned index, unsigned queryIndex) {
+            EXPECT_EQ(10, index);
+            ++visited;
+            return true;
+        });
+
+        EXPECT_EQ(1, visited);
+    }
+}
+
+TEST(FlatTreeTest, testVisit)
+{
+    TVertices grid = getGrid(8, 8);
+    TVertices vertices1(grid.begin(), grid.begin() + 300);
+    TVertices vertices2(grid.begin() + 200, grid.end());
+
+    // Pairs of original indices of equal vertices.
+    vector<pair<unsigned, unsigned> > expected;
+    for (unsigned i = 0; i < vertices1.size(); ++i)
+    {
+        for (unsigned j = 0; j < vertices2.size(); ++j)
+        {
+            if (vertices1[i] == vertices2[j])
+            {
+                expected.push_back(make_pair(i, j));
+            }
+        }
+    }
+
+    for (unsigned maxLeafSize = 1; maxLeafSize <= 8; maxLeafSize *= 2)
+    {
+        TFlatTreeKDop16 tree1;
+        TFlatTreeKDop16 tree2;
+        buildTree<TKDop16>(vertices1, tree1, maxLeafSize);
+        buildTree<TKDop16>(vertices2, tree2, maxLeafSize);
+
+        vector<pair<unsigned, unsigned> > pairs;
+        EXPECT_TRUE(tree1.visit(tree2, [&pairs](unsigned index, unsigned queryIndex) {
+            pairs.push_back(make_pair(index, queryIndex));
+            return true;
+        }));
+
+        std::sort(pairs.begin(), pairs.end());
+        EXPECT_EQ(expected, pairs);
+    }
+}
+
+TEST(FlatTreeTest, testVisitStop)
+{
+    TVertices vertices = getGrid(6, 9);
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(vertices, tree, 4);
+
+    unsigned visited = 0;
+    EXPECT_FALSE(tree.visit(tree, [&visited](unsigned index, unsigned queryIndex) { return ++visited < 5; }));
+    EXPECT_EQ(5, visited);
+
+    TFlatTreeKDop16 empty;
+    EXPECT_TRUE(tree.visit(empty, [](unsigned index, unsigned queryIndex) { return false; }));
+}
+
+TEST(FlatTreeTest, testIntersects)
+{
+    TVertices grid = getGrid(8, 3);
+    TVertices shifted(grid);
+    for (unsigned i = 0; i < shifted.size(); ++i)
+    {
+        shifted[i].x += 0.5f;
+    }
+
+    TVertices part(grid.begin() + 100, grid.begin() + 110);
+    for (unsigned maxLeafSize = 1; maxLeafSize <= 8; maxLeafSize *= 2)
+    {
+        TFlatTreeKDop16 tree;
+        TFlatTreeKDop16 shiftedTree;
+        TFlatTreeKDop16 partTree;
+        buildTree<TKDop16>(grid, tree, maxLeafSize);
+        buildTree<TKDop16>(shifted, shiftedTree, maxLeafSize);
+        buildTree<TKDop16>(part, partTree, maxLeafSize);
+
+        TFlatTreeKDop16::TCollidedNodes output;
+        EXPECT_EQ(tree.collided(shiftedTree, output), tree.intersects(shiftedTree));
+        EXPECT_EQ(tree.collided(partTree, output), tree.intersects(partTree));
+        EXPECT_TRUE(tree.intersects(partTree));
+        EXPECT_TRUE(partTree.intersects(tree));
+        EXPECT_TRUE(tree.intersects(tree));
+    }
+
+    TFlatTreeKDop16 tree;
+    TFlatTreeKDop16 shiftedTree;
+    TFlatTreeKDop16 empty;
+    buildTree<TKDop16>(grid, tree);
+    buildTree<TKDop16>(shifted, shiftedTree);
+    EXPECT_FALSE(tree.intersects(shiftedTree));
+    EXPECT_FALSE(tree.intersects(empty));
+    EXPECT_FALSE(empty.intersects(tree));
+}
+
+TEST(FlatTreeTest, testCollidedParallel)
+{
+    TVertices grid = getGrid(10, 4);
+    TVertices vertices1(grid.begin(), grid.begin() + 600);
+    TVertices vertices2(grid.begin() + 300, grid.end());
+    for (unsigned threads = 1; threads <= 4; threads *= 2)
+    {
+        TaskPool pool(threads);
+        for (unsigned maxLeafSize = 1; maxLeafSize <= 4; maxLeafSize *= 4)
+        {
+            TFlatTreeKDop16 tree1;
+            TFlatTreeKDop16 tree2;
+            buildTree<TKDop16>(vertices1, tree1, maxLeafSize);
+            buildTree<TKDop16>(vertices2, tree2, maxLeafSize);
+
+            TFlatTreeKDop16::TCollidedNodes expected;
+            TFlatTreeKDop16::TCollidedNodes output;
+            EXPECT_TRUE(tree1.collided(tree2, expected));
+            EXPECT_TRUE(tree1.collided(tree2, output, pool));
+            EXPECT_EQ(expected, output);
+
+            output.clear();
+            EXPECT_TRUE(tree1.collided(tree2, output, pool, 1000));
+            EXPECT_EQ(expected, output);
+        }
+    }
+
+    TaskPool pool(2);
+    TFlatTreeKDop16 tree;
+    TFlatTreeKDop16 empty;
+    buildTree<TKDop16>(grid, tree);
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_FALSE(tree.collided(empty, output, pool));
+    EXPECT_FALSE(empty.collided(tree, output, pool));
+    EXPECT_TRUE(output.empty());
+}
+
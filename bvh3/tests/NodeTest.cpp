@@ -5,7 +5,11 @@
 
 #include <bvh3/bv/all.hpp>
 #include <bvh3/Node.hpp>
+#include <bvh3/tests/TestHelpers.hpp>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <tuple>
 
 using namespace NBvh3;
 using namespace std;
@@ -439,6 +443,41 @@ TEST(NodeTest, testBuildTreeNeg2)
 }
 
 
+/**
+ * Returns number of nodes on the longest path from the node to a leaf.
+ */
+unsigned getDepth(const TNodeKDop16* node)
+{
+    return node->isLeaf() ? 1 : 1 + std::max(getDepth(node->getLeft()), getDepth(node->getRight()));
+}
+
+TEST(NodeTest, testBuildTreeDuplicates)
+{
+    auto root = buildTree<TKDop16>(TVertices(200000, SVertex(1, 1, 1)));
+    EXPECT_EQ(19, getDepth(root));
+    EXPECT_EQ(200000, root->getVertices().size());
+
+    // Few distinct points on a line repeated many times.
+    TVertices line;
+    for (unsigned i = 0; i < 200000; ++i)
+    {
+        float t = std::ldexp(1.0f, -int(i % 50));
+        line.push_back(SVertex(t, t, t));
+    }
+
+    auto lineRoot = buildTree<TKDop16>(line);
+    EXPECT_GE(getDepthLimit(200000) + 1, getDepth(lineRoot));
+
+    auto dot = buildTree<TKDop16>(TVertices(3, SVertex(1, 1, 1)));
+    EXPECT_TRUE(root->intersects(dot));
+    EXPECT_TRUE(lineRoot->intersects(dot));
+
+    delete root;
+    delete lineRoot;
+    delete dot;
+}
+
+
 TEST(NodeTest, testBuildTreeInside)
 {
     TVertices triangle1 =
@@ -594,3 +633,550 @@ TEST(NodeTest, testCollidedTrianglesLeft)
     delete root1;
     delete root2;
 }
+
+TEST(NodeTest, testBuildTreeShared)
+{
+    TSharedVertices vertices = std::make_shared<TVertices>(TVertices
+    {
+        {5, 4, 0},
+        {3, 1, 0},
+        {1, 5, 0}
+    });
+
+    auto root = buildTree<TKDop16>(vertices);
+
+    // Vertices are reordered in place.
+    EXPECT_EQ(3, vertices->size());
+    EXPECT_EQ(SVertex(5, 4, 0), (*vertices)[2]);
+
+    EXPECT_EQ(0, root->getBegin());
+    EXPECT_EQ(3, root->getEnd());
+    EXPECT_EQ(vertices->data(), root->getVertices().begin());
+
+    auto left = root->getLeft();
+    auto right = root->getRight();
+    EXPECT_EQ(0, left->getBegin());
+    EXPECT_EQ(2, left->getEnd());
+    EXPECT_EQ(2, right->getBegin());
+    EXPECT_EQ(3, right->getEnd());
+    EXPECT_EQ(SVertex(5, 4, 0), right->getVertices()[0]);
+
+    EXPECT_EQ(0, left->getLeft()->getBegin());
+    EXPECT_EQ(1, left->getLeft()->getEnd());
+    EXPECT_EQ(SVertex(3, 1, 0), left->getLeft()->getVertices()[0]);
+    EXPECT_EQ(1, left->getRight()->getBegin());
+    EXPECT_EQ(2, left->getRight()->getEnd());
+    EXPECT_EQ(vertices->data() + 1, left->getRight()->getVertices().begin());
+    EXPECT_EQ(SVertex(1, 5, 0), left->getRight()->getVertices()[0]);
+
+    // Submitted indices of reordered vertices are kept.
+    EXPECT_EQ(1, root->getIndex(0));
+    EXPECT_EQ(2, left->getIndex(1));
+    EXPECT_EQ(0, right->getIndex(2));
+
+    delete root;
+
+    // Vertices are still owned by the caller.
+    EXPECT_EQ(3, vertices->size());
+}
+
+TEST(NodeTest, testBuildTreeSharedRange)
+{
+    TVertices vertices = getGrid(8, 3);
+    auto shared = std::make_shared<TVertices>(vertices);
+
+    // Only the range is reordered, submitted indices refer to the whole array.
+    auto root = buildTree<TKDop16>(shared, 100, 300);
+    EXPECT_EQ(100, root->getBegin());
+    EXPECT_EQ(300, root->getEnd());
+    for (unsigned i = 0; i < shared->size(); ++i)
+    {
+        if (i >= 100 && i < 300)
+        {
+            EXPECT_EQ(vertices[root->getIndex(i)], (*shared)[i]);
+            EXPECT_LE(100, root->getIndex(i));
+            EXPECT_GT(300, root->getIndex(i));
+        }
+        else
+        {
+            EXPECT_EQ(vertices[i], (*shared)[i]);
+        }
+    }
+
+    const TNodeKDop16* leaf = root;
+    while (!leaf->isLeaf())
+    {
+        leaf = leaf->getRight();
+    }
+
+    EXPECT_EQ(299, leaf->getBegin());
+    EXPECT_EQ(vertices[leaf->getIndex(299)], leaf->getVertices()[0]);
+
+    delete root;
+}
+
+/**
+ * Recursive traversal as it was before the explicit stack.
+ */
+bool collidedRecursively(const TNodeKDop16* node, const TNodeKDop16* query, TNodeKDop16::TCollidedNodes& output)
+{
+    bool result = false;
+    if (node->overlapped(query))
+    {
+        output.push_back(std::make_pair(node, query));
+
+        result = true;
+        auto left = node->getLeft();
+        auto right = node->getRight();
+        if (left != 0 && left->overlapped(query))
+        {
+            output.push_back(std::make_pair(left, query));
+            collidedRecursively(left, query->getLeft(), output);
+            collidedRecursively(left, query->getRight(), output);
+        }
+
+        if (right != 0 && right->overlapped(query))
+        {
+            output.push_back(std::make_pair(right, query));
+            collidedRecursively(right, query->getLeft(), output);
+            collidedRecursively(right, query->getRight(), output);
+        }
+    }
+
+    return result;
+}
+
+TEST(NodeTest, testCollidedSameAsRecursive)
+{
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> distribution(0, 20);
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        TVertices vertices1;
+        TVertices vertices2;
+        for (unsigned j = 0; j < 100; ++j)
+        {
+            vertices1.push_back(SVertex(distribution(generator), distribution(generator), j));
+            vertices2.push_back(SVertex(distribution(generator), distribution(generator), j));
+        }
+
+        auto root1 = buildTree<TKDop16>(vertices1);
+        auto root2 = buildTree<TKDop16>(vertices2);
+        TNodeKDop16::TCollidedNodes expected;
+        TNodeKDop16::TCollidedNodes output;
+        EXPECT_EQ(collidedRecursively(root1, root2, expected), root1->collided(root2, output));
+        EXPECT_EQ(expected, output);
+
+        expected.clear();
+        output.clear();
+        EXPECT_EQ(collidedRecursively(root1, root1, expected), root1->collided(root1, output));
+        EXPECT_EQ(expected, output);
+
+        delete root1;
+        delete root2;
+    }
+}
+
+TEST(NodeTest, testVisit)
+{
+    std::mt19937 generator(2);
+    std::uniform_int_distribution<int> distribution(0, 10);
+    auto vertices1 = std::make_shared<TVertices>();
+    auto vertices2 = std::make_shared<TVertices>();
+    for (unsigned j = 0; j < 200; ++j)
+    {
+        vertices1->push_back(SVertex(distribution(generator), distribution(generator), j));
+        vertices2->push_back(j % 3 == 0 ? vertices1->back() : SVertex(distribution(generator), distribution(generator), j + 200));
+    }
+
+    auto root1 = buildTree<TKDop16>(vertices1);
+    auto root2 = buildTree<TKDop16>(vertices2);
+
+    // Pairs of indices of equal vertices in shared vertices.
+    vector<pair<unsigned, unsigned> > expected;
+    for (unsigned i = 0; i < vertices1->size(); ++i)
+    {
+        for (unsigned j = 0; j < vertices2->size(); ++j)
+        {
+            if ((*vertices1)[i] == (*vertices2)[j])
+            {
+                expected.push_back(make_pair(i, j));
+            }
+        }
+    }
+
+    vector<pair<unsigned, unsigned> > pairs;
+    EXPECT_TRUE(root1->visit(root2, [&pairs](unsigned index, unsigned queryIndex) {
+        pairs.push_back(make_pair(index, queryIndex));
+        return true;
+    }));
+
+    std::sort(pairs.begin(), pairs.end());
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, pairs);
+
+    unsigned visited = 0;
+    EXPECT_FALSE(root1->visit(root1, [&visited](unsigned index, unsigned queryIndex) { return ++visited < 3; }));
+    EXPECT_EQ(3, visited);
+
+    delete root1;
+    delete root2;
+}
+
+TEST(NodeTest, testIntersects)
+{
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int> distribution(0, 20);
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        TVertices vertices1;
+        TVertices vertices2;
+        for (unsigned j = 0; j < 100; ++j)
+        {
+            vertices1.push_back(SVertex(distribution(generator), distribution(generator), j));
+            vertices2.push_back(SVertex(distribution(generator), distribution(generator), j));
+        }
+
+        auto root1 = buildTree<TKDop16>(vertices1);
+        auto root2 = buildTree<TKDop16>(vertices2);
+
+        // Intersected if any pair of leaves is collided.
+        TNodeKDop16::TCollidedNodes output;
+        root1->collided(root2, output);
+        bool expected = false;
+        for (unsigned j = 0; j < output.size(); ++j)
+        {
+            expected = expected || (output[j].first->isLeaf() && output[j].second->isLeaf());
+        }
+
+        EXPECT_EQ(expected, root1->intersects(root2));
+        EXPECT_TRUE(root1->intersects(root1));
+        EXPECT_FALSE(root1->intersects(0));
+
+        delete root1;
+        delete root2;
+    }
+}
+
+TEST(NodeTest, testDeepTraversal)
+{
+    // Degenerate tree: right children are leaves on the query vertex,
+    // left ones continue the chain, so pending pairs exceed the fixed stack.
+    const unsigned depth = 200;
+    auto vertices = std::make_shared<TVertices>();
+    for (unsigned i = 0; i <= depth; ++i)
+    {
+        vertices->push_back(i < depth ? SVertex(1, 1, 1) : SVertex(5, 5, 5));
+    }
+
+    TNodeKDop16* root = new TNodeKDop16(TKDop16((*vertices)[depth]), vertices, depth, depth + 1, 0, 0);
+    for (unsigned i = depth; i-- > 0;)
+    {
+        TKDop16 bv((*vertices)[i]);
+        TNodeKDop16* leaf = new TNodeKDop16(bv, vertices, i, i + 1, 0, 0);
+        bv += root->getBoundingVolume();
+        root = new TNodeKDop16(bv, vertices, i, depth + 1, root, leaf);
+    }
+
+    TVertices dot = {{1, 1, 1}};
+    TVertices miss = {{3, 3, 3}};
+    auto query = buildTree<TKDop16>(dot);
+    auto missQuery = buildTree<TKDop16>(miss);
+    EXPECT_TRUE(root->intersects(query));
+    EXPECT_TRUE(query->intersects(root));
+    EXPECT_FALSE(root->intersects(missQuery));
+
+    // Leaves are visited by nested traversals too.
+    TNodeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(root->collidedLeaves(query, output));
+    EXPECT_EQ(depth, output.size());
+
+    std::vector<unsigned> visited;
+    EXPECT_TRUE(root->visit(query, [&visited](unsigned index, unsigned) { visited.push_back(index); return true; }));
+    std::sort(visited.begin(), visited.end());
+    ASSERT_EQ(depth, visited.size());
+    for (unsigned i = 0; i < depth; ++i)
+    {
+        EXPECT_EQ(i, visited[i]);
+    }
+
+    unsigned count = 0;
+    EXPECT_FALSE(root->visit(query, [&count](unsigned, unsigned) { return ++count < 100; }));
+    EXPECT_EQ(100, count);
+
+    delete root;
+    delete query;
+    delete missQuery;
+}
+
+/**
+ * Returns sorted pairs of submitted indices of vertices of collided leaves.
+ */
+vector<pair<unsigned, unsigned> > getIndexPairs(const TNodeKDop16::TCollidedNodes& output)
+{
+    vector<pair<unsigned, unsigned> > result;
+    for (unsigned i = 0; i < output.size(); ++i)
+    {
+        EXPECT_TRUE(output[i].first->isLeaf());
+        EXPECT_TRUE(output[i].second->isLeaf());
+        unsigned first = output[i].first->getIndex(output[i].first->getBegin());
+        unsigned second = output[i].second->getIndex(output[i].second->getBegin());
+        result.push_back(make_pair(std::min(first, second), std::max(first, second)));
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+TEST(NodeTest, testSelfCollided)
+{
+    // Vertices of a grid repeated up to 3 times and shuffled, so the build reorders them.
+    std::mt19937 generator(4);
+    std::uniform_int_distribution<int> repeats(1, 3);
+    TVertices vertices;
+    for (int x = 0; x < 6; ++x)
+    {
+        for (int y = 0; y < 6; ++y)
+        {
+            for (int z = 0; z < 6; ++z)
+            {
+                vertices.insert(vertices.end(), repeats(generator), SVertex(x, y, z));
+            }
+        }
+    }
+
+    std::shuffle(vertices.begin(), vertices.end(), generator);
+    auto shared = std::make_shared<TVertices>(vertices);
+    auto root = buildTree<TKDop16>(shared);
+    for (unsigned i = 0; i < shared->size(); ++i)
+    {
+        EXPECT_EQ(vertices[root->getIndex(i)], (*shared)[i]);
+    }
+
+    // Every second pair of equal vertices is excluded by submitted indices.
+    vector<pair<unsigned, unsigned> > expected;
+    vector<pair<unsigned, unsigned> > expectedExcluded;
+    TNodeKDop16::TExcludedPairs excludedPairs;
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        for (unsigned j = i + 1; j < vertices.size(); ++j)
+        {
+            if (vertices[i] == vertices[j])
+            {
+                expected.push_back(make_pair(i, j));
+                if (expected.size() % 2 == 0)
+                {
+                    excludedPairs.push_back(make_pair(j, i));
+                }
+                else
+                {
+                    expectedExcluded.push_back(make_pair(i, j));
+                }
+            }
+        }
+    }
+
+    TNodeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(root->selfCollided(output));
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, getIndexPairs(output));
+
+    output.clear();
+    EXPECT_TRUE(root->selfCollided(excludedPairs, output));
+    EXPECT_LT(expectedExcluded.size(), expected.size());
+    EXPECT_EQ(expectedExcluded, getIndexPairs(output));
+
+    delete root;
+}
+
+TEST(NodeTest, testSelfCollidedDistinct)
+{
+    TVertices vertices;
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        vertices.push_back(SVertex(i % 10, i / 10, 0));
+    }
+
+    auto root = buildTree<TKDop16>(vertices);
+    TNodeKDop16::TCollidedNodes output;
+    EXPECT_FALSE(root->selfCollided(output));
+    EXPECT_TRUE(output.empty());
+
+    // A single leaf does not collide with itself.
+    TVertices dot = {{1, 1, 1}};
+    auto leaf = buildTree<TKDop16>(dot);
+    EXPECT_FALSE(leaf->selfCollided(output));
+
+    delete root;
+    delete leaf;
+}
+
+/**
+ * Returns distinct pairs of vertices of collided leaves, query vertices are transformed.
+ */
+vector<pair<SVertex, SVertex> > getLeafVertices(const TNodeKDop16::TCollidedNodes& output, const STransform& transform)
+{
+    vector<pair<SVertex, SVertex> > result;
+    for (unsigned i = 0; i < output.size(); ++i)
+    {
+        if (output[i].first->isLeaf() && output[i].second->isLeaf())
+        {
+            result.push_back(make_pair(output[i].first->getVertices()[0], transform(output[i].second->getVertices()[0])));
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const pair<SVertex, SVertex>& a, const pair<SVertex, SVertex>& b) {
+        return make_tuple(a.first.x, a.first.y, a.first.z, a.second.x, a.second.y, a.second.z)
+            < make_tuple(b.first.x, b.first.y, b.first.z, b.second.x, b.second.y, b.second.z);
+    });
+
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+TEST(NodeTest, testCollidedLeavesTransformed)
+{
+    std::mt19937 generator(5);
+    std::uniform_int_distribution<int> distribution(0, 10);
+    unsigned found = 0;
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        TVertices vertices;
+        TVertices queryVertices;
+        for (unsigned j = 0; j < 100; ++j)
+        {
+            vertices.push_back(SVertex(distribution(generator), distribution(generator), j));
+            queryVertices.push_back(SVertex(distribution(generator), distribution(generator), j));
+        }
+
+        // Rotation by 90 degrees around z keeps integer coordinates exact.
+        STransform transform(SVertex(distribution(generator), distribution(generator), 0));
+        transform.rotation[0] = transform.rotation[4] = 0;
+        transform.rotation[1] = -1;
+        transform.rotation[3] = 1;
+
+        TVertices placed(queryVertices);
+        for (unsigned j = 0; j < placed.size(); ++j)
+        {
+            placed[j] = transform(placed[j]);
+        }
+
+        auto root = buildTree<TKDop16>(vertices);
+        auto query = buildTree<TKDop16>(queryVertices);
+
+        vector<pair<SVertex, SVertex> > expected;
+        for (unsigned j = 0; j < vertices.size(); ++j)
+        {
+            for (unsigned k = 0; k < placed.size(); ++k)
+            {
+                if (vertices[j] == placed[k])
+                {
+                    expected.push_back(make_pair(vertices[j], placed[k]));
+                }
+            }
+        }
+
+        TNodeKDop16::TCollidedNodes output;
+        root->collidedLeaves(query, transform, output);
+        for (unsigned j = 0; j < output.size(); ++j)
+        {
+            EXPECT_TRUE(output[j].first->isLeaf());
+            EXPECT_TRUE(output[j].second->isLeaf());
+        }
+
+        std::sort(expected.begin(), expected.end(), [](const pair<SVertex, SVertex>& a, const pair<SVertex, SVertex>& b) {
+            return make_tuple(a.first.x, a.first.y, a.first.z) < make_tuple(b.first.x, b.first.y, b.first.z);
+        });
+
+        EXPECT_EQ(expected, getLeafVertices(output, transform));
+        found += expected.size();
+        EXPECT_EQ(getLeafVertices(output, transform).size(), output.size());
+
+        delete root;
+        delete query;
+    }
+
+    EXPECT_LT(0, found);
+}
+
+TEST(NodeTest, testCollidedLeavesSameAsCollided)
+{
+    TVertices grid;
+    for (unsigned i = 0; i < 300; ++i)
+    {
+        grid.push_back(SVertex(i % 7, i / 7 % 5, i / 35));
+    }
+
+    auto root = buildTree<TKDop16>(TVertices(grid.begin(), grid.begin() + 200));
+    auto query = buildTree<TKDop16>(TVertices(grid.begin() + 100, grid.end()));
+
+    // collided() returns internal pairs too, collidedLeaves() all pairs of leaves with common vertices.
+    TNodeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(root->collided(query, output));
+    TNodeKDop16::TCollidedNodes leaves;
+    for (unsigned i = 0; i < output.size(); ++i)
+    {
+        if (output[i].first->isLeaf() && output[i].second->isLeaf())
+        {
+            leaves.push_back(output[i]);
+        }
+    }
+
+    TNodeKDop16::TCollidedNodes transformed;
+    EXPECT_TRUE(root->collidedLeaves(query, STransform(), transformed));
+    EXPECT_LT(leaves.size(), output.size());
+    std::sort(leaves.begin(), leaves.end());
+    std::sort(transformed.begin(), transformed.end());
+    EXPECT_TRUE(std::includes(transformed.begin(), transformed.end(), leaves.begin(), leaves.end()));
+    EXPECT_EQ(100, transformed.size());
+    for (unsigned i = 0; i < transformed.size(); ++i)
+    {
+        EXPECT_TRUE(transformed[i].first->isLeaf());
+        EXPECT_TRUE(transformed[i].second->isLeaf());
+        EXPECT_EQ(transformed[i].first->getVertices()[0], transformed[i].second->getVertices()[0]);
+    }
+
+    delete root;
+    delete query;
+}
+
+TEST(NodeTest, testGetBoundingVolumeTransformed)
+{
+    TVertices vertices;
+    for (unsigned i = 0; i < 20; ++i)
+    {
+        vertices.push_back(SVertex(i, i % 3, i % 7));
+    }
+
+    auto root = buildTree<TKDop16>(vertices);
+    STransform transform(SVertex(0, 0, 1), 0.5f, SVertex(1, 2, 3));
+    TKDop16 bv = root->getBoundingVolume(transform);
+    TKDop16 small = root->getLeft()->getLeft()->getBoundingVolume(transform);
+    for (unsigned i = 0; i < vertices.size(); ++i)
+    {
+        TKDop16 vertex(transform(vertices[i]));
+        for (unsigned axis = 0; axis < 8; ++axis)
+        {
+            EXPECT_LE(bv.getMin(axis) - 0.001f, vertex.getMin(axis));
+            EXPECT_GE(bv.getMax(axis) + 0.001f, vertex.getMax(axis));
+        }
+    }
+
+    // Small nodes are exact.
+    TKDop16 expected;
+    SVertexRange range = root->getLeft()->getLeft()->getVertices();
+    for (unsigned i = 0; i < range.size(); ++i)
+    {
+        expected += transform(range[i]);
+    }
+
+    ASSERT_GE(8, range.size());
+    for (unsigned axis = 0; axis < 8; ++axis)
+    {
+        EXPECT_EQ(expected.getMin(axis), small.getMin(axis));
+        EXPECT_EQ(expected.getMax(axis), small.getMax(axis));
+    }
+
+    delete root;
+}
+
@@ -0,0 +1,82 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/Statistics.hpp>
+#include <gtest/gtest.h>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+
+TEST(StatisticsTest, testEmpty)
+{
+    FlatTree<TKDop16> tree;
+    EXPECT_EQ(0, getDepth(tree));
+    EXPECT_EQ(0, getSurfaceAreaCost(tree));
+}
+
+TEST(StatisticsTest, testTriangle)
+{
+    TVertices triangle =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    FlatTree<TKDop16> tree;
+    buildTree<TKDop16>(triangle, tree);
+
+    EXPECT_EQ(3, getDepth(tree));
+
+    // Root and left child, leaves are points.
+    float root = tree.getBoundingVolume(0).getBoxSurfaceArea();
+    float left = tree.getBoundingVolume(1).getBoxSurfaceArea();
+    EXPECT_FLOAT_EQ(1 + left / root, getSurfaceAreaCost(tree));
+}
+
+TEST(StatisticsTest, testBoxSurfaceArea)
+{
+    TKDop16 cube;
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        cube += SVertex(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+    }
+
+    EXPECT_FLOAT_EQ(6, cube.getBoxSurfaceArea());
+
+    // Triangle in xy plane: both sides of its box, diagonal planes are not considered.
+    TKDop16 triangle;
+    triangle += SVertex(0, 0, 0);
+    triangle += SVertex(1, 0, 0);
+    triangle += SVertex(0, 1, 0);
+    EXPECT_FLOAT_EQ(2, triangle.getBoxSurfaceArea());
+
+    EXPECT_EQ(0, TKDop16().getBoxSurfaceArea());
+    EXPECT_EQ(0, TKDop16(SVertex(1, 2, 3)).getBoxSurfaceArea());
+}
+
+TEST(StatisticsTest, testNode)
+{
+    TVertices triangle =
+    {
+        {3, 1, 0},
+        {1, 5, 0},
+        {5, 4, 0}
+    };
+
+    // The same tree as the flat one.
+    FlatTree<TKDop16> tree;
+    buildTree<TKDop16>(triangle, tree);
+    auto root = buildTree<TKDop16>(triangle);
+    EXPECT_EQ(getDepth(tree), getDepth(root));
+    EXPECT_FLOAT_EQ(getSurfaceAreaCost(tree), getSurfaceAreaCost(root));
+    delete root;
+
+    EXPECT_EQ(0, getDepth(static_cast<const Node<TKDop16>*>(0)));
+}
@@ -0,0 +1,63 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#ifndef BVH3_TESTHELPERS
+#define BVH3_TESTHELPERS
+
+#include <bvh3/types/SVertex.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+
+namespace NBvh3
+{
+
+/**
+ * Returns distinct vertices of a grid in random order.
+ */
+inline TVertices getGrid(unsigned size, unsigned seed)
+{
+    TVertices result;
+    for (unsigned x = 0; x < size; ++x)
+    {
+        for (unsigned y = 0; y < size; ++y)
+        {
+            for (unsigned z = 0; z < size; ++z)
+            {
+                result.push_back(SVertex(x, y, z));
+            }
+        }
+    }
+
+    std::shuffle(result.begin(), result.end(), std::mt19937(seed));
+    return result;
+}
+
+/**
+ * Checks that flat trees have the same nodes, vertices and indices.
+ */
+template<class TBv>
+void expectEqualTrees(const FlatTree<TBv>& expected, const FlatTree<TBv>& tree)
+{
+    ASSERT_EQ(expected.getNodes().size(), tree.getNodes().size());
+    for (unsigned i = 0; i < expected.getNodes().size(); ++i)
+    {
+        EXPECT_EQ(expected.getNodes()[i].index, tree.getNodes()[i].index);
+        EXPECT_EQ(expected.getNodes()[i].count, tree.getNodes()[i].count);
+        for (unsigned axis = 0; axis < TBv::DIRECTIONS; ++axis)
+        {
+            EXPECT_EQ(expected.getBoundingVolume(i).getMin(axis), tree.getBoundingVolume(i).getMin(axis));
+            EXPECT_EQ(expected.getBoundingVolume(i).getMax(axis), tree.getBoundingVolume(i).getMax(axis));
+        }
+    }
+
+    EXPECT_EQ(expected.getVertices(), tree.getVertices());
+    EXPECT_EQ(expected.getIndices(), tree.getIndices());
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_TESTHELPERS
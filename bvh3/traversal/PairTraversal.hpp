@@ -0,0 +1,273 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_PAIRTRAVERSAL
+#define BVH3_PAIRTRAVERSAL
+
+#include <utility>
+#include <vector>
+
+namespace NBvh3
+{
+
+/**
+ * Pair of node indices of two trees.
+ */
+typedef std::pair<unsigned, unsigned> TNodePair;
+
+/**
+ * Stack of node pairs with fixed capacity stored inline.
+ * Pairs that do not fit are spilled to heap, so degenerate trees are still traversed.
+ */
+class PairStack
+{
+public:
+
+    /**
+     * Number of pairs stored without heap allocations.
+     * Depth-first traversal needs at most sum of depths of both trees.
+     */
+    static const unsigned CAPACITY = 128;
+
+    /**
+     * Creates empty stack.
+     */
+    PairStack();
+
+    /**
+     * Returns number of pairs.
+     */
+    unsigned size() const;
+
+    /**
+     * Pushes the pair.
+     */
+    void push(unsigned first, unsigned second);
+
+    /**
+     * Pops the last pair. The stack should not be empty.
+     */
+    TNodePair pop();
+
+private:
+
+    PairStack(const PairStack&);
+    PairStack& operator = (const PairStack&);
+
+    /**
+     * Inline pairs.
+     */
+    TNodePair mPairs[CAPACITY];
+
+    /**
+     * Pairs above the capacity.
+     */
+    std::vector<TNodePair> mSpilled;
+
+    /**
+     * Number of inline pairs.
+     */
+    unsigned mSize;
+};
+
+/**
+ * Returns the stack of current thread.
+ * Traversals use it starting from its current size, so they could be nested.
+ */
+inline PairStack& getPairStack()
+{
+    static thread_local PairStack stack;
+    return stack;
+}
+
+inline PairStack::PairStack()
+    : mSize(0)
+{
+}
+
+inline unsigned PairStack::size() const
+{
+    return mSize + mSpilled.size();
+}
+
+inline void PairStack::push(unsigned first, unsigned second)
+{
+    if (mSize < CAPACITY)
+    {
+        mPairs[mSize++] = TNodePair(first, second);
+    }
+    else
+    {
+        mSpilled.push_back(TNodePair(first, second));
+    }
+}
+
+inline TNodePair PairStack::pop()
+{
+    if (!mSpilled.empty())
+    {
+        TNodePair result = mSpilled.back();
+        mSpilled.pop_back();
+        return result;
+    }
+
+    return mPairs[--mSize];
+}
+
+/**
+ * Returns size of bounding volume to choose which node to descend.
+ * Sum of extents is used instead of surface area that is 0 for flat and linear nodes.
+ */
+template<class TBv>
+inline float getSize(const TBv& bv)
+{
+    return bv.getWidth() + bv.getHeight() + bv.getDepth();
+}
+
+/**
+ * Checks if the node of the tree should be descended instead of the query node.
+ * When both nodes are internal the one with bigger bounding volume is descended,
+ * so big nodes are split before small ones.
+ */
+template<class TTree>
+inline bool descendsTree(const TTree& tree, unsigned node, const TTree& query, unsigned queryNode)
+{
+    return query.isLeaf(queryNode)
+        || (!tree.isLeaf(node) && getSize(tree.getBoundingVolume(node)) >= getSize(query.getBoundingVolume(queryNode)));
+}
+
+/**
+ * Traverses pairs of overlapped nodes of two trees iteratively without recursion.
+ * Nodes to descend are chosen by descendsTree().
+ *
+ * @tparam TTree Tree with isLeaf(), getLeft(), getRight() and getBoundingVolume() by node index.
+ * @tparam THandler Called as handler(node, queryNode) for overlapped leaves,
+ *                  returns false to stop the traversal.
+ * @param Tree.
+ * @param Query tree.
+ * @param Handler of leaves.
+ * @param Node of the tree to start from.
+ * @param Node of the query tree to start from.
+ * @return false If stopped by the handler.
+ */
+template<class TTree, class THandler>
+bool traversePairs(const TTree& tree, const TTree& query, THandler& handler, unsigned root = 0, unsigned queryRoot = 0)
+{
+    if (tree.empty() || query.empty())
+    {
+        return true;
+    }
+
+    PairStack& stack = getPairStack();
+    unsigned base = stack.size();
+    stack.push(root, queryRoot);
+    while (stack.size() > base)
+    {
+        TNodePair pair = stack.pop();
+        unsigned node = pair.first;
+        unsigned queryNode = pair.second;
+        while (tree.getBoundingVolume(node).overlapped(query.getBoundingVolume(queryNode)))
+        {
+            if (tree.isLeaf(node) && query.isLeaf(queryNode))
+            {
+                if (!handler(node, queryNode))
+                {
+                    while (stack.size() > base)
+                    {
+                        stack.pop();
+                    }
+
+                    return false;
+                }
+
+                break;
+            }
+
+            // Continues with the left child and postpones the right one.
+            if (descendsTree(tree, node, query, queryNode))
+            {
+                stack.push(tree.getRight(node), queryNode);
+                node = tree.getLeft(node);
+            }
+            else
+            {
+                stack.push(node, query.getRight(queryNode));
+                queryNode = query.getLeft(queryNode);
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Splits traversal of two trees into independent pairs of subtrees.
+ * Pairs of internal nodes are replaced by overlapped pairs of children chosen by descendsTree()
+ * until there are enough pairs or only leaves are left.
+ * Traversing the pairs one by one finds leaves in the same order as traversePairs() of the whole trees.
+ *
+ * @param Tree.
+ * @param Query tree.
+ * @param Wanted number of pairs.
+ * @param[out] Overlapped pairs of nodes.
+ */
+template<class TTree>
+void expandPairs(const TTree& tree, const TTree& query, unsigned count, std::vector<TNodePair>& front)
+{
+    front.clear();
+    if (tree.empty() || query.empty() || !tree.getBoundingVolume(0).overlapped(query.getBoundingVolume(0)))
+    {
+        return;
+    }
+
+    front.push_back(TNodePair(0, 0));
+    std::vector<TNodePair> next;
+    bool expanded = true;
+    while (expanded && front.size() < count)
+    {
+        expanded = false;
+        next.clear();
+        for (unsigned i = 0; i < front.size(); ++i)
+        {
+            unsigned node = front[i].first;
+            unsigned queryNode = front[i].second;
+            if (tree.isLeaf(node) && query.isLeaf(queryNode))
+            {
+                next.push_back(front[i]);
+                continue;
+            }
+
+            expanded = true;
+            TNodePair children[2];
+            if (descendsTree(tree, node, query, queryNode))
+            {
+                children[0] = TNodePair(tree.getLeft(node), queryNode);
+                children[1] = TNodePair(tree.getRight(node), queryNode);
+            }
+            else
+            {
+                children[0] = TNodePair(node, query.getLeft(queryNode));
+                children[1] = TNodePair(node, query.getRight(queryNode));
+            }
+
+            for (unsigned j = 0; j < 2; ++j)
+            {
+                if (tree.getBoundingVolume(children[j].first).overlapped(query.getBoundingVolume(children[j].second)))
+                {
+                    next.push_back(children[j]);
+                }
+            }
+        }
+
+        front.swap(next);
+    }
+}
+
+} // namespace NBvh3
+
+#endif // BVH3_PAIRTRAVERSAL
@@ -0,0 +1,211 @@
+/**
+ * @author VaL Doroshchuk
+ * @license GNU GPL v2
+ */
+
+#include <bvh3/bv/all.hpp>
+#include <bvh3/traversal/PairTraversal.hpp>
+#include <bvh3/FlatTree.hpp>
+#include <bvh3/tests/TestHelpers.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace NBvh3;
+using namespace std;
+
+typedef KDop<16> TKDop16;
+typedef FlatTree<TKDop16> TFlatTreeKDop16;
+
+/**
+ * Returns all pairs of leaves with overlapped bounding volumes by testing every pair.
+ */
+vector<TNodePair> getPairsByBruteForce(const TFlatTreeKDop16& tree, const TFlatTreeKDop16& query)
+{
+    vector<TNodePair> result;
+    for (unsigned i = 0; i < tree.getNodes().size(); ++i)
+    {
+        for (unsigned j = 0; j < query.getNodes().size(); ++j)
+        {
+            if (tree.isLeaf(i)
+                && query.isLeaf(j)
+                && tree.getBoundingVolume(i).overlapped(query.getBoundingVolume(j)))
+            {
+                result.push_back(TNodePair(i, j));
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Collects visited pairs of leaves.
+ */
+struct SCollector
+{
+    bool operator () (unsigned node, unsigned queryNode)
+    {
+        pairs.push_back(TNodePair(node, queryNode));
+        return true;
+    }
+
+    vector<TNodePair> pairs;
+};
+
+TEST(PairTraversalTest, testStack)
+{
+    PairStack stack;
+    unsigned count = PairStack::CAPACITY * 3;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        stack.push(i, i + 1);
+    }
+
+    EXPECT_EQ(count, stack.size());
+    for (unsigned i = count; i-- > 0;)
+    {
+        EXPECT_EQ(TNodePair(i, i + 1), stack.pop());
+    }
+
+    EXPECT_EQ(0, stack.size());
+}
+
+TEST(PairTraversalTest, testSameAsBruteForce)
+{
+    TVertices grid = getGrid(8, 1);
+    TVertices vertices1(grid.begin(), grid.begin() + 300);
+    TVertices vertices2(grid.begin() + 200, grid.end());
+    for (unsigned maxLeafSize = 1; maxLeafSize <= 8; maxLeafSize *= 2)
+    {
+        TFlatTreeKDop16 tree1;
+        TFlatTreeKDop16 tree2;
+        buildTree<TKDop16>(vertices1, tree1, maxLeafSize);
+        buildTree<TKDop16>(vertices2, tree2, maxLeafSize);
+
+        SCollector collector;
+        traversePairs(tree1, tree2, collector);
+        std::sort(collector.pairs.begin(), collector.pairs.end());
+        EXPECT_EQ(getPairsByBruteForce(tree1, tree2), collector.pairs);
+        EXPECT_EQ(0, getPairStack().size());
+    }
+}
+
+TEST(PairTraversalTest, testEmpty)
+{
+    TFlatTreeKDop16 tree;
+    TFlatTreeKDop16 empty;
+    buildTree<TKDop16>(getGrid(2, 1), tree);
+
+    SCollector collector;
+    traversePairs(tree, empty, collector);
+    traversePairs(empty, tree, collector);
+    EXPECT_TRUE(collector.pairs.empty());
+}
+
+TEST(PairTraversalTest, testNested)
+{
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(getGrid(4, 2), tree);
+
+    SCollector inner;
+    unsigned outer = 0;
+    auto handler = [&tree, &inner, &outer](unsigned node, unsigned queryNode)
+    {
+        if (outer++ == 0)
+        {
+            traversePairs(tree, tree, inner);
+        }
+
+        return true;
+    };
+
+    traversePairs(tree, tree, handler);
+    EXPECT_EQ(64, outer);
+    EXPECT_EQ(64, inner.pairs.size());
+}
+
+TEST(PairTraversalTest, testDeepTree)
+{
+    // Every left child is a leaf, so depth equals number of leaves.
+    unsigned leaves = 100000;
+    TFlatTreeKDop16::TNodes nodes(2 * leaves - 1);
+    TVertices vertices(leaves);
+    TFlatTreeKDop16::TIndices indices(leaves);
+    for (unsigned i = 0; i < leaves; ++i)
+    {
+        vertices[i] = SVertex(i, 0, 0);
+        indices[i] = i;
+    }
+
+    for (unsigned i = leaves; i-- > 0;)
+    {
+        unsigned node = 2 * i;
+        if (i + 1 == leaves)
+        {
+            nodes[node].bv = TKDop16(vertices[i]);
+            nodes[node].index = i;
+            nodes[node].count = 1;
+            continue;
+        }
+
+        nodes[node + 1].bv = TKDop16(vertices[i]);
+        nodes[node + 1].index = i;
+        nodes[node + 1].count = 1;
+        nodes[node].bv = nodes[node + 1].bv + nodes[node + 2].bv;
+        nodes[node].index = node + 2;
+        nodes[node].count = 0;
+    }
+
+    TFlatTreeKDop16 tree(std::move(nodes), std::move(vertices), std::move(indices));
+    TFlatTreeKDop16::TCollidedNodes output;
+    EXPECT_TRUE(tree.collided(tree, output));
+    EXPECT_EQ(leaves, output.size());
+    EXPECT_EQ(0, getPairStack().size());
+}
+
+TEST(PairTraversalTest, testStop)
+{
+    TFlatTreeKDop16 tree;
+    buildTree<TKDop16>(getGrid(4, 3), tree);
+
+    unsigned visited = 0;
+    auto handler = [&visited](unsigned node, unsigned queryNode) { return ++visited < 10; };
+    EXPECT_FALSE(traversePairs(tree, tree, handler));
+    EXPECT_EQ(10, visited);
+    EXPECT_EQ(0, getPairStack().size());
+}
+
+TEST(PairTraversalTest, testExpandPairs)
+{
+    TVertices grid = getGrid(8, 2);
+    TVertices vertices1(grid.begin(), grid.begin() + 300);
+    TVertices vertices2(grid.begin() + 200, grid.end());
+    TFlatTreeKDop16 tree1;
+    TFlatTreeKDop16 tree2;
+    buildTree<TKDop16>(vertices1, tree1, 2);
+    buildTree<TKDop16>(vertices2, tree2, 2);
+
+    SCollector expected;
+    traversePairs(tree1, tree2, expected);
+    for (unsigned count = 1; count <= 100000; count *= 10)
+    {
+        vector<TNodePair> front;
+        expandPairs(tree1, tree2, count, front);
+        EXPECT_LE(std::min(count, unsigned(expected.pairs.size())), front.size());
+
+        // Traversals of subtrees find the same leaves in the same order.
+        SCollector collector;
+        for (unsigned i = 0; i < front.size(); ++i)
+        {
+            traversePairs(tree1, tree2, collector, front[i].first, front[i].second);
+        }
+
+        EXPECT_EQ(expected.pairs, collector.pairs);
+    }
+
+    TFlatTreeKDop16 empty;
+    vector<TNodePair> front;
+    expandPairs(tree1, empty, 10, front);
+    EXPECT_TRUE(front.empty());
+}
+
@@ -0,0 +1,130 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_STRANSFORM
+#define BVH3_STRANSFORM
+
+#include "SVertex.hpp"
+#include <cmath>
+
+namespace NBvh3
+{
+
+/**
+ * Defines rigid transform: rotation followed by translation.
+ */
+struct STransform
+{
+    /**
+     * Creates identity transform.
+     */
+    STransform()
+        : translation(0, 0, 0)
+    {
+        for (unsigned i = 0; i < 9; ++i)
+        {
+            rotation[i] = i % 4 == 0 ? 1 : 0;
+        }
+    }
+
+    /**
+     * @param Translation applied after identity rotation.
+     */
+    explicit STransform(const SVertex& t)
+        : STransform()
+    {
+        translation = t;
+    }
+
+    /**
+     * @param Axis of rotation of unit length.
+     * @param Angle of rotation in radians.
+     * @param Translation applied after rotation.
+     */
+    STransform(const SVertex& axis, float angle, const SVertex& t)
+        : translation(t)
+    {
+        float c = std::cos(angle);
+        float s = std::sin(angle);
+        float k = 1 - c;
+        rotation[0] = c + axis.x * axis.x * k;
+        rotation[1] = axis.x * axis.y * k - axis.z * s;
+        rotation[2] = axis.x * axis.z * k + axis.y * s;
+        rotation[3] = axis.y * axis.x * k + axis.z * s;
+        rotation[4] = c + axis.y * axis.y * k;
+        rotation[5] = axis.y * axis.z * k - axis.x * s;
+        rotation[6] = axis.z * axis.x * k - axis.y * s;
+        rotation[7] = axis.z * axis.y * k + axis.x * s;
+        rotation[8] = c + axis.z * axis.z * k;
+    }
+
+    /**
+     * Transforms the vertex.
+     */
+    inline SVertex operator () (const SVertex& v) const
+    {
+        return SVertex(
+            rotation[0] * v.x + rotation[1] * v.y + rotation[2] * v.z + translation.x,
+            rotation[3] * v.x + rotation[4] * v.y + rotation[5] * v.z + translation.y,
+            rotation[6] * v.x + rotation[7] * v.y + rotation[8] * v.z + translation.z
+            );
+    }
+
+    /**
+     * Returns transform applying other one first and then this one.
+     */
+    inline STransform operator * (const STransform& other) const
+    {
+        STransform result;
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            for (unsigned j = 0; j < 3; ++j)
+            {
+                result.rotation[i * 3 + j] = rotation[i * 3] * other.rotation[j]
+                    + rotation[i * 3 + 1] * other.rotation[3 + j]
+                    + rotation[i * 3 + 2] * other.rotation[6 + j];
+            }
+        }
+
+        result.translation = (*this)(other.translation);
+        return result;
+    }
+
+    /**
+     * Returns inverse transform. Rotation is transposed, so it should be orthonormal.
+     */
+    inline STransform inverse() const
+    {
+        STransform result;
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            for (unsigned j = 0; j < 3; ++j)
+            {
+                result.rotation[i * 3 + j] = rotation[j * 3 + i];
+            }
+        }
+
+        SVertex t = result(translation);
+        result.translation = SVertex(-t.x, -t.y, -t.z);
+        return result;
+    }
+
+    /**
+     * Rotation matrix by rows.
+     */
+    float rotation[9];
+
+    /**
+     * Translation.
+     */
+    SVertex translation;
+};
+
+} // namespace NBvh3
+
+#endif // BVH3_STRANSFORM
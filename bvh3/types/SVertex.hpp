@@ -10,6 +10,7 @@
 #define BVH3_SVERTEX
 
 #include <vector>
+#include <memory>
 
 namespace NBvh3
 {
@@ -95,6 +96,11 @@ struct SVertex
  */
 typedef std::vector<SVertex> TVertices;
 
+/**
+ * Vector of vertices shared between nodes of one tree.
+ */
+typedef std::shared_ptr<TVertices> TSharedVertices;
+
 } // namespace NBvh3
 
 #endif // BVH3_SVERTEX
\ No newline at end of file
@@ -0,0 +1,92 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @date May 2015
+ * @copyright VaL Doroshchuk
+ * @license GNU GPL v2
+ * @package bvh3
+ */
+
+#ifndef BVH3_SVERTEXRANGE
+#define BVH3_SVERTEXRANGE
+
+#include "SVertex.hpp"
+
+namespace NBvh3
+{
+
+/**
+ * Read only view of continuous vertices [first, last).
+ * Does not own vertices.
+ */
+struct SVertexRange
+{
+    /**
+     * Default constructor to create empty range.
+     */
+    SVertexRange() : SVertexRange(0, 0)
+    {
+    }
+
+    /**
+     * @param First vertex.
+     * @param Vertex after the last one.
+     */
+    SVertexRange(const SVertex* f, const SVertex* l)
+        : first(f), last(l)
+    {
+    }
+
+    /**
+     * Returns pointer to the first vertex.
+     */
+    inline const SVertex* begin() const
+    {
+        return first;
+    }
+
+    /**
+     * Returns pointer after the last vertex.
+     */
+    inline const SVertex* end() const
+    {
+        return last;
+    }
+
+    /**
+     * Returns number of vertices.
+     */
+    inline unsigned size() const
+    {
+        return last - first;
+    }
+
+    /**
+     * Checks if there is no vertices.
+     */
+    inline bool empty() const
+    {
+        return first == last;
+    }
+
+    /**
+     * Returns vertex by index.
+     */
+    inline const SVertex& operator [] (unsigned i) const
+    {
+        return first[i];
+    }
+
+    /**
+     * First vertex.
+     */
+    const SVertex* first;
+
+    /**
+     * Vertex after the last one.
+     */
+    const SVertex* last;
+};
+
+} // namespace NBvh3
+
+#endif // BVH3_SVERTEXRANGE